@@ -0,0 +1,108 @@
+#!/bin/bash
+#
+# Matthew Getgen's benchmark for RFT
+#
+# Runs the server and client on loopback through ./relay, which delays, drops, reorders and
+# duplicates packets, for every file size and network condition below. Each run downloads
+# one file, checks it, and adds a row to bench-results/report.csv and report.json made from
+# the JSON summaries the programs print when they exit.
+#
+# Everything can be set from the environment:
+#   BENCH_SIZES       file sizes, for head -c                    (default "64K 1M")
+#   BENCH_CONDITIONS  name:relay options, separated by ';'
+#   BENCH_SEED        relay seed, the same seed drops the same packets
+#   BENCH_RUNS        runs of each size and condition
+#   BENCH_PORT        server port, the relay listens on the next one
+#   BENCH_TIMEOUT     seconds before a run is given up on
+#   BENCH_DIR         where the files and reports go
+#
+
+SIZES=${BENCH_SIZES:-"64K 1M"}
+CONDITIONS=${BENCH_CONDITIONS:-"clean:;lan:-d 0.2 -j 0.05;wan:-d 5 -j 1;reorder:-d 1 -j 0.5 -r 5;lossy:-d 1 -l 0.5 -u 1;shallow:-d 5 -b 50 -q 4"}
+SEED=${BENCH_SEED:-1}
+RUNS=${BENCH_RUNS:-1}
+PORT=${BENCH_PORT:-9300}
+TIMEOUT=${BENCH_TIMEOUT:-300}
+DIR=${BENCH_DIR:-bench-results}
+
+cd "$(dirname "$0")" || exit 1
+for exe in client server relay; do
+    [ -x ./$exe ] || { echo "missing ./$exe, run make new relay first" >&2; exit 1; }
+done
+mkdir -p "$DIR/remote" "$DIR/local" "$DIR/logs" || exit 1
+
+# value of a number field in a one line JSON object
+field() {
+    sed -n "s/.*\"$1\":\([0-9.]*\).*/\1/p" <<< "$2" | head -n 1
+}
+
+# sum of a number field over both directions of the relay summary
+relay_field() {
+    grep -o "\"$1\":[0-9]*" <<< "$2" | awk -F: '{ n += $2 } END { print n + 0 }'
+}
+
+csv="$DIR/report.csv"
+json="$DIR/report.json"
+echo "condition,size_bytes,run,seed,ok,duration_s,goodput_bps,duplicate_packets,packets_sent,retransmits,timeouts,duplicate_acks,rtt_mean_us,rtt_max_us,relay_lost,relay_duplicated,relay_reordered" > "$csv"
+echo "[" > "$json"
+rows=0
+
+IFS=';' read -r -a conditions <<< "$CONDITIONS"
+for size in $SIZES; do
+    # same contents every time, and never all zeros (so nothing is sent as a hole)
+    file="bench-$size.dat"
+    yes "rft benchmark $size" | head -c "$size" > "$DIR/remote/$file"
+    bytes=$(stat -c %s "$DIR/remote/$file")
+
+    for condition in "${conditions[@]}"; do
+        name=${condition%%:*}
+        options=${condition#*:}
+        for run in $(seq 1 "$RUNS"); do
+            log="$DIR/logs/$name-$size-$run"
+            rm -f "$DIR/local/$file"
+
+            timeout "$TIMEOUT" ./server -n 1 "$PORT" > "$log.server" 2> "$log.server.err" &
+            server=$!
+            # shellcheck disable=SC2086
+            ./relay $options -s "$SEED" "$((PORT + 1))" 127.0.0.1 "$PORT" 2> "$log.relay" &
+            relay=$!
+            sleep 0.2
+
+            echo "$file" | timeout "$TIMEOUT" ./client 127.0.0.1 "$((PORT + 1))" "$DIR/remote" "$DIR/local" > "$log.client" 2> "$log.client.err"
+            wait "$server"
+            kill "$relay"
+            wait "$relay"
+
+            ok=0
+            cmp -s "$DIR/remote/$file" "$DIR/local/$file" && ok=1
+            # the client times the whole transfer, and the server as the sender sees the retransmits and RTTs
+            client=$(grep -o '{"side":"client".*' "$log.client.err" | tail -n 1)
+            sender=$(grep -o '{"side":"server".*' "$log.server.err" | tail -n 1)
+            counts=$(tail -n 1 "$log.relay")
+
+            row="$name,$bytes,$run,$SEED,$ok"
+            for key in duration_s goodput_bps duplicate_packets; do
+                value=$(field "$key" "$client")
+                row="$row,${value:-0}"
+            done
+            for key in packets_sent retransmits timeouts duplicate_acks mean max; do
+                value=$(field "$key" "$sender")
+                row="$row,${value:-0}"
+            done
+            for key in lost duplicated reordered; do
+                row="$row,$(relay_field "$key" "$counts")"
+            done
+            echo "$row" >> "$csv"
+            echo "$row"
+
+            IFS=',' read -r -a v <<< "$row"
+            [ $rows -gt 0 ] && echo "," >> "$json"
+            printf '  {"condition":"%s","relay":"%s","size_bytes":%s,"run":%s,"seed":%s,"ok":%s,"duration_s":%s,"goodput_bps":%s,"duplicate_packets":%s,"packets_sent":%s,"retransmits":%s,"timeouts":%s,"duplicate_acks":%s,"rtt_mean_us":%s,"rtt_max_us":%s,"relay_lost":%s,"relay_duplicated":%s,"relay_reordered":%s}' \
+                "${v[0]}" "$options" "${v[@]:1}" >> "$json"
+            rows=$((rows + 1))
+        done
+    done
+done
+
+printf '\n]\n' >> "$json"
+echo "wrote $csv and $json"
@@ -0,0 +1,180 @@
+/**
+ * @file chunk.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief content-defined chunks of the data stream, each known by its SHA-256
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "chunk.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define CHUNK_READ_SIZE (4 * CHUNK_MAX_SIZE)    // bytes of a file read at a time
+
+static u_llong gear[256];
+static pthread_once_t gear_once = PTHREAD_ONCE_INIT;
+
+// the random number for each byte value, from splitmix64 with a fixed seed, so every
+// host cuts the same files the same way
+static void init_gear(void) {
+    u_llong seed = 0, z;
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        gear[i] = z ^ (z >> 31);
+    }
+    return;
+}
+
+void chunk_list_init(chunk_list *c) {
+    memset(c, 0, sizeof(*c));
+    return;
+}
+
+void chunk_list_free(chunk_list *c) {
+    free(c->entries);
+    memset(c, 0, sizeof(*c));
+    return;
+}
+
+size_t chunk_cut(const u_char *data, size_t len) {
+    u_llong hash = 0;
+    size_t i, normal = CHUNK_AVG_SIZE, max = CHUNK_MAX_SIZE;
+
+    pthread_once(&gear_once, init_gear);
+    if (len <= CHUNK_MIN_SIZE) return len;
+    if (max > len) max = len;
+    if (normal > len) normal = len;
+    for (i = CHUNK_MIN_SIZE; i < normal; i++) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & CHUNK_MASK_HARD) == 0) return i + 1;
+    }
+    for (; i < max; i++) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & CHUNK_MASK_EASY) == 0) return i + 1;
+    }
+    return max;
+}
+
+static chunk_entry *push_chunk(chunk_list *c, u_llong offset, u_int size, u_int file) {
+    chunk_entry *entries;
+    chunk_entry *entry;
+
+    if (c->count == c->capacity) {
+        c->capacity = c->capacity ? c->capacity * 2 : 64;
+        entries = realloc(c->entries, c->capacity * sizeof(chunk_entry));
+        if (entries == NULL) return NULL;
+        c->entries = entries;
+    }
+    entry = &c->entries[c->count++];
+    entry->offset = offset;
+    entry->size = size;
+    entry->file = file;
+    return entry;
+}
+
+// cut one file into chunks, reading it CHUNK_READ_SIZE at a time into buff. A cut only
+// looks as far as CHUNK_MAX_SIZE ahead, so what is left past the last one is moved to the
+// front and read on from there
+static int chunk_file(chunk_list *c, manifest *files, u_int index, u_char *buff) {
+    manifest_entry *entry = &files->entries[index];
+    chunk_entry *chunk;
+    u_llong offset = 0;
+    size_t fill = 0, size;
+    ssize_t got;
+    int file_desc, last;
+
+    if ((file_desc = open(entry->path, O_RDONLY)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    while (offset < entry->size) {
+        while (fill < CHUNK_READ_SIZE && offset + fill < entry->size) {
+            got = pread(file_desc, buff + fill, CHUNK_READ_SIZE - fill, (off_t)(offset + fill));
+            if (got == -1 && errno == EINTR) continue;
+            if (got <= 0) {
+                print_error(got == 0 ? "File changed while being read." : strerror(errno), __LINE__);
+                close(file_desc);
+                return -1;
+            }
+            fill += (size_t)got;
+        }
+        if (offset + fill > entry->size) fill = (size_t)(entry->size - offset);
+        last = offset + fill == entry->size;
+
+        // cut while a whole chunk's worth is buffered, or the rest of the file is
+        size = 0;
+        while (size < fill && (fill - size >= CHUNK_MAX_SIZE || last)) {
+            if ((chunk = push_chunk(c, entry->offset + offset, (u_int)chunk_cut(buff + size, fill - size), index)) == NULL) {
+                close(file_desc);
+                return -1;
+            }
+            sha256_hash(buff + size, chunk->size, chunk->hash);
+            size += chunk->size;
+            offset += chunk->size;
+        }
+        memmove(buff, buff + size, fill - size);
+        fill -= size;
+    }
+    close(file_desc);
+    return 0;
+}
+
+int chunk_list_build(chunk_list *c, manifest *files) {
+    u_char *buff;
+    u_int i;
+    int rv = 0;
+
+    if ((buff = malloc(CHUNK_READ_SIZE)) == NULL) return -1;
+    for (i = 0; i < files->count && rv == 0; i++) {
+        if (files->entries[i].size == STREAM_SIZE) rv = -1;     // a stream can't be read twice
+        else if (!S_ISDIR(files->entries[i].mode) && files->entries[i].size > 0) rv = chunk_file(c, files, i, buff);
+    }
+    free(buff);
+    return rv;
+}
+
+long chunk_list_encode(chunk_list *c, u_char **out) {
+    size_t len = (size_t)c->count * CHUNK_RECORD_SIZE;
+    u_char *data;
+    u_int i;
+
+    if ((data = malloc(len ? len : 1)) == NULL) return -1;
+    *out = data;
+    for (i = 0; i < c->count; i++) {
+        memcpy(data, &c->entries[i].size, sizeof(u_int));  data += sizeof(u_int);
+        memcpy(data, c->entries[i].hash, SHA256_SIZE);      data += SHA256_SIZE;
+    }
+    return (long)len;
+}
+
+int chunk_list_decode(chunk_list *c, const u_char *data, size_t len, manifest *files) {
+    manifest_entry *entry;
+    chunk_entry *chunk;
+    u_llong offset;
+    u_int size, i;
+    size_t pos = 0;
+
+    if (len % CHUNK_RECORD_SIZE != 0) return -1;
+    for (i = 0; i < files->count; i++) {
+        entry = &files->entries[i];
+        if (entry->size == STREAM_SIZE) return -1;
+        if (S_ISDIR(entry->mode)) continue;
+        // the chunks of a file go on until they add up to its size
+        for (offset = 0; offset < entry->size; offset += size) {
+            if (pos == len) return -1;
+            memcpy(&size, data + pos, sizeof(u_int));
+            if (size == 0 || size > CHUNK_MAX_SIZE || size > entry->size - offset) return -1;
+            if ((chunk = push_chunk(c, entry->offset + offset, size, i)) == NULL) return -1;
+            memcpy(chunk->hash, data + pos + sizeof(u_int), SHA256_SIZE);
+            pos += CHUNK_RECORD_SIZE;
+        }
+    }
+    return pos == len ? 0 : -1;
+}
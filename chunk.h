@@ -0,0 +1,88 @@
+/**
+ * @file chunk.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief content-defined chunks of the data stream, each known by its SHA-256
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include "manifest.h"
+#include "packet.h"
+#include "sha256.h"
+
+#define CHUNK_MIN_SIZE (16 << 10)       // never cut before this many bytes
+#define CHUNK_AVG_SIZE (64 << 10)       // cut harder before it, easier after, so most come out near it
+#define CHUNK_MAX_SIZE (256 << 10)      // always cut here
+#define CHUNK_MASK_HARD (~0ULL << 46)   // 18 bits of the hash have to be 0 to cut before the average
+#define CHUNK_MASK_EASY (~0ULL << 50)   // 14 bits after it
+#define CHUNK_RECORD_SIZE (sizeof(u_int) + SHA256_SIZE)
+
+/*
+ * chunk Design:
+ *
+ * Each file is cut into chunks where its content says to, not at fixed offsets, so
+ * bytes inserted or removed early in a file only change the chunks around them, and
+ * every chunk after is cut the same as before. A gear hash rolls over the bytes (shifted
+ * left one bit and added to a random number for the next byte, so it only depends on the
+ * last 64 of them), and a chunk ends where its top bits are all 0. It is harder to cut
+ * before CHUNK_AVG_SIZE and easier after (normalized chunking, as in FastCDC), which
+ * keeps chunk sizes close to it.
+ *
+ * A chunk never runs across two files, and every file of the data stream is covered by
+ * its chunks in order, so the chunk list only has to carry the size and SHA-256 of each:
+ * its offset follows from the ones before it and the manifest.
+ *
+ * On the wire, each chunk is:
+ *  u_int  size
+ *  u_char hash[SHA256_SIZE]
+ */
+
+typedef struct chunk_entry {
+    u_llong offset;                 // in the data stream
+    u_int size;
+    u_int file;                     // manifest entry it is in
+    u_char hash[SHA256_SIZE];
+} chunk_entry;
+
+typedef struct chunk_list {
+    chunk_entry *entries;
+    u_int count;
+    u_int capacity;
+} chunk_list;
+
+/**
+ * Initialize an empty chunk list.
+ */
+void chunk_list_init(chunk_list *c);
+
+/**
+ * Free every chunk of a chunk list.
+ */
+void chunk_list_free(chunk_list *c);
+
+/**
+ * Returns the size of the chunk at the start of len bytes of data, which are the rest of a
+ * file or at least CHUNK_MAX_SIZE of it.
+ */
+size_t chunk_cut(const u_char *data, size_t len);
+
+/**
+ * Reads every file of the manifest and cuts it into chunks, hashing each one.
+ */
+int chunk_list_build(chunk_list *c, manifest *files);
+
+/**
+ * Serializes the chunk list into a newly allocated buffer. Returns its size, or -1.
+ */
+long chunk_list_encode(chunk_list *c, u_char **out);
+
+/**
+ * Fills the chunk list from a serialized one, for the files of the manifest. Fails unless
+ * the chunks cover every file exactly.
+ */
+int chunk_list_decode(chunk_list *c, const u_char *data, size_t len, manifest *files);
+
+#endif
@@ -6,9 +6,15 @@
  * @date 2022-03-14
  */
 
-#include "packet.h"
+#include <stdlib.h>
 
-#define IS_SERVER 0
+#include "dedup.h"
+#include "log.h"
+#include "manifest.h"
+#include "packet.h"
+#include "progress.h"
+#include "replica.h"
+#include "rft.h"
 
 /*
  * This Program makes reliable file transfers using a protocol that I designed.
@@ -18,264 +24,168 @@
  * specific header and values.
  */
 
-// struct for storing connection and message data
-typedef struct connection {
-    struct addrinfo *p;
-    int socket_desc;
-} connection;
-
-// send the packet and information. Can print the packet being sent, because it has already been parsed
-int send_data(connection *connect, Packet *packet, int line) {
-    int rv =  (int)sendto(connect->socket_desc, packet, get_packet_size(packet), 0, connect->p->ai_addr, connect->p->ai_addrlen);
-    if (rv == -1) print_error(strerror(errno), line);
-    else                    print_packet(packet, 1, IS_SERVER);
-    return rv;
-}
-
-// received the packet and information. Cannot print the packet that was received, because it has not already been parsed
-int recv_data(connection *connect, Packet *packet) {
-    return (int)recvfrom(connect->socket_desc, packet, sizeof(Packet), 0, connect->p->ai_addr, &connect->p->ai_addrlen);
-}
-
-int send_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num) {
-    // for acknowledgement:       2 is ACK packet
-    set_packet_header(ack_packet, 2, 0, ack_num, 100, sizeof(packet_header));
-    return send_data(connect, ack_packet, __LINE__);
+// build the request from the file and directory names entered, separated by spaces.
+// Returns 1 if none were entered, which after the first request ends the session
+int handle_file_names(char *request, u_short *request_size, char *remote_path, u_char type, int first) {
+    char line[MAX_BUFFER_SIZE];
+    const char *names[MAX_BUFFER_SIZE / 2];
+    char *name;
+    int count = 0;
+
+    fprintf(print_stream(), "\nEnter file or directory names%s: ", first ? "" : " (or nothing to finish)");
+    fflush(print_stream());
+    if (fgets(line, sizeof(line), stdin) == NULL) line[0] = '\0';
+
+    for (name = strtok(line, " \t\n"); name != NULL; name = strtok(NULL, " \t\n")) names[count++] = name;
+    if (count == 0 && !first) return 1;
+    return rft_build_request(request, request_size, type, remote_path, names, count);
 }
 
-int wait_for_acknowledgement(connection *connect, Packet *send_packet, Packet *recv_packet, int i) {
-    int rv;
-    u_int seq_num, ack_num;
-    seq_num = send_packet->header.seq_num;
-
-    if (i < MAX_RETRIES) {  // if tried less than 8 times, wait to receive data
-
-        rv = recv_data(connect, recv_packet);
-        if (rv == -1) {   // if havent received data
-
-            rv = send_data(connect, send_packet, __LINE__); // resend data
-            if (rv == -1) return rv;
-
-            i = wait_for_acknowledgement(connect, send_packet, recv_packet, i+1);   // wait yet again
-            if (i == -1) return i;
-
-        } else {    // else have received data
-
-            print_packet(recv_packet, 0, IS_SERVER);
-            ack_num = recv_packet->header.seq_num;
-            if (!is_packet_acknowledgement(recv_packet) || ack_num != seq_num) {   // if not the correct response
-
-                rv = send_data(connect, send_packet, __LINE__); // resend data
-                if (rv == -1) return rv;
+// build the request for one file streamed to stdout or from stdin: the remote path names
+// the file itself, so it is split into the root and the name
+int handle_stream_name(char *request, u_short *request_size, char *remote_path, u_char type) {
+    char *slash = strrchr(remote_path, '/');
+    char *name = slash ? slash + 1 : remote_path;
+    size_t root_size = slash ? (size_t)(slash - remote_path) : 1, name_size = strlen(name) + 1;
 
-                i = wait_for_acknowledgement(connect, send_packet, recv_packet, i+1);   // wait yet again
-                if (i == -1) return i;
-            }
-        }
-        // is correct data, return
-        return rv;
-
-    } else {    // more than maximum number of tries, return error
-        print_error("Connection Closed.", __LINE__);
+    if (slash == remote_path) root_size = 1;    // a file right under /
+    if (name_size == 1) {
+        print_error("Remote Path has no file name!", __LINE__);
         return -1;
     }
-}
-
-int handle_connection(connection *connect, char *remote_file, char *local_file) {
-    FILE *file;
-    int rv, i = 0;
-    u_int seq_num = 1, temp;
-    u_short recv_size;
-
-    Packet send_packet = init_packet();
-    Packet recv_packet = init_packet();
-
-    // for inital request           1 is SEQ packet
-    set_packet_header(&send_packet, 1, 0, seq_num, 100, strlen(remote_file));
-    memcpy(send_packet.buff, remote_file, strlen(remote_file));
-    
-    // send request header
-    rv = send_data(connect, &send_packet, __LINE__);
-    if (rv == -1) return rv;
-    
-    // wait for acknowledgement
-    rv = wait_for_acknowledgement(connect, &send_packet, &recv_packet, 1);
-    if (rv == -1) {
-        return rv;
-    }
-    
-    // open local file
-    if ((file = fopen(local_file, "w")) == NULL) {
-        print_error(strerror(errno), __LINE__);
+    if (2 + root_size + name_size > MAX_BUFFER_SIZE) {
+        print_error("Remote Path is too big!", __LINE__);
         return -1;
     }
-
-    do {    // while is not a finale packet, and tried less than 8 times
-        rv = recv_data(connect, &recv_packet);
-        // didn't receive data
-        if (rv == -1) {
-            printf(".");
-            fflush(stdout);
-            i++;
-        } else {    // received data
-            i = 0;
-            
-            print_packet(&recv_packet, 0, IS_SERVER);
-            temp = recv_packet.header.seq_num;
-
-            // if is a sequence packet
-            if (is_packet_sequence(&recv_packet)) {
-                
-                // if correct next packet
-                if (temp == seq_num+1) {
-                    // write data to file, move to next packet
-                    seq_num = temp;
-                    recv_size = recv_packet.header.data_size;
-                    fwrite(recv_packet.buff, recv_size, 1, file);
-                    memset(recv_packet.buff, 0, MAX_BUFFER_SIZE);
-                }
-
-                // send acknowledgement, regardless if its next packet or previous packet
-                rv = send_acknowledgement(connect, &send_packet, seq_num);
-                if (rv == -1) return rv;
-
-            // not a sequence packet. Should either be an error or a finale
-            } else {
-                fclose(file);
-
-                // send acknowledgement
-                rv = send_acknowledgement(connect, &send_packet, temp);
-                if (rv == -1) return rv;
-
-                // if it is an error packet
-                if (is_packet_error(&recv_packet)) {
-                    print_error_msg(&recv_packet, __LINE__);
-                    return -1;
-
-                // else if it is a finale packet
-                } else if (is_packet_finale(&recv_packet)) {
-                    printf("\nFile Transfer Complete!");
-                }
-
-            }
-        }
-    } while (!is_packet_finale(&recv_packet) && i < MAX_RETRIES);
-
-    if (i >= MAX_RETRIES) {
-        print_error("Connection Closed.", __LINE__);
-        return -1;
-    }
-    
+    request[0] = (char)type;
+    if (slash)                                      memcpy(request + 1, remote_path, root_size);
+    else if (strcmp(name, STREAM_PATH) == 0)        request[1] = STREAM_PATH[0];    // the server's stdin or stdout
+    else                                            request[1] = '.';
+    request[1 + root_size] = '\0';
+    memcpy(request + 2 + root_size, name, name_size);
+    *request_size = (u_short)(2 + root_size + name_size);
     return 0;
 }
 
-void manage_file_path(char *file_buff, char *file_path, char *file_name) {
-    strncat(file_buff, file_path, strlen(file_path));
-    strncat(file_buff, file_name, strlen(file_name));
-    return;
-}
-
-int handle_file_names(char *remote_buff, char *local_buff, char *remote_path, char *local_path) {
-    char file_name[MAX_BUFFER_SIZE] = "/";
-    char *file_name_ptr = &file_name[1];
-    size_t remote_size = strlen(remote_path), local_size = strlen(local_path), file_size;
-
-    if (remote_size >= MAX_BUFFER_SIZE || local_size >= MAX_BUFFER_SIZE) {
-        print_error("Remote or Local Path are too big!", __LINE__);
-        return -1;
-    }
-
-    printf("\nEnter a file name: ");
-    scanf("%s", file_name_ptr);
-    file_size = strlen(file_name);
-
-    if ( (file_size+remote_size) >= MAX_BUFFER_SIZE || (file_size+local_size) >= MAX_BUFFER_SIZE) {
-        print_error("File name is too big!", __LINE__);
-        return -1;
+// open a session with every server: the one given, then each mirror (IP:Port). Returns
+// how many, or -1 if one can't be opened
+int connect_replicas(connection *replicas, char *server_ip, char *server_port, char **mirrors, int mirror_count) {
+    char *colon;
+    int i;
+
+    if (rft_connect(&replicas[0], server_ip, server_port) == -1) return -1;
+    for (i = 0; i < mirror_count; i++) {
+        if ((colon = strrchr(mirrors[i], ':')) == NULL) {
+            print_error("A mirror is <IP:Port>.", __LINE__);
+            return -1;
+        }
+        *colon = '\0';
+        if (rft_connect(&replicas[i + 1], mirrors[i], colon + 1) == -1) return -1;
     }
-    manage_file_path(remote_buff, remote_path, file_name);
-    manage_file_path(local_buff, local_path, file_name);
-
-    return 0;
+    return mirror_count + 1;
 }
 
 int main(int argc, char *argv[]) {
-    int rv;
+    int rv, opt, direct = 0, first = 1, count, mirror_count = 0, i, cpu = -1, machine = 0;
+    u_char type = REQUEST_GET;
 
-	char *SERVER_IP, *SERVER_PORT, *REMOTE_PATH, *LOCAL_PATH;
-    char remote_file[MAX_BUFFER_SIZE];
-    char local_file[MAX_BUFFER_SIZE];
-    memset(remote_file, 0, MAX_BUFFER_SIZE);
-    memset(local_file, 0, MAX_BUFFER_SIZE);
+	char *SERVER_IP, *SERVER_PORT, *REMOTE_PATH, *LOCAL_PATH, *cache_dir = NULL;
+    char *mirrors[MAX_REPLICAS - 1];
+    char request[MAX_BUFFER_SIZE];
+    u_short request_size;
 
-	int socket_desc;
-	struct addrinfo hints, *servInfo, *p;
-    struct timeval tv;
+    double rate = 0;
+    u_llong buffer_cap = 0;
+    u_int priority = 0, deadline = 0, refresh = 0;
 
-    connection connect;
-	time_t start, end;
+    connection replicas[MAX_REPLICAS];
+    connection *connect = &replicas[0];
+    rate_limiter limiter;
+    progress reporter;
 
 	// command line arguments
-	if (argc != 5) {
-        printf("\nArguments expected: <Server IP> <Server Port> <Remote Path> <Local Path>");
+    while ((opt = getopt(argc, argv, "b:c:DJm:p:P:r:t:uw:")) != -1) {
+        if      (opt == 'b') cpu = atoi(optarg);    // low latency: busy poll, pinned to this core
+        else if (opt == 'c') cache_dir = optarg;    // keep the chunks downloaded here, and download only the ones it doesn't have
+        else if (opt == 'D') direct = 1;            // O_DIRECT writes, for files much bigger than memory
+        else if (opt == 'J') machine = 1;           // report progress as JSON lines
+        else if (opt == 'm' && mirror_count < MAX_REPLICAS - 1) mirrors[mirror_count++] = optarg;  // another server with the same files
+        else if (opt == 'p') priority = (u_int)atoi(optarg);    // class of each request, 0 to 3
+        else if (opt == 'P') refresh = (u_int)atoi(optarg);     // report progress this often, in milliseconds
+        else if (opt == 'r') rate = atof(optarg);   // cap what is uploaded, in Mbit/s
+        else if (opt == 't') deadline = (u_int)atoi(optarg);    // of each request, in milliseconds
+        else if (opt == 'u') type = REQUEST_PUT;    // upload the local files instead
+        else if (opt == 'w') buffer_cap = (u_llong)atoll(optarg) << 10;  // most the window and socket buffers grow to, in KB
+        else                 optind = argc;         // unknown option, print what is expected
+    }
+	if (argc - optind != 4 || priority >= PRIORITY_CLASSES) {
+        fprintf(print_stream(), "\nArguments expected: [-b <CPU>] [-c <Cache Dir>] [-D] [-J] [-m <Mirror IP:Port>]... [-p <Priority 0-3>] [-P <Refresh ms>] [-r <Rate Mbit/s>] [-t <Deadline ms>] [-u] [-w <Window Cap KB>] <Server IP> <Server Port> <Remote Path> <Local Path>");
         return -1;
     }
-    SERVER_IP = argv[1];
-    SERVER_PORT = argv[2];
-    REMOTE_PATH = argv[3];
-    LOCAL_PATH = argv[4];
-    printf("server IP: %s\nserver port: %s\nremote path: %s\nlocal path: %s\n", SERVER_IP, SERVER_PORT, REMOTE_PATH, LOCAL_PATH);
-
-	memset(&hints, 0, sizeof(hints));// set all data in struct to 0
-	hints.ai_family = AF_INET;          // IPv4
-	hints.ai_socktype = SOCK_DGRAM;     // UDP
-
-	// set timer
-    tv.tv_sec = 2;
-    tv.tv_usec = 0;
-
-    rv = getaddrinfo(SERVER_IP, SERVER_PORT, &hints, &servInfo);
-    if (rv != 0) {
-        print_error("getaddrinfo failed.", __LINE__);
-        return rv;
+    SERVER_IP = argv[optind];
+    SERVER_PORT = argv[optind+1];
+    REMOTE_PATH = argv[optind+2];
+    LOCAL_PATH = argv[optind+3];
+    // stdout carries the data, so everything printed goes to stderr
+    if (type == REQUEST_GET && strcmp(LOCAL_PATH, STREAM_PATH) == 0) set_print_stream(stderr);
+    fprintf(print_stream(), "server IP: %s\nserver port: %s\nremote path: %s\nlocal path: %s\n", SERVER_IP, SERVER_PORT, REMOTE_PATH, LOCAL_PATH);
+
+    if (mirror_count > 0 && (type != REQUEST_GET || strcmp(LOCAL_PATH, STREAM_PATH) == 0)) {
+        print_error("Only files can be downloaded from mirrors.", __LINE__);
+        return -1;
     }
-
-    for (p = servInfo; p != NULL; p = p->ai_next) {
-        // socket(): creates a new socket, no address was assigned yet
-        socket_desc = socket(
-                p->ai_family,    // IPv4
-                p->ai_socktype,  // Streaming Protocol
-                p->ai_protocol   // UDP
-        );
-        if (socket_desc == -1) {
-            print_error(strerror(errno), __LINE__);
-            continue;
-        }
-        break;
+    if (cache_dir != NULL && (mirror_count > 0 || type != REQUEST_GET || strcmp(LOCAL_PATH, STREAM_PATH) == 0)) {
+        print_error("Only files downloaded from one server can use the cache.", __LINE__);
+        return -1;
     }
 
-    rv = setsockopt(socket_desc, SOL_SOCKET, SO_RCVTIMEO,(struct timeval *) &tv, sizeof(struct timeval));
-    if (rv == -1 && p == NULL) {
-        print_error(strerror(errno), __LINE__);
-        return rv;
+    count = connect_replicas(replicas, SERVER_IP, SERVER_PORT, mirrors, mirror_count);
+    if (count == -1) {
+        return count;
     }
-
-    rv = handle_file_names(remote_file, local_file, REMOTE_PATH, LOCAL_PATH);
-    if (rv == -1) {
-        return rv;
+    if (rate > 0 && rate_init(&limiter, (u_llong)(rate * 1e6 / 8), 0, 0) == 0) connect->limiter = &limiter;
+    for (i = 0; i < count; i++) {
+        replicas[i].priority = priority;
+        replicas[i].deadline = deadline;
+        replicas[i].buffer_cap = buffer_cap;
+        stats_init(&replicas[i].stats);
     }
 
-    freeaddrinfo(servInfo);
-
-    // set connection data
-    connect.p = p;
-    connect.socket_desc = socket_desc;
-
-    start = time(NULL);
-    rv = handle_connection(&connect, remote_file, local_file);
-    end = time(NULL);
-    printf("\nTime elapsed: %ld\n", end-start);
-    close(socket_desc);
+    log_start();
+    if ((refresh > 0 || machine) && progress_start(&reporter, replicas, count, refresh, machine) == -1) refresh = machine = 0;
+    // after the threads that don't need the core have started, so they don't inherit it.
+    // Mirrors each run on a thread of their own, so they spin without pinning it
+    rv = 0;
+    for (i = 0; cpu >= 0 && i < count && rv == 0; i++) rv = rft_low_latency(&replicas[i], count == 1 ? cpu : -1);
+
+    // one session: a request for each line of names entered, until an empty line (a stream is the one request)
+    while (rv != -1) {
+        if (strcmp(LOCAL_PATH, STREAM_PATH) == 0) rv = first ? handle_stream_name(request, &request_size, REMOTE_PATH, type) : 1;
+        else                                      rv = handle_file_names(request, &request_size, REMOTE_PATH, type, first);
+        if (rv != 0) break;
+
+        // with mirrors, every server sends part of the files at once
+        if (count > 1)              rv = rft_get_replicas(replicas, count, request, request_size, LOCAL_PATH);
+        else if (cache_dir != NULL) rv = rft_get_cached(connect, request, request_size, LOCAL_PATH, cache_dir);
+        else                        rv = rft_request(connect, request, request_size, LOCAL_PATH, direct);
+        if (rv == -1) break;
+        first = 0;
+    }
+    for (i = 0; i < count; i++) {
+        if (replicas[i].socket_desc == -1) continue;
+        if (rv == 1 && rft_close(&replicas[i]) == -1) rv = -1;
+    }
+    if (rv == 1) rv = 0;
+    if (refresh > 0 || machine) progress_stop(&reporter);
+    log_stop();
+    stats_finish(&connect->stats);
+    for (i = 1; i < count; i++) stats_merge(&connect->stats, &replicas[i].stats);
+    fprintf(print_stream(), "\nTime elapsed: %.3f\n", (double)(STATS_GET(connect->stats.end) - STATS_GET(connect->stats.start)) / 1e9);
+    stats_print_json(&connect->stats, stderr, "client");
+    for (i = 0; i < count; i++) {
+        if (replicas[i].socket_desc != -1) close(replicas[i].socket_desc);
+    }
+    if (connect->limiter != NULL) rate_free(&limiter);
 
     return rv;
 }
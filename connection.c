@@ -0,0 +1,346 @@
+/**
+ * @file connection.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief sending, receiving and acknowledging packets with the other side of a transfer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE     // ppoll(), pthread_setaffinity_np()
+
+#include "connection.h"
+
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/random.h>
+
+#include "log.h"
+
+// where the process could run before a thread was pinned, for the threads it starts
+static cpu_set_t unpinned_cpus;
+static _Atomic int pinned;
+
+u_llong new_connection_id(void) {
+    u_llong id = 0;
+    while (id == 0) {
+        // getrandom() only fails this small a read without entropy, so fall back on the clock
+        if (getrandom(&id, sizeof(id), GRND_NONBLOCK) != sizeof(id)) id = stats_now() * 0x9E3779B97F4A7C15ULL ^ (u_llong)getpid();
+    }
+    return id;
+}
+
+int pin_thread(int cpu) {
+    cpu_set_t cpus;
+    int rv;
+
+    if (!pinned && (rv = pthread_getaffinity_np(pthread_self(), sizeof(unpinned_cpus), &unpinned_cpus)) != 0) {
+        print_error(strerror(rv), __LINE__);
+        return -1;
+    }
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if ((rv = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) != 0) {
+        print_error(strerror(rv), __LINE__);
+        return -1;
+    }
+    pinned = 1;
+    return 0;
+}
+
+void unpin_thread(pthread_t thread) {
+    if (pinned) pthread_setaffinity_np(thread, sizeof(unpinned_cpus), &unpinned_cpus);
+    return;
+}
+
+int tune_buffer(connection *connect, int option, u_llong bytes) {
+    u_llong cap = connect->buffer_cap ? connect->buffer_cap : BUFFER_CAP;
+    u_llong *current = option == SO_RCVBUF ? &connect->rcvbuf : &connect->sndbuf;
+    socklen_t len = sizeof(int);
+    int value;
+
+    // start from the kernel's default (it reports twice what was asked for, the rest being
+    // its bookkeeping), so the buffer is never made smaller than that
+    if (*current == 0 && getsockopt(connect->socket_desc, SOL_SOCKET, option, &value, &len) == 0) *current = (u_llong)value / 2;
+    if (bytes > cap) bytes = cap;
+    if (bytes > INT_MAX) bytes = INT_MAX;
+    if (bytes <= *current) return 0;
+    value = (int)bytes;
+    // the FORCE options go past the sysctl limit, but only with CAP_NET_ADMIN
+    if (setsockopt(connect->socket_desc, SOL_SOCKET, option == SO_RCVBUF ? SO_RCVBUFFORCE : SO_SNDBUFFORCE, &value, sizeof(value)) == -1 &&
+        setsockopt(connect->socket_desc, SOL_SOCKET, option, &value, sizeof(value)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    // the plain options are cut down to the sysctl limit without a word, so what the
+    // receive buffer is advertised as holding is what the kernel really gave
+    if (getsockopt(connect->socket_desc, SOL_SOCKET, option, &value, &len) == 0) *current = (u_llong)value / 2;
+    else                                                                          *current = bytes;
+    return 0;
+}
+
+// packets the socket receive buffer has room for, no more than the receiver holds past a
+// gap. The kernel counts each packet at what was allocated for it (2.3 KB on loopback, 4 KB
+// or more from some NICs) against twice the size asked for, and only gives back what was
+// read a quarter of the buffer at a time, so a packet is counted at PACKET_BUFFER_COST
+static u_int receive_window(connection *connect) {
+    u_llong window;
+
+    if (connect->rcvbuf == 0) tune_buffer(connect, SO_RCVBUF, 0);
+    window = connect->rcvbuf / PACKET_BUFFER_COST;
+    if (window > WINDOW_SIZE) window = WINDOW_SIZE;
+    if (window < 2) window = 2;
+    return (u_int)window;
+}
+
+// send the packet and information. Can print the packet being sent, because it has already been parsed
+int send_data(connection *connect, Packet *packet, int line) {
+    u_llong now = stats_now();  // before sending: on loopback the reply can land before sendto() returns
+    int rv;
+    packet->header.conn_id = connect->conn_id;
+    rv = (int)sendto(connect->socket_desc, packet, get_packet_size(packet), 0, (struct sockaddr *)&connect->remote_addr, connect->addr_len);
+    if (rv == -1) {
+        print_error(strerror(errno), line);
+        return rv;
+    }
+    log_packet(LOG_EVENT_SEND, packet, connect->is_server);
+    connect->last_send = now;
+    STATS_ADD(connect->stats.packets_sent, 1);
+    STATS_ADD(connect->stats.bytes_sent, (u_llong)rv);
+    return rv;
+}
+
+// keep a packet that was received if it is whole and of this session, and answer whatever
+// address it came from from now on (the address can change under a session, NAT rebinding)
+static int accept_packet(connection *connect, Packet *packet, int len, struct sockaddr_storage *addr, socklen_t addr_len) {
+    STATS_ADD(connect->stats.packets_received, 1);
+    STATS_ADD(connect->stats.bytes_received, (u_llong)len);
+    if (!is_packet_valid(packet, len)) return 0;
+
+    // a request (SEQ 1) starts the session of a server that isn't in one yet
+    if (connect->is_server && connect->conn_id == 0 && is_packet_sequence(packet) && packet->header.seq_num == 1) {
+        connect->conn_id = packet->header.conn_id;
+    }
+    if (packet->header.conn_id != connect->conn_id) return 0;
+    memcpy(&connect->remote_addr, addr, addr_len);
+    connect->addr_len = addr_len;
+    return 1;
+}
+
+// received the packet and information. Cannot print the packet that was received, because it has not already been parsed
+int recv_data(connection *connect, Packet *packet) {
+    int rv, flags = 0;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    u_llong spin_end = 0;
+
+    // low latency: try without blocking until the spin budget runs out, so a packet that
+    // comes in soon is taken without the wakeup of a blocked thread
+    if (connect->spin_ns > 0) {
+        spin_end = stats_now() + connect->spin_ns;
+        flags = MSG_DONTWAIT;
+    }
+    while (1) {
+        addr_len = sizeof(addr);
+        rv = (int)recvfrom(connect->socket_desc, packet, sizeof(Packet), flags, (struct sockaddr *)&addr, &addr_len);
+        if (rv == -1) {
+            if (flags == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return rv;
+            if (stats_now() >= spin_end) flags = 0;
+            sched_yield();
+            continue;
+        }
+        if (accept_packet(connect, packet, rv, &addr, addr_len)) return rv;
+    }
+}
+
+int recv_batch(connection *connect, Packet *packets, int count) {
+    struct mmsghdr msgs[RECV_BATCH];
+    struct iovec iovs[RECV_BATCH];
+    struct sockaddr_storage addrs[RECV_BATCH];
+    int i, got, kept = 0;
+
+    if (count > RECV_BATCH) count = RECV_BATCH;
+    // until something of this session came in, or nothing more is waiting
+    do {
+        memset(msgs, 0, sizeof(msgs));
+        for (i = 0; i < count; i++) {
+            iovs[i].iov_base = &packets[i];
+            iovs[i].iov_len = sizeof(Packet);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+        }
+        got = recvmmsg(connect->socket_desc, msgs, (u_int)count, MSG_DONTWAIT, NULL);
+        if (got == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            print_error(strerror(errno), __LINE__);
+            return -1;
+        }
+        // packets of other sessions are dropped, and the ones kept close up behind each other
+        for (i = 0; i < got; i++) {
+            if (!accept_packet(connect, &packets[i], (int)msgs[i].msg_len, &addrs[i], msgs[i].msg_hdr.msg_namelen)) continue;
+            if (i != kept) memcpy(&packets[kept], &packets[i], msgs[i].msg_len);
+            kept++;
+        }
+    } while (kept == 0 && got == count);
+    return kept;
+}
+
+// low latency: poll the descriptors without blocking until one is ready, the spin budget
+// runs out, or until passes (0 for no limit). Returns what poll() last did
+static int spin_poll(connection *connect, struct pollfd *fds, nfds_t count, u_llong until) {
+    u_llong now = stats_now(), spin_end = now + connect->spin_ns;
+    int rv;
+
+    if (until != 0 && until < spin_end) spin_end = until;
+    do {
+        rv = poll(fds, count, 0);
+        if (rv != 0) return rv;
+        // returns at once on a core of its own, and lets the other side run on a shared one
+        sched_yield();
+        now = stats_now();
+    } while (now < spin_end);
+    return 0;
+}
+
+int wait_for_data(connection *connect, u_llong timeout_us) {
+    struct pollfd fd;
+    struct timespec timeout;
+    u_llong until = stats_now() + timeout_us * 1000, now;
+    int rv;
+
+    fd.fd = connect->socket_desc;
+    fd.events = POLLIN;
+    if (connect->spin_ns > 0) {
+        if ((rv = spin_poll(connect, &fd, 1, until)) != 0) return rv;
+        now = stats_now();
+        if (now >= until) return 0;
+        timeout_us = (until - now) / 1000;
+    }
+    timeout.tv_sec = (time_t)(timeout_us / 1000000);
+    timeout.tv_nsec = (long)(timeout_us % 1000000) * 1000;
+    return ppoll(&fd, 1, &timeout, NULL);
+}
+
+int wait_for_timer(connection *connect, int timer_desc, u_llong until) {
+    struct pollfd fds[2];
+    struct timespec timeout;
+    u_llong now, wait = 0;
+    int rv = 0;
+
+    fds[0].fd = connect->socket_desc;
+    fds[0].events = POLLIN;
+    fds[1].fd = timer_desc;
+    fds[1].events = POLLIN;
+    if (connect->spin_ns > 0) rv = spin_poll(connect, fds, 2, until);
+    if (rv == 0 && until != 0) {
+        now = stats_now();
+        if (until > now) wait = until - now;
+        timeout.tv_sec = (time_t)(wait / 1000000000ULL);
+        timeout.tv_nsec = (long)(wait % 1000000000ULL);
+    }
+    if (rv == 0) rv = ppoll(fds, 2, until != 0 ? &timeout : NULL, NULL);
+    if (rv == -1) {
+        if (errno == EINTR) return 0;
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    rv = 0;
+    if (fds[0].revents & POLLIN) rv |= WAIT_PACKET;
+    if (fds[1].revents & POLLIN) rv |= WAIT_TIMER;
+    return rv;
+}
+
+int send_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num) {
+    return send_selective_acknowledgement(connect, ack_packet, ack_num, NULL, 0);
+}
+
+int send_selective_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num, const u_llong *held, u_int words) {
+    // with how much of the data has landed, and how much more the socket can take
+    set_packet_acknowledgement(ack_packet, ack_num, stats_percent(STATS_GET(connect->stats.progress_bytes), STATS_GET(connect->stats.progress_size)),
+                               receive_window(connect), held, words);
+    return send_data(connect, ack_packet, __LINE__);
+}
+
+int keep_alive(connection *connect, Packet *ack_packet, u_int ack_num) {
+    if (stats_now() - connect->last_send < KEEPALIVE_NS) return 0;
+    return send_acknowledgement(connect, ack_packet, ack_num) == -1 ? -1 : 0;
+}
+
+int wait_for_acknowledgement(connection *connect, Packet *send_packet, Packet *recv_packet) {
+    int rv, tries = 1;
+    u_int seq_num, ack_num;
+    // wrong responses aren't tries, so a stream of them is only ended by how long it has been
+    u_llong give_up = stats_now() + (u_llong)MAX_RETRIES * SOCKET_TIMEOUT_S * 1000000000ULL;
+    seq_num = send_packet->header.seq_num;
+
+    while (tries < MAX_RETRIES && stats_now() < give_up) {   // if tried less than 8 times, wait to receive data
+        rv = recv_data(connect, recv_packet);
+        if (rv == -1) {   // if havent received data, resend and wait yet again
+            STATS_ADD(connect->stats.timeouts, 1);
+            STATS_ADD(connect->stats.retransmits, 1);
+            if (send_data(connect, send_packet, __LINE__) == -1) return -1;
+            tries++;
+            continue;
+        }
+
+        log_packet(LOG_EVENT_RECV, recv_packet, connect->is_server);
+        ack_num = recv_packet->header.seq_num;
+        if (is_packet_error(recv_packet) && !is_packet_error(send_packet)) {   // if the other side gave up
+            print_error_msg(recv_packet, __LINE__);
+            send_acknowledgement(connect, recv_packet, ack_num);
+            return -1;
+
+        } else if (is_packet_sequence(recv_packet) && (is_packet_sequence(send_packet) || is_packet_finale(send_packet)) &&
+                   ack_num == seq_num + 1) {
+
+            // the other side has moved on to sending, which it only does once it has our packet
+            if (tries == 1) stats_add_rtt(&connect->stats, stats_now() - connect->last_send);
+            return rv;
+
+        } else if (is_packet_acknowledgement(recv_packet) && ack_num != seq_num) {    // a late or duplicated ACK
+
+            // resending on it would draw a second ACK for every packet from then on, so just keep waiting
+            STATS_ADD(connect->stats.duplicate_acks, 1);
+
+        } else if (!is_packet_acknowledgement(recv_packet)) {   // if not the correct response, resend and wait yet again
+
+            // the other side may still be waiting on us. A FIN of an earlier transfer of the
+            // session is ACKed again, and none of these is a try: a link that duplicates or
+            // holds back packets delivers plenty of late copies, and only a timeout means
+            // nothing is getting through
+            if (is_packet_finale(recv_packet) && (int)(ack_num - connect->seq_num) <= 0) send_acknowledgement(connect, recv_packet, ack_num);
+            STATS_ADD(connect->stats.retransmits, 1);
+            if (send_data(connect, send_packet, __LINE__) == -1) return -1;
+
+        } else {    // is correct data, return. If the first copy was ACKed, the RTT is not ambiguous
+            if (tries == 1) stats_add_rtt(&connect->stats, stats_now() - connect->last_send);
+            return rv;
+        }
+    }
+    // more than maximum number of tries, return error
+    print_error("Connection Closed.", __LINE__);
+    return -1;
+}
+
+int send_finale_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int seq_num, u_llong stream_size) {
+    int rv;
+    // for finale packet:          3 is FIN packet
+    set_packet_header(send_packet, 3, 0, seq_num, 100, sizeof(packet_header));
+    send_packet->header.offset = stream_size;
+    rv = send_data(connect, send_packet, __LINE__);
+    if (rv == -1) return rv;
+    rv = wait_for_acknowledgement(connect, send_packet, recv_packet);
+    if (rv != -1) connect->seq_num = seq_num;
+    return rv;
+}
+
+// any result from this is to quit, so always return -1
+int send_error_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int error_num) {
+    // for error packet:           0 is ERR packet, with the seq_num of the request it ends
+    set_packet_header(send_packet, 0, error_num, connect->seq_num + 1, 100, sizeof(packet_header));
+    send_data(connect, send_packet, __LINE__);
+    wait_for_acknowledgement(connect, send_packet, recv_packet);
+    return -1;
+}
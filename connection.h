@@ -0,0 +1,154 @@
+/**
+ * @file connection.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief sending, receiving and acknowledging packets with the other side of a transfer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <pthread.h>
+
+#include "packet.h"
+#include "rate.h"
+#include "stats.h"
+
+#define WINDOW_SIZE 1024    // most data packets in flight at once, and held by the receiver past a gap (a multiple of 64)
+#define WINDOW_START 32     // packets a window lets in flight until it is autotuned
+#define BUFFER_CAP (4 << 20)    // most bytes the window and socket buffers are autotuned to, by default
+#define PACKET_BUFFER_COST (2 * sizeof(Packet))    // SO_RCVBUF bytes asked for each packet it is to hold
+#define RECV_BATCH 16       // packets recv_batch() takes in at once
+#define WAIT_PACKET 1       // wait_for_timer(): a packet came in
+#define WAIT_TIMER 2        // wait_for_timer(): the timerfd went off
+#define KEEPALIVE_NS 1000000000ULL     // most a side busy with its own work goes without sending, half the socket timeout
+#define SPIN_BUDGET_US 1000 // low latency: how long each wait spins before it blocks, by default
+
+// struct for storing connection and message data
+// what the last transfer this side sent learned of the path, so the next one of the
+// session starts from it rather than from scratch
+typedef struct path_state {
+    u_llong srtt, rttvar, rto;              // 0 until a transfer has been sent
+    u_int cwnd, ssthresh, limit, reordering;
+    u_llong ended;                          // when it ended, its cwnd is only kept if the session wasn't idle past an RTO
+} path_state;
+
+typedef struct connection {
+    struct sockaddr_storage remote_addr;    // where packets go, updated by every packet received
+    socklen_t addr_len;
+    int socket_desc;
+    int is_server;                          // for printing packets
+    u_llong conn_id;                        // session the packets belong to, 0 until a server gets a request
+    u_int seq_num;                          // last SEQ num of the session (its last FIN), the next request is one past it
+    u_llong last_send;                      // when the last packet went out, for RTT samples
+    rate_limiter *limiter;                  // caps what this side sends, or NULL
+    u_int weight;                           // of its share of the caps (1 if 0)
+    u_int priority;                         // class of the request, asked for by the client
+    u_int deadline;                         // of the request, in milliseconds, 0 for none
+    u_llong spin_ns;                        // each wait polls without blocking this long first, 0 to block right away
+    u_llong buffer_cap;                     // most bytes the window and each socket buffer are autotuned to, 0 for BUFFER_CAP
+    const char *upload_dir;                 // server: where uploads are written, under the name the client gives, NULL for .
+    u_llong rcvbuf;                         // socket buffer sizes the kernel gave so far, 0 until the first is asked for
+    u_llong sndbuf;
+    path_state path;
+    transfer_stats stats;
+} connection;
+
+/**
+ * Returns a new random connection ID, never 0.
+ */
+u_llong new_connection_id(void);
+
+/**
+ * Pins the calling thread to cpu, for low latency.
+ */
+int pin_thread(int cpu);
+
+/**
+ * Lets a thread started by a pinned one (which it inherits the pinning of) run wherever
+ * the process could before, so helpers like the disk reader don't share the pinned core.
+ */
+void unpin_thread(pthread_t thread);
+
+/**
+ * Grows the socket's SO_RCVBUF or SO_SNDBUF (option) to bytes, up to the connection's
+ * buffer cap. Never shrinks it. Past net.core.rmem_max or wmem_max, it takes CAP_NET_ADMIN
+ * to get the whole size.
+ */
+int tune_buffer(connection *connect, int option, u_llong bytes);
+
+/**
+ * Sends the packet to the other side, and prints it.
+ */
+int send_data(connection *connect, Packet *packet, int line);
+
+/**
+ * Receives a packet from the other side. Returns -1 on timeout (after spinning for
+ * spin_ns, if set, then blocking for the socket's receive timeout). Anything that isn't a
+ * packet of this session is dropped, and the other side is wherever the last packet of
+ * the session came from. A server joins the session of the first request it receives.
+ */
+int recv_data(connection *connect, Packet *packet);
+
+/**
+ * Receives every packet of the session waiting, up to count (at most RECV_BATCH), in one
+ * call, without blocking. Returns how many, 0 if none were waiting.
+ */
+int recv_batch(connection *connect, Packet *packets, int count);
+
+/**
+ * Waits up to timeout_us microseconds for a packet to come in, without receiving it.
+ * Returns 0 if none did. Like every wait, it spins for up to spin_ns before blocking.
+ */
+int wait_for_data(connection *connect, u_llong timeout_us);
+
+/**
+ * Waits for a packet to come in or timer_desc (a timerfd or eventfd) to become readable,
+ * without receiving or reading either, until then (CLOCK_MONOTONIC nanoseconds, 0 for no limit). Returns 0 if neither
+ * did by then, else WAIT_PACKET and/or WAIT_TIMER.
+ */
+int wait_for_timer(connection *connect, int timer_desc, u_llong until);
+
+/**
+ * Sends an ACK packet for ack_num. Every ACK advertises the packets the socket receive
+ * buffer has room for, which the sender keeps its window to.
+ */
+int send_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num);
+
+/**
+ * Sends an ACK packet for ack_num, with a bitmap of words u_llongs of the packets held
+ * past it: bit i of word k is ack_num+1+64k+i (a SACK).
+ */
+int send_selective_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num, const u_llong *held, u_int words);
+
+/**
+ * Keeps the session alive while this side is busy for longer than the other side waits
+ * for it: sends an ACK of ack_num if nothing was sent for KEEPALIVE_NS. The other side
+ * only hears it, whatever it is waiting for. Returns -1 if it couldn't be sent, else 0.
+ */
+int keep_alive(connection *connect, Packet *ack_packet, u_int ack_num);
+
+/**
+ * Waits for the ACK of send_packet, resending it on every timeout or wrong response,
+ * trying up to MAX_RETRIES times (and for MAX_RETRIES socket timeouts at most, however
+ * many wrong responses come), and skipping late ACKs. An ERR packet from the other
+ * side ends the wait.
+ * The next SEQ packet from the other side also ACKs it (a request is answered with the
+ * first data right away, and a FIN with the next request), and is left in recv_packet.
+ */
+int wait_for_acknowledgement(connection *connect, Packet *send_packet, Packet *recv_packet);
+
+/**
+ * Sends a FIN packet carrying the size of the data stream, and waits for its ACK. The
+ * next request of the session, one past it, ACKs it too, and is left in recv_packet.
+ */
+int send_finale_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int seq_num, u_llong stream_size);
+
+/**
+ * Sends an ERR packet, numbered as the request it ends, and waits for its ACK. Always
+ * returns -1.
+ */
+int send_error_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int error_num);
+
+#endif
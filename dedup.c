@@ -0,0 +1,274 @@
+/**
+ * @file dedup.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief downloading only the chunks missing from a local cache
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "dedup.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "receiver.h"
+#include "rft.h"
+
+// temporary names of chunks being added to the cache, unique across this process
+static _Atomic u_int temp_count;
+
+// pread() or pwrite() all size bytes at offset
+static int read_at(int file_desc, u_char *buff, size_t size, off_t offset) {
+    ssize_t n;
+    while (size > 0) {
+        n = pread(file_desc, buff, size, offset);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buff += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int write_at(int file_desc, const u_char *buff, size_t size, off_t offset) {
+    ssize_t n;
+    while (size > 0) {
+        n = pwrite(file_desc, buff, size, offset);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        buff += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+// the name a chunk is kept under in the cache, the hex of its hash
+static char *cache_path(const char *dir, const u_char *hash) {
+    size_t len = strlen(dir);
+    char *path = malloc(len + 2 + 2 * SHA256_SIZE);
+    int i;
+
+    if (path == NULL) return NULL;
+    memcpy(path, dir, len);
+    path[len++] = '/';
+    for (i = 0; i < SHA256_SIZE; i++) len += (size_t)sprintf(path + len, "%02x", hash[i]);
+    return path;
+}
+
+// read a chunk from the cache into buff. Returns 1 if it is there and hashes right, else 0
+static int cache_get(const char *dir, chunk_entry *chunk, u_char *buff) {
+    u_char hash[SHA256_SIZE];
+    char *path = cache_path(dir, chunk->hash);
+    struct stat st;
+    int file_desc, found = 0;
+
+    if (path == NULL || (file_desc = open(path, O_RDONLY)) == -1) {
+        free(path);
+        return 0;
+    }
+    if (fstat(file_desc, &st) == 0 && st.st_size == (off_t)chunk->size && read_at(file_desc, buff, chunk->size, 0) == 0) {
+        sha256_hash(buff, chunk->size, hash);
+        found = memcmp(hash, chunk->hash, SHA256_SIZE) == 0;
+    }
+    close(file_desc);
+    free(path);
+    return found;
+}
+
+// add a chunk to the cache, under a temporary name renamed into place once it is whole.
+// A chunk that can't be kept is only left out of the cache
+static void cache_put(const char *dir, chunk_entry *chunk, const u_char *buff) {
+    char *path = cache_path(dir, chunk->hash), *temp = NULL;
+    size_t size;
+    int file_desc;
+
+    if (path != NULL) {
+        size = strlen(path) + 32;
+        if ((temp = malloc(size)) != NULL) snprintf(temp, size, "%s.%ld-%u", path, (long)getpid(), atomic_fetch_add(&temp_count, 1));
+    }
+    if (temp == NULL) {
+        free(path);
+        return;
+    }
+    if ((file_desc = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1) {
+        print_error(strerror(errno), __LINE__);
+    } else if (write_at(file_desc, buff, chunk->size, 0) == -1 || close(file_desc) == -1 || rename(temp, path) == -1) {
+        print_error(strerror(errno), __LINE__);
+        unlink(temp);
+    }
+    free(temp);
+    free(path);
+    return;
+}
+
+// the local file a chunk is in, keeping the one opened last open for the chunks after it
+static int chunk_file_desc(manifest *files, chunk_entry *chunk, int flags, int *file_desc, u_int *index) {
+    if (*file_desc != -1 && *index == chunk->file) return *file_desc;
+    if (*file_desc != -1) close(*file_desc);
+    *index = chunk->file;
+    if ((*file_desc = open(files->entries[chunk->file].path, flags)) == -1) print_error(strerror(errno), __LINE__);
+    return *file_desc;
+}
+
+// write every chunk the cache has into place, and mark the rest missing. Reading and hashing
+// a large file takes longer than the server waits for the next request, so the session is
+// kept alive meanwhile
+static int copy_cached(connection *connect, Packet *packet, manifest *files, chunk_list *chunks, u_char *missing, char *cache_dir, u_char *buff, u_llong *cached) {
+    chunk_entry *chunk;
+    int file_desc = -1, rv = 0;
+    u_int i, index = 0;
+
+    for (i = 0; i < chunks->count && rv == 0; i++) {
+        chunk = &chunks->entries[i];
+        if (keep_alive(connect, packet, connect->seq_num) == -1) {
+            rv = -1;
+            break;
+        }
+        if (!cache_get(cache_dir, chunk, buff)) {
+            missing[i] = 1;
+            continue;
+        }
+        if (chunk_file_desc(files, chunk, O_WRONLY, &file_desc, &index) == -1) {
+            rv = -1;
+        } else if (write_at(file_desc, buff, chunk->size, (off_t)(chunk->offset - files->entries[chunk->file].offset)) == -1) {
+            print_error(strerror(errno), __LINE__);
+            rv = -1;
+        }
+        *cached += chunk->size;
+    }
+    if (file_desc != -1) close(file_desc);
+    return rv;
+}
+
+// download every missing chunk, as the parts of ranged GETs with as many parts as fit in
+// a request. Missing chunks next to each other are one part
+static int fetch_missing(connection *connect, chunk_list *chunks, u_char *missing, char *request, u_short request_size, char *local_path, stream_range *probe) {
+    stream_range range;
+    chunk_entry *chunk;
+    byte_range *part;
+    u_int i = 0, max;
+
+    if (request_size + REQUEST_RANGE_SIZE(1) > MAX_BUFFER_SIZE) {
+        print_error("No room in the request for the chunks to download.", __LINE__);
+        return -1;
+    }
+    max = (u_int)((MAX_BUFFER_SIZE - request_size - REQUEST_RANGE_SIZE(0)) / (2 * sizeof(u_llong)));
+    if (max > MAX_RANGE_PARTS) max = MAX_RANGE_PARTS;
+
+    while (i < chunks->count) {
+        memset(&range, 0, sizeof(range));
+        range.manifest_data = probe->manifest_data;
+        range.manifest_len = probe->manifest_len;
+        for (; i < chunks->count; i++) {
+            if (!missing[i]) continue;
+            chunk = &chunks->entries[i];
+            part = &range.parts[range.count > 0 ? range.count - 1 : 0];
+            if (range.count > 0 && part->end == chunk->offset) {
+                part->end += chunk->size;
+                continue;
+            }
+            if (range.count == max) break;
+            part = &range.parts[range.count++];
+            part->start = chunk->offset;
+            part->end = chunk->offset + chunk->size;
+        }
+        if (range.count == 0) break;
+        if (rft_request_range(connect, request, request_size, local_path, &range) == -1) return -1;
+    }
+    return 0;
+}
+
+// check every chunk downloaded against its hash, and add it to the cache, keeping the
+// session alive as copy_cached() does
+static int keep_missing(connection *connect, Packet *packet, manifest *files, chunk_list *chunks, u_char *missing, char *cache_dir, u_char *buff) {
+    u_char hash[SHA256_SIZE];
+    chunk_entry *chunk;
+    int file_desc = -1, rv = 0;
+    u_int i, index = 0;
+
+    for (i = 0; i < chunks->count && rv == 0; i++) {
+        if (!missing[i]) continue;
+        chunk = &chunks->entries[i];
+        if (keep_alive(connect, packet, connect->seq_num) == -1 || chunk_file_desc(files, chunk, O_RDONLY, &file_desc, &index) == -1) {
+            rv = -1;
+        } else if (read_at(file_desc, buff, chunk->size, (off_t)(chunk->offset - files->entries[chunk->file].offset)) == -1) {
+            print_error(strerror(errno), __LINE__);
+            rv = -1;
+        } else {
+            sha256_hash(buff, chunk->size, hash);
+            if (memcmp(hash, chunk->hash, SHA256_SIZE) != 0) {
+                print_error("A chunk doesn't match the chunk list.", __LINE__);
+                rv = -1;
+            } else {
+                cache_put(cache_dir, chunk, buff);
+            }
+        }
+    }
+    if (file_desc != -1) close(file_desc);
+    return rv;
+}
+
+int rft_get_cached(connection *connect, char *request, u_short request_size, char *local_path, char *cache_dir) {
+    stream_range probe;
+    manifest files;
+    chunk_list chunks;
+    u_char *buff = NULL, *missing = NULL;
+    u_llong cached = 0;
+    int rv = -1;
+
+    Packet packet = init_packet();
+
+    if (REQUEST_TYPE(request[0]) != REQUEST_GET || strcmp(local_path, STREAM_PATH) == 0) {
+        print_error("Only a GET of files can use the cache.", __LINE__);
+        return -1;
+    }
+    if (mkdir(cache_dir, 0755) == -1 && errno != EEXIST) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+
+    // the manifest and the chunk list, with none of the data
+    memset(&probe, 0, sizeof(probe));
+    probe.chunks = 1;
+    manifest_init(&files);
+    chunk_list_init(&chunks);
+    if (rft_request_range(connect, request, request_size, local_path, &probe) == -1) goto done;
+    if (manifest_decode(&files, probe.manifest_data, probe.manifest_len, local_path) == -1 ||
+        chunk_list_decode(&chunks, probe.chunk_data, probe.chunk_len, &files) == -1) {
+        print_error("Bad chunk list.", __LINE__);
+        goto done;
+    }
+    if (create_entries(&files) == -1) {
+        print_error("Could not create the files.", __LINE__);
+        goto done;
+    }
+    buff = malloc(CHUNK_MAX_SIZE);
+    missing = calloc(chunks.count ? chunks.count : 1, 1);
+    if (buff == NULL || missing == NULL) {
+        print_error("Could not allocate chunks.", __LINE__);
+        goto done;
+    }
+
+    // the progress is of every file, and what the cache has is already done
+    stats_begin_progress(&connect->stats, files.total_size);
+    if (copy_cached(connect, &packet, &files, &chunks, missing, cache_dir, buff, &cached) == -1) goto done;
+    STATS_ADD(connect->stats.progress_bytes, cached);
+    fprintf(print_stream(), "\n%llu of %llu bytes are in the cache", cached, files.total_size);
+    if (fetch_missing(connect, &chunks, missing, request, request_size, local_path, &probe) == -1) goto done;
+    if (keep_missing(connect, &packet, &files, &chunks, missing, cache_dir, buff) == -1) goto done;
+    restore_modes(&files);
+    fprintf(print_stream(), "\nFile Transfer Complete!");
+    rv = 0;
+
+done:
+    free(buff);
+    free(missing);
+    chunk_list_free(&chunks);
+    manifest_free(&files);
+    free(probe.manifest_data);
+    free(probe.chunk_data);
+    return rv;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file dedup.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief downloading only the chunks missing from a local cache
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "chunk.h"
+#include "connection.h"
+#include "packet.h"
+
+/*
+ * dedup Design:
+ *
+ * New versions of the same files tend to share most of their bytes with the old ones.
+ * A download that uses the cache first asks for the chunk list of the files (a ranged GET
+ * with nothing in the range, and the chunks flag), which comes after their manifest. Every
+ * chunk already in the cache is copied into place, and the rest are asked for as the parts
+ * of a ranged GET, as many as fit in one request. Adjacent missing chunks are one part.
+ *
+ * The cache is a directory of chunks, each a file named by the hex of its SHA-256, so the
+ * same bytes are kept once however many files and versions share them. A chunk read from
+ * the cache is hashed again, and one that doesn't match is downloaded instead. A chunk
+ * downloaded is hashed too, and only kept if it matches the chunk list, which also checks
+ * the files came through as the server has them. Chunks are written to the cache under a
+ * temporary name and renamed, so several downloads can share one cache.
+ */
+
+/**
+ * Downloads the files a GET request names into local_path, taking every chunk it can from
+ * the cache in cache_dir (created if it isn't there), and adding the ones downloaded.
+ * Returns 0 once every file is in and checked, -1 if not.
+ */
+int rft_get_cached(connection *connect, char *request, u_short request_size, char *local_path, char *cache_dir);
+
+#endif
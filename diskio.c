@@ -0,0 +1,402 @@
+/**
+ * @file diskio.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief asynchronous positional disk reads and writes (io_uring or thread pool)
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "diskio.h"
+
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/*
+ * io_uring backend, talking to the kernel directly (no liburing).
+ */
+
+static int uring_setup(u_int entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, u_int to_submit, u_int min_complete, u_int flags) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_init(disk_uring *ur, u_int depth) {
+    struct io_uring_params params;
+    u_char *sq, *cq;
+    u_int i;
+
+    memset(ur, 0, sizeof(*ur));
+    memset(&params, 0, sizeof(params));
+    ur->reqs = calloc(depth, sizeof(disk_req));
+    ur->moved = calloc(depth, sizeof(size_t));
+    ur->free_index = calloc(depth, sizeof(u_int));
+    if (ur->reqs == NULL || ur->moved == NULL || ur->free_index == NULL) goto fail_reqs;
+    for (i = 0; i < depth; i++) ur->free_index[i] = depth - 1 - i;
+    ur->free_count = depth;
+
+    ur->ring_fd = uring_setup(depth, &params);
+    if (ur->ring_fd == -1) goto fail_reqs;
+
+    ur->sq_size = params.sq_off.array + params.sq_entries * sizeof(u_int);
+    ur->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ur->cq_size > ur->sq_size) ur->sq_size = ur->cq_size;
+        ur->cq_size = 0;
+    }
+
+    ur->sq_ptr = mmap(NULL, ur->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_SQ_RING);
+    if (ur->sq_ptr == MAP_FAILED) goto fail_ring;
+
+    if (ur->cq_size == 0) {
+        ur->cq_ptr = ur->sq_ptr;
+    } else {
+        ur->cq_ptr = mmap(NULL, ur->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_CQ_RING);
+        if (ur->cq_ptr == MAP_FAILED) goto fail_sq;
+    }
+
+    ur->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ur->sqes = mmap(NULL, ur->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ur->ring_fd, IORING_OFF_SQES);
+    if (ur->sqes == MAP_FAILED) goto fail_cq;
+
+    sq = (u_char *)ur->sq_ptr;
+    cq = (u_char *)ur->cq_ptr;
+    ur->sq_head  = (u_int *)(sq + params.sq_off.head);
+    ur->sq_tail  = (u_int *)(sq + params.sq_off.tail);
+    ur->sq_mask  = (u_int *)(sq + params.sq_off.ring_mask);
+    ur->sq_array = (u_int *)(sq + params.sq_off.array);
+    ur->cq_head  = (u_int *)(cq + params.cq_off.head);
+    ur->cq_tail  = (u_int *)(cq + params.cq_off.tail);
+    ur->cq_mask  = (u_int *)(cq + params.cq_off.ring_mask);
+    ur->cqes     = cq + params.cq_off.cqes;
+    return 0;
+
+fail_cq:
+    if (ur->cq_ptr != ur->sq_ptr) munmap(ur->cq_ptr, ur->cq_size);
+fail_sq:
+    munmap(ur->sq_ptr, ur->sq_size);
+fail_ring:
+    close(ur->ring_fd);
+fail_reqs:
+    free(ur->reqs);
+    free(ur->moved);
+    free(ur->free_index);
+    return -1;
+}
+
+static void uring_free(disk_uring *ur) {
+    munmap(ur->sqes, ur->sqes_size);
+    if (ur->cq_ptr != ur->sq_ptr) munmap(ur->cq_ptr, ur->cq_size);
+    munmap(ur->sq_ptr, ur->sq_size);
+    close(ur->ring_fd);
+    free(ur->reqs);
+    free(ur->moved);
+    free(ur->free_index);
+    return;
+}
+
+// put what is left of request i on the submission queue
+static void uring_push(disk_uring *ur, u_int i) {
+    struct io_uring_sqe *sqe;
+    disk_req *req = &ur->reqs[i];
+    u_int tail = *ur->sq_tail;
+    u_int index = tail & *ur->sq_mask;
+
+    sqe = &((struct io_uring_sqe *)ur->sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = req->is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = req->fd;
+    sqe->addr = (unsigned long)((u_char *)req->buff + ur->moved[i]);
+    sqe->len = (u_int)(req->len - ur->moved[i]);
+    sqe->off = (unsigned long long)(req->offset + (off_t)ur->moved[i]);
+    sqe->user_data = i;
+    ur->sq_array[index] = index;
+
+    __atomic_store_n(ur->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ur->to_submit++;
+    return;
+}
+
+static void uring_queue(disk_uring *ur, disk_req *req) {
+    u_int i = ur->free_index[--ur->free_count];
+    ur->reqs[i] = *req;
+    ur->moved[i] = 0;
+    uring_push(ur, i);
+    return;
+}
+
+static int uring_submit(disk_uring *ur, u_int min_complete) {
+    int rv;
+    u_int flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+    if (ur->to_submit == 0 && min_complete == 0) return 0;
+
+    do {
+        rv = uring_enter(ur->ring_fd, ur->to_submit, min_complete, flags);
+    } while (rv == -1 && errno == EINTR);
+    if (rv == -1) return -1;
+    ur->to_submit -= (u_int)rv;
+    return 0;
+}
+
+static int uring_reap(disk_uring *ur, disk_done *done, int max) {
+    struct io_uring_cqe *cqe;
+    int n = 0, res, resubmit = 0;
+    u_int head = *ur->cq_head, i;
+
+    while (n < max && head != __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE)) {
+        cqe = &((struct io_uring_cqe *)ur->cqes)[head & *ur->cq_mask];
+        i = (u_int)cqe->user_data;
+        res = cqe->res;
+        head++;
+        if (res == -EINTR || res == -EAGAIN) {
+            uring_push(ur, i);
+            resubmit = 1;
+            continue;
+        }
+        if (res > 0) ur->moved[i] += (size_t)res;
+        // like pread()/pwrite(), go on until all of it is done, an error, or the end of the file
+        if (res > 0 && ur->moved[i] < ur->reqs[i].len) {
+            uring_push(ur, i);
+            resubmit = 1;
+            continue;
+        }
+        done[n].tag = ur->reqs[i].tag;
+        done[n].result = res < 0 ? res : (long)ur->moved[i];
+        ur->free_index[ur->free_count++] = i;
+        n++;
+    }
+    __atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+    if (resubmit && uring_submit(ur, 0) == -1) return -1;
+    return n;
+}
+
+/*
+ * thread pool backend, plain pread()/pwrite().
+ */
+
+static long pool_do(disk_req *req) {
+    ssize_t rv;
+    size_t done = 0;
+    while (done < req->len) {
+        if (req->is_write) rv = pwrite(req->fd, (u_char *)req->buff + done, req->len - done, req->offset + (off_t)done);
+        else               rv = pread(req->fd, (u_char *)req->buff + done, req->len - done, req->offset + (off_t)done);
+        if (rv == -1) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (rv == 0) break;     // end of file
+        done += (size_t)rv;
+    }
+    return (long)done;
+}
+
+static void *pool_worker(void *arg) {
+    disk_io *io = (disk_io *)arg;
+    disk_pool *pool = &io->pool;
+    disk_req req;
+    long result;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->req_count == 0 && !pool->stop) pthread_cond_wait(&pool->work, &pool->lock);
+        if (pool->req_count == 0) break;
+
+        req = pool->reqs[pool->req_head];
+        pool->req_head = (pool->req_head + 1) % io->depth;
+        pool->req_count--;
+        pthread_mutex_unlock(&pool->lock);
+
+        result = pool_do(&req);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->dones[(pool->done_head + pool->done_count) % io->depth].tag = req.tag;
+        pool->dones[(pool->done_head + pool->done_count) % io->depth].result = result;
+        pool->done_count++;
+        pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static int pool_init(disk_io *io) {
+    disk_pool *pool = &io->pool;
+    int i, rv;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->reqs = calloc(io->depth, sizeof(disk_req));
+    pool->dones = calloc(io->depth, sizeof(disk_done));
+    if (pool->reqs == NULL || pool->dones == NULL) {
+        free(pool->reqs);
+        free(pool->dones);
+        return -1;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (i = 0; i < DISK_IO_POOL_SIZE; i++) {
+        rv = pthread_create(&pool->threads[i], NULL, pool_worker, io);
+        if (rv != 0) {
+            print_error(strerror(rv), __LINE__);
+            break;
+        }
+    }
+    if (i == DISK_IO_POOL_SIZE) return 0;
+
+    // stop the workers that did start before giving up
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    while (i-- > 0) pthread_join(pool->threads[i], NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool->reqs);
+    free(pool->dones);
+    return -1;
+}
+
+static void pool_free(disk_io *io) {
+    disk_pool *pool = &io->pool;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < DISK_IO_POOL_SIZE; i++) pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    free(pool->reqs);
+    free(pool->dones);
+    return;
+}
+
+static void pool_queue(disk_io *io, disk_req *req) {
+    disk_pool *pool = &io->pool;
+    pthread_mutex_lock(&pool->lock);
+    pool->reqs[(pool->req_head + pool->req_count + pool->batch_count) % io->depth] = *req;
+    pool->batch_count++;
+    pthread_mutex_unlock(&pool->lock);
+    return;
+}
+
+static void pool_submit(disk_io *io) {
+    disk_pool *pool = &io->pool;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->batch_count > 0) {
+        pool->req_count += pool->batch_count;
+        pool->batch_count = 0;
+        pthread_cond_broadcast(&pool->work);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return;
+}
+
+static int pool_reap(disk_io *io, disk_done *done, int max, int wait) {
+    disk_pool *pool = &io->pool;
+    int n = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (wait && pool->done_count == 0) pthread_cond_wait(&pool->done, &pool->lock);
+    while (n < max && pool->done_count > 0) {
+        done[n++] = pool->dones[pool->done_head];
+        pool->done_head = (pool->done_head + 1) % io->depth;
+        pool->done_count--;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return n;
+}
+
+/*
+ * public interface
+ */
+
+int disk_io_init(disk_io *io, u_int depth, int backend) {
+    memset(io, 0, sizeof(*io));
+    io->depth = depth;
+
+    if (backend != DISK_IO_THREADS && uring_init(&io->uring, depth) == 0) {
+        io->backend = DISK_IO_URING;
+        return 0;
+    }
+    io->backend = DISK_IO_THREADS;
+    return pool_init(io);
+}
+
+void disk_io_free(disk_io *io) {
+    if (io->backend == DISK_IO_URING) uring_free(&io->uring);
+    else                              pool_free(io);
+    return;
+}
+
+int disk_io_backend_from_env(void) {
+    char *name = getenv("RFT_DISK_IO");
+    if (name == NULL)                  return DISK_IO_AUTO;
+    if (strcmp(name, "uring") == 0)    return DISK_IO_URING;
+    if (strcmp(name, "threads") == 0)  return DISK_IO_THREADS;
+    return DISK_IO_AUTO;
+}
+
+const char *disk_io_backend_name(disk_io *io) {
+    return io->backend == DISK_IO_URING ? "io_uring" : "thread pool";
+}
+
+static int disk_io_queue(disk_io *io, disk_req *req) {
+    if (io->pending >= io->depth) return -1;
+    if (io->backend == DISK_IO_URING) uring_queue(&io->uring, req);
+    else                              pool_queue(io, req);
+    io->pending++;
+    return 0;
+}
+
+int disk_io_read(disk_io *io, int fd, void *buff, size_t len, off_t offset, void *tag) {
+    disk_req req = { fd, 0, buff, len, offset, tag };
+    return disk_io_queue(io, &req);
+}
+
+int disk_io_write(disk_io *io, int fd, void *buff, size_t len, off_t offset, void *tag) {
+    disk_req req = { fd, 1, buff, len, offset, tag };
+    return disk_io_queue(io, &req);
+}
+
+int disk_io_submit(disk_io *io) {
+    if (io->backend == DISK_IO_URING) return uring_submit(&io->uring, 0);
+    pool_submit(io);
+    return 0;
+}
+
+int disk_io_complete(disk_io *io, disk_done *done, int max, int wait) {
+    int n;
+    if (wait && io->pending == 0) return 0;
+
+    if (io->backend == DISK_IO_URING) {
+        n = uring_reap(&io->uring, done, max);
+        // a short result is resubmitted instead of reaped, so a wait may have to go on
+        while (n == 0 && (wait || io->uring.to_submit > 0)) {
+            if (uring_submit(&io->uring, wait ? 1 : 0) == -1) return -1;
+            n = uring_reap(&io->uring, done, max);
+            if (!wait) break;
+        }
+        if (n == -1) return -1;
+    } else {
+        if (wait) pool_submit(io);
+        n = pool_reap(io, done, max, wait);
+    }
+    io->pending -= (u_int)n;
+    return n;
+}
+
+u_int disk_io_pending(disk_io *io) {
+    return io->pending;
+}
+
+int disk_io_has_room(disk_io *io) {
+    return io->pending < io->depth;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file diskio.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief asynchronous positional disk reads and writes (io_uring or thread pool)
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef DISKIO_H
+#define DISKIO_H
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "packet.h"
+
+#define DISK_IO_AUTO    0
+#define DISK_IO_URING   1
+#define DISK_IO_THREADS 2
+
+#define DISK_IO_POOL_SIZE 4
+
+/*
+ * disk_io Design:
+ *
+ * Requests are queued with disk_io_read()/disk_io_write() without making any system
+ * calls, then handed to the kernel (or the worker threads) as one batch with
+ * disk_io_submit(). Completions are reaped with disk_io_complete(), and are
+ * identified by the tag passed in with the request.
+ *
+ * At most depth requests can be queued or in flight at once.
+ *
+ * Backends:
+ *  - io_uring:    one io_uring_enter() per batch, no threads. A short read or write is
+ *                 resubmitted for what is left, so a completion is always of the whole
+ *                 request (or up to the end of the file), as with the thread pool.
+ *  - thread pool: DISK_IO_POOL_SIZE threads doing pread()/pwrite(), used when
+ *                 io_uring isn't available (old kernel, seccomp, ...).
+ */
+
+typedef struct disk_done {
+    void *tag;
+    long result;    // bytes transferred, or -errno
+} disk_done;
+
+typedef struct disk_req {
+    int fd;
+    int is_write;
+    void *buff;
+    size_t len;
+    off_t offset;
+    void *tag;
+} disk_req;
+
+typedef struct disk_uring {
+    int ring_fd;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    u_int *sq_head, *sq_tail, *sq_mask, *sq_array;
+    u_int *cq_head, *cq_tail, *cq_mask;
+    void *sqes;
+    void *cqes;
+    u_int to_submit;
+    disk_req *reqs;     // in flight, by the index in their user_data
+    size_t *moved;      // bytes each has moved so far, what a short one has left is resubmitted
+    u_int *free_index;  // indexes of reqs not in flight
+    u_int free_count;
+} disk_uring;
+
+typedef struct disk_pool {
+    pthread_t threads[DISK_IO_POOL_SIZE];
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    disk_req *reqs;     // submitted, waiting for a worker
+    disk_done *dones;   // finished, waiting to be reaped
+    u_int req_head, req_count;
+    u_int done_head, done_count;
+    u_int batch_count;  // queued, not yet submitted (at the end of reqs)
+    int stop;
+} disk_pool;
+
+typedef struct disk_io {
+    int backend;
+    u_int depth;
+    u_int pending;      // queued + in flight
+    disk_uring uring;
+    disk_pool pool;
+} disk_io;
+
+/**
+ * Sets up a disk_io for up to depth outstanding requests. backend is DISK_IO_AUTO,
+ * DISK_IO_URING or DISK_IO_THREADS; AUTO and URING fall back to the thread pool.
+ */
+int disk_io_init(disk_io *io, u_int depth, int backend);
+
+/**
+ * Tears down a disk_io. All requests must have been reaped.
+ */
+void disk_io_free(disk_io *io);
+
+/**
+ * Returns the backend named by the RFT_DISK_IO environment variable ("uring" or
+ * "threads"), or DISK_IO_AUTO.
+ */
+int disk_io_backend_from_env(void);
+
+/**
+ * Returns the name of the backend in use.
+ */
+const char *disk_io_backend_name(disk_io *io);
+
+/**
+ * Queues a read of len bytes at offset into buff. Returns -1 if depth is reached.
+ */
+int disk_io_read(disk_io *io, int fd, void *buff, size_t len, off_t offset, void *tag);
+
+/**
+ * Queues a write of len bytes from buff at offset. Returns -1 if depth is reached.
+ */
+int disk_io_write(disk_io *io, int fd, void *buff, size_t len, off_t offset, void *tag);
+
+/**
+ * Submits every queued request as one batch.
+ */
+int disk_io_submit(disk_io *io);
+
+/**
+ * Reaps up to max completions into done. If wait is true, blocks until at least one
+ * is available (submitting anything still queued first). Returns the number reaped.
+ */
+int disk_io_complete(disk_io *io, disk_done *done, int max, int wait);
+
+/**
+ * Returns the number of requests queued or in flight.
+ */
+u_int disk_io_pending(disk_io *io);
+
+/**
+ * Returns true if another request can be queued.
+ */
+int disk_io_has_room(disk_io *io);
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * @file log.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief leveled packet tracing through per-thread rings, printed by a background thread
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "log.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+int log_level = LOG_INFO;
+
+#define LOG_FREE     0  // owned: no thread has the ring, the next one to log takes it over
+#define LOG_OWNED    1  // owned: a thread writes into it
+
+// every thread's ring, newest first. A ring is never taken off it or freed, as any thread
+// may be walking it, or writing into its ring, at any time: they go with the process
+static _Atomic(log_buffer *) log_buffers;
+static __thread log_buffer *my_buffer;
+static __thread int my_buffer_failed;
+static pthread_key_t log_key;               // gives the ring back when its thread exits
+static pthread_once_t log_key_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+static _Atomic int log_running;
+static u_llong log_start_time;
+
+static u_llong log_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_llong)ts.tv_sec * 1000000000ULL + (u_llong)ts.tv_nsec;
+}
+
+// let go of a thread's ring, for the next thread that logs. Only ever called by the thread
+// that owns it
+static void log_put_buffer(void *arg) {
+    log_buffer *buffer = (log_buffer *)arg;
+    atomic_store(&buffer->owned, LOG_FREE);
+    return;
+}
+
+static void log_make_key(void) {
+    pthread_key_create(&log_key, log_put_buffer);
+    return;
+}
+
+// the calling thread's ring, taken over from a thread that released one, or made and
+// added to the list, the first time it logs
+static log_buffer *log_get_buffer(void) {
+    log_buffer *buffer;
+    int free_ring;
+
+    if (my_buffer != NULL || my_buffer_failed) return my_buffer;
+    pthread_once(&log_key_once, log_make_key);
+    for (buffer = atomic_load(&log_buffers); buffer != NULL; buffer = buffer->next) {
+        free_ring = LOG_FREE;
+        if (atomic_compare_exchange_strong(&buffer->owned, &free_ring, LOG_OWNED)) {
+            my_buffer = buffer;
+            pthread_setspecific(log_key, buffer);
+            return buffer;
+        }
+    }
+    if ((buffer = calloc(1, sizeof(log_buffer))) == NULL || ring_init(&buffer->records, LOG_BUFFER_SIZE, sizeof(log_record)) == -1) {
+        free(buffer);
+        my_buffer_failed = 1;
+        return NULL;
+    }
+    atomic_init(&buffer->owned, LOG_OWNED);
+    buffer->next = atomic_load(&log_buffers);
+    while (!atomic_compare_exchange_weak(&log_buffers, &buffer->next, buffer));
+    my_buffer = buffer;
+    pthread_setspecific(log_key, buffer);
+    return buffer;
+}
+
+static void log_print(log_record *record) {
+    static const char *events[] = { "send", "recv", "timeout" };
+    static const char *types[] = { "ERR", "SEQ", "ACK", "FIN" };
+    static const char *payloads[] = { "data", "hole", "manifest", "chunks" };
+    static const char *levels[] = { "error", "warn", "info", "debug", "trace" };
+    u_llong t = record->time - log_start_time;
+
+    fprintf(stderr, "t=%llu.%09llu level=%s side=%s event=%s", t / 1000000000ULL, t % 1000000000ULL,
+            levels[record->level], record->is_server ? "server" : "client", events[record->event]);
+    if (record->event != LOG_EVENT_TIMEOUT) {
+        fprintf(stderr, " type=%s seq=%u offset=%llu size=%u", types[record->info >> 6],
+                record->seq_num, record->offset, record->data_size);
+        if ((record->info >> 6) == 1) fprintf(stderr, " payload=%s", payloads[(record->info >> 4) & 3]);  // 1 is SEQ packet
+        if ((record->info >> 6) == 0) fprintf(stderr, " error=%u", (record->info >> 4) & 3);            // 0 is ERR packet
+    }
+    fputc('\n', stderr);
+    return;
+}
+
+// print everything waiting in every ring. Returns how many records were printed
+static int log_drain(void) {
+    log_buffer *buffer;
+    log_record *record;
+    int n = 0;
+
+    for (buffer = atomic_load(&log_buffers); buffer != NULL; buffer = buffer->next) {
+        while ((record = (log_record *)ring_try_read(&buffer->records)) != NULL) {
+            log_print(record);
+            ring_release(&buffer->records);
+            n++;
+        }
+    }
+    return n;
+}
+
+static void *log_drain_thread(void *arg) {
+    struct timespec ts;
+    (void)arg;
+
+    ts.tv_sec = 0;
+    ts.tv_nsec = LOG_DRAIN_NS;
+    while (atomic_load(&log_running)) {
+        if (log_drain() == 0) nanosleep(&ts, NULL);
+    }
+    log_drain();
+    return NULL;
+}
+
+int log_start(void) {
+    static const char *names[] = { "error", "warn", "info", "debug", "trace" };
+    char *env = getenv("RFT_LOG");
+    int i;
+
+    if (env != NULL) {
+        for (i = LOG_ERROR; i <= LOG_TRACE; i++) {
+            if (strcmp(env, names[i]) == 0) log_level = i;
+        }
+    }
+    log_start_time = log_now();
+    atomic_store(&log_running, 1);
+    if (pthread_create(&log_thread, NULL, log_drain_thread, NULL) != 0) {
+        atomic_store(&log_running, 0);
+        log_level = LOG_INFO;   // nothing would print the records
+        return -1;
+    }
+    return 0;
+}
+
+// the rings stay on the list, and their threads keep them: a thread still logging after
+// this only fills its ring up, and a log_start() after it prints what they held
+void log_stop(void) {
+    log_buffer *buffer;
+    u_llong dropped = 0;
+
+    if (!atomic_exchange(&log_running, 0)) return;
+    pthread_join(log_thread, NULL);
+
+    for (buffer = atomic_load(&log_buffers); buffer != NULL; buffer = buffer->next) {
+        dropped += atomic_exchange(&buffer->dropped, 0);
+    }
+    if (dropped > 0) fprintf(stderr, "log: %llu records dropped\n", dropped);
+    return;
+}
+
+void log_release(void) {
+    if (my_buffer == NULL) return;
+    pthread_setspecific(log_key, NULL);
+    log_put_buffer(my_buffer);
+    my_buffer = NULL;
+    return;
+}
+
+int log_enabled(int level) {
+    return level <= log_level;
+}
+
+static log_record *log_reserve(int level, int event, int is_server) {
+    log_buffer *buffer = log_get_buffer();
+    log_record *record;
+
+    if (buffer == NULL) return NULL;
+    if ((record = (log_record *)ring_try_write(&buffer->records)) == NULL) {
+        atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+        return NULL;
+    }
+    record->time = log_now();
+    record->level = (u_char)level;
+    record->event = (u_char)event;
+    record->is_server = (u_char)is_server;
+    return record;
+}
+
+void log_packet(int event, Packet *packet, int is_server) {
+    log_record *record;
+
+    if (LOG_TRACE > log_level) return;
+    if ((record = log_reserve(LOG_TRACE, event, is_server)) == NULL) return;
+    record->info = packet->header.info;
+    record->seq_num = packet->header.seq_num;
+    record->offset = packet->header.offset;
+    record->data_size = packet->header.data_size;
+    ring_commit(&my_buffer->records);
+    return;
+}
+
+void log_event(int level, int event, int is_server) {
+    log_record *record;
+
+    if (level > log_level) return;
+    if ((record = log_reserve(level, event, is_server)) == NULL) return;
+    ring_commit(&my_buffer->records);
+    return;
+}
@@ -0,0 +1,102 @@
+/**
+ * @file log.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief leveled packet tracing through per-thread rings, printed by a background thread
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdatomic.h>
+
+#include "packet.h"
+#include "ring.h"
+
+#define LOG_ERROR 0
+#define LOG_WARN  1
+#define LOG_INFO  2
+#define LOG_DEBUG 3
+#define LOG_TRACE 4
+
+#define LOG_EVENT_SEND    0     // a packet went out
+#define LOG_EVENT_RECV    1     // a packet came in
+#define LOG_EVENT_TIMEOUT 2     // nothing came in before the socket timeout
+
+#define LOG_BUFFER_SIZE 4096    // records each thread can have waiting to be printed (power of 2)
+#define LOG_DRAIN_NS 1000000    // how long the printing thread sleeps when there is nothing to print
+
+/*
+ * log Design:
+ *
+ * Logging a record never blocks and never makes a system call: the record is a fixed
+ * size binary struct written into a ring owned by the calling thread (one producer),
+ * and a background thread (the one consumer of every ring) formats and prints them.
+ * If a ring is full the record is dropped and counted, the network loop never waits.
+ *
+ * Records above log_level are thrown away before anything is written, so packet
+ * tracing (LOG_TRACE) costs one compare when it is off, which is the default.
+ *
+ * Every line printed is key=value pairs, with the time since log_start().
+ *
+ * Rings are never freed: a thread that is done with its ring (log_release(), or it exits)
+ * leaves it on the list for the next one to take over, so there are only ever as many as
+ * threads logged at once, and they go with the process. Any thread may walk the list at
+ * any time, so nothing on it can be freed while the process runs.
+ */
+
+typedef struct log_record {
+    u_llong time;               // CLOCK_MONOTONIC nanoseconds
+    u_llong offset;
+    u_int seq_num;
+    u_short data_size;
+    u_char info;                // packet header info byte
+    u_char event;
+    u_char level;
+    u_char is_server;
+} log_record;
+
+typedef struct log_buffer {
+    ring records;
+    _Atomic u_llong dropped;    // records lost to a full ring
+    _Atomic int owned;          // a thread writes into it, or it is free to be taken over
+    struct log_buffer *next;
+} log_buffer;
+
+extern int log_level;
+
+/**
+ * Sets log_level from the RFT_LOG environment variable (error, warn, info, debug or
+ * trace; info if unset) and starts the printing thread.
+ */
+int log_start(void);
+
+/**
+ * Prints every record still waiting and stops the printing thread. The rings are kept.
+ */
+void log_stop(void);
+
+/**
+ * Gives the calling thread's ring to the next thread that logs, so threads that come and
+ * go (one per transfer) don't each leave a ring behind. A thread that exits without it
+ * gives its ring back all the same.
+ */
+void log_release(void);
+
+/**
+ * Returns true if records of level are kept.
+ */
+int log_enabled(int level);
+
+/**
+ * Records a packet sent or received, at LOG_TRACE.
+ */
+void log_packet(int event, Packet *packet, int is_server);
+
+/**
+ * Records an event that has no packet, at level.
+ */
+void log_event(int level, int event, int is_server);
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * @file manifest.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief list of files sent together in one transfer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "manifest.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+// join two path pieces with a '/', in a newly allocated string
+char *join_path(const char *root, const char *name) {
+    size_t root_len = strlen(root), name_len = strlen(name);
+    char *path = malloc(root_len + name_len + 2);
+    if (path == NULL) return NULL;
+    memcpy(path, root, root_len);
+    path[root_len] = '/';
+    memcpy(path + root_len + 1, name, name_len + 1);
+    return path;
+}
+
+int manifest_push(manifest *m, char *path, char *name, u_llong size, u_int mode) {
+    manifest_entry *entries;
+    manifest_entry *entry;
+
+    if (m->count == m->capacity) {
+        m->capacity = m->capacity ? m->capacity * 2 : 16;
+        entries = realloc(m->entries, m->capacity * sizeof(manifest_entry));
+        if (entries == NULL) return -1;
+        m->entries = entries;
+    }
+    entry = &m->entries[m->count++];
+    entry->path = path;
+    entry->name = name;
+    entry->size = size;
+    entry->mode = mode;
+    entry->offset = m->total_size;
+    m->total_size += size;
+    return 0;
+}
+
+void manifest_init(manifest *m) {
+    memset(m, 0, sizeof(*m));
+    return;
+}
+
+void manifest_free(manifest *m) {
+    u_int i;
+    for (i = 0; i < m->count; i++) {
+        free(m->entries[i].path);
+        free(m->entries[i].name);
+    }
+    free(m->entries);
+    manifest_init(m);
+    return;
+}
+
+// byte order rather than the locale's, so every host lists the same names the same way
+int compare_names(const struct dirent **a, const struct dirent **b) {
+    return strcmp((*a)->d_name, (*b)->d_name);
+}
+
+int manifest_add_path(manifest *m, const char *root, const char *name) {
+    struct stat st;
+    struct dirent **list;
+    char *path, *entry_name, *child;
+    int rv = 0, count, i;
+
+    path = join_path(root, name);
+    entry_name = strdup(name);
+    if (path == NULL || entry_name == NULL) goto fail;
+
+    if (lstat(path, &st) == -1) goto fail;
+    if (!S_ISREG(st.st_mode) && !S_ISDIR(st.st_mode)) {
+        free(path);
+        free(entry_name);
+        return 0;
+    }
+    if (manifest_push(m, path, entry_name, S_ISREG(st.st_mode) ? (u_llong)st.st_size : 0, (u_int)st.st_mode) == -1) goto fail;
+    if (S_ISREG(st.st_mode)) return 0;
+
+    if ((count = scandir(path, &list, NULL, compare_names)) == -1) return -1;
+    for (i = 0; i < count; i++) {
+        if (rv == 0 && strcmp(list[i]->d_name, ".") != 0 && strcmp(list[i]->d_name, "..") != 0) {
+            if ((child = join_path(name, list[i]->d_name)) == NULL) {
+                rv = -1;
+            } else {
+                rv = manifest_add_path(m, root, child);
+                free(child);
+            }
+        }
+        free(list[i]);
+    }
+    free(list);
+    return rv;
+
+fail:
+    free(path);
+    free(entry_name);
+    return -1;
+}
+
+int manifest_add_stream(manifest *m, const char *name) {
+    char *path = strdup(STREAM_PATH), *entry_name = strdup(name);
+    if (path == NULL || entry_name == NULL || manifest_push(m, path, entry_name, STREAM_SIZE, S_IFREG | 0644) == -1) {
+        free(path);
+        free(entry_name);
+        return -1;
+    }
+    return 0;
+}
+
+int manifest_add_names(manifest *m, const char *root, const char *names, const char *end) {
+    const char *name;
+    for (name = names; name < end; name += strlen(name) + 1) {
+        if (manifest_add_path(m, root, name) == -1) return -1;
+    }
+    return 0;
+}
+
+long manifest_encode(manifest *m, u_char **out) {
+    u_int i;
+    u_short name_len;
+    size_t len = 0;
+    u_char *data;
+
+    for (i = 0; i < m->count; i++) len += MANIFEST_ENTRY_HEADER + strlen(m->entries[i].name);
+    if ((data = malloc(len ? len : 1)) == NULL) return -1;
+
+    *out = data;
+    for (i = 0; i < m->count; i++) {
+        name_len = (u_short)strlen(m->entries[i].name);
+        memcpy(data, &m->entries[i].size, sizeof(u_llong));   data += sizeof(u_llong);
+        memcpy(data, &m->entries[i].mode, sizeof(u_int));     data += sizeof(u_int);
+        memcpy(data, &name_len, sizeof(u_short));             data += sizeof(u_short);
+        memcpy(data, m->entries[i].name, name_len);           data += name_len;
+    }
+    return (long)len;
+}
+
+// true if a name from the wire would stay under the local root
+int is_safe_name(const char *name) {
+    const char *part = name;
+    if (name[0] == '\0' || name[0] == '/') return 0;
+    while (part != NULL) {
+        if (strncmp(part, "..", 2) == 0 && (part[2] == '/' || part[2] == '\0')) return 0;
+        part = strchr(part, '/');
+        if (part != NULL) part++;
+    }
+    return 1;
+}
+
+int manifest_decode(manifest *m, const u_char *data, size_t len, const char *local_root) {
+    u_llong size;
+    u_int mode;
+    u_short name_len;
+    char *name, *path;
+    size_t pos = 0;
+
+    while (pos < len) {
+        if (len - pos < MANIFEST_ENTRY_HEADER) return -1;
+        memcpy(&size, data + pos, sizeof(u_llong));       pos += sizeof(u_llong);
+        memcpy(&mode, data + pos, sizeof(u_int));         pos += sizeof(u_int);
+        memcpy(&name_len, data + pos, sizeof(u_short));   pos += sizeof(u_short);
+        if (len - pos < name_len) return -1;
+        if (m->count > 0 && (size == STREAM_SIZE || m->entries[0].size == STREAM_SIZE)) return -1;  // a stream is always alone
+
+        if ((name = malloc((size_t)name_len + 1)) == NULL) return -1;
+        memcpy(name, data + pos, name_len);
+        name[name_len] = '\0';
+        pos += name_len;
+
+        path = strcmp(local_root, STREAM_PATH) == 0 ? strdup(STREAM_PATH) : join_path(local_root, name);
+        if (!is_safe_name(name) || path == NULL) {
+            free(path);
+            free(name);
+            return -1;
+        }
+        if (manifest_push(m, path, name, size, mode) == -1) {
+            free(path);
+            free(name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+u_int manifest_find(manifest *m, u_llong offset) {
+    u_int low = 0, high = m->count, mid;
+    // first entry that ends after offset
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        if (m->entries[mid].offset + m->entries[mid].size <= offset) low = mid + 1;
+        else                                                         high = mid;
+    }
+    return low;
+}
+
+u_llong range_size(stream_range *range) {
+    u_llong size = 0;
+    u_int i;
+    for (i = 0; i < range->count; i++) size += range->parts[i].end - range->parts[i].start;
+    return size;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file manifest.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief list of files sent together in one transfer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include "packet.h"
+
+/*
+ * manifest Design:
+ *
+ * Every file of a transfer is sent as one data stream: the files are concatenated in
+ * manifest order, and each entry knows where it starts in that stream. Small files
+ * share packets, and a single FIN ends the whole transfer.
+ *
+ * Directories are entries too (size 0), so empty directories make it across. A directory
+ * is walked in byte order of the names in it, so hosts with the same files lay them out
+ * in the same data stream, and any part of it can be downloaded from any of them.
+ *
+ * A stream (stdin on the sender, stdout on the receiver, both named STREAM_PATH) has no
+ * size until it ends, so it is sent as STREAM_SIZE and is always the only entry. The
+ * FIN carries its real size.
+ *
+ * On the wire, each entry is:
+ *  u_llong size
+ *  u_int   mode
+ *  u_short name_len
+ *  char    name[name_len]  (relative to the requested path, no terminator)
+ */
+
+#define MANIFEST_ENTRY_HEADER (sizeof(u_llong) + sizeof(u_int) + sizeof(u_short))
+#define STREAM_PATH "-"         // local path of stdin or stdout
+#define STREAM_SIZE (~0ULL)     // size of a stream, until it ends
+#define MAX_RANGE_PARTS 64      // parts of the data stream one ranged request asks for at most
+
+typedef struct manifest_entry {
+    char *path;         // where the file is on this host
+    char *name;         // name relative to the request, as sent on the wire
+    u_llong size;
+    u_int mode;
+    u_llong offset;     // where the file starts in the transfer's data stream
+} manifest_entry;
+
+typedef struct manifest {
+    manifest_entry *entries;
+    u_int count;
+    u_int capacity;
+    u_llong total_size;
+} manifest;
+
+// a part of the data stream
+typedef struct byte_range {
+    u_llong start;          // first byte sent
+    u_llong end;            // byte after the last, the server stops at the end of the stream
+} byte_range;
+
+// the parts of the data stream sent for a ranged request, in order and not overlapping
+typedef struct stream_range {
+    byte_range parts[MAX_RANGE_PARTS];
+    u_int count;
+    int chunks;             // the chunk list is asked for, and sent after the manifest
+    u_char *manifest_data;  // receiver: the manifest the sender's has to match, or NULL to keep it here
+    size_t manifest_len;
+    u_char *chunk_data;     // the chunk list: sender, to send; receiver, as it came (freed by the caller)
+    size_t chunk_len;
+} stream_range;
+
+/**
+ * Initialize an empty manifest.
+ */
+void manifest_init(manifest *m);
+
+/**
+ * Free every entry of a manifest.
+ */
+void manifest_free(manifest *m);
+
+/**
+ * Adds root/name to the manifest, and if it is a directory, everything under it.
+ * Symbolic links and special files are skipped.
+ */
+int manifest_add_path(manifest *m, const char *root, const char *name);
+
+/**
+ * Adds stdin, sent under name. Its size isn't known until it ends.
+ */
+int manifest_add_stream(manifest *m, const char *name);
+
+/**
+ * Adds root/name for every '\0' terminated name between names and end.
+ */
+int manifest_add_names(manifest *m, const char *root, const char *names, const char *end);
+
+/**
+ * Serializes the manifest into a newly allocated buffer. Returns its size, or -1.
+ */
+long manifest_encode(manifest *m, u_char **out);
+
+/**
+ * Returns true if a name from the wire would stay under the directory it is put in: it is
+ * not empty or absolute, and no part of it is ..
+ */
+int is_safe_name(const char *name);
+
+/**
+ * Fills the manifest from a serialized one. Every entry's path is local_root/name, or
+ * STREAM_PATH if local_root is. Names that are absolute or climb out with .. are rejected.
+ */
+int manifest_decode(manifest *m, const u_char *data, size_t len, const char *local_root);
+
+/**
+ * Returns the index of the entry holding offset of the data stream, skipping empty ones.
+ * Returns count if offset is past the end.
+ */
+u_int manifest_find(manifest *m, u_llong offset);
+
+/**
+ * Returns the bytes of the data stream in every part of the range.
+ */
+u_llong range_size(stream_range *range);
+
+#endif
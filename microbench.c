@@ -0,0 +1,185 @@
+/**
+ * @file microbench.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief micro-benchmarks of the per-packet kernels (header encode/decode, payload copy, zero scan, chunk cut, SHA-256)
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <stdlib.h>
+
+#include "chunk.h"
+#include "packet.h"
+#include "sparse.h"
+
+#define MICRO_MIN_NS 20000000ULL    // time each kernel for at least 20 ms...
+#define MICRO_ROUNDS 5              // ...this many times, and keep the fastest
+#define MICRO_MAX_SIZE CHUNK_MAX_SIZE
+
+/*
+ * Every kernel here runs once or more per packet, so this shows what each one costs per
+ * packet and how far from memory bandwidth it is. Each kernel runs in a loop, doubling the
+ * iterations until the loop takes MICRO_MIN_NS, and reports the fastest of MICRO_ROUNDS.
+ * The Makefile builds them, and the sources of the kernels, with optimizations on, as a
+ * release build would be. Chunk cut and SHA-256 run over every byte of the files when the
+ * chunk list is built, and SHA-256 again over every chunk a cached download touches. Chunk
+ * cut is only timed on inputs longer than CHUNK_MIN_SIZE, as it returns at once on the
+ * rest; the input repeats every 256 bytes, and no gear hash of it has the bits to cut, so
+ * it reads the whole input.
+ */
+
+typedef struct kernel {
+    const char *name;
+    int fixed_size;     // works on the header only, the same whatever the payload size
+    size_t min_size;    // shorter inputs aren't timed
+    u_llong (*run)(Packet *packet, u_char *buff, size_t size, u_llong i);
+} kernel;
+
+static Packet packets[2];
+static u_char source[MICRO_MAX_SIZE], target[MICRO_MAX_SIZE], zeros[MICRO_MAX_SIZE];
+
+// keep the compiler from dropping or hoisting the work between iterations
+#define BARRIER() __asm__ volatile("" ::: "memory")
+
+u_llong micro_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_llong)ts.tv_sec * 1000000000ULL + (u_llong)ts.tv_nsec;
+}
+
+u_llong run_header_encode(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)buff;
+    set_packet_header(packet, 1, 0, (u_int)i, 100, (u_short)size);     // 1 is SEQ packet
+    packet->header.offset = i * size;
+    return packet->header.info;
+}
+
+u_llong run_header_decode(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)buff;
+    (void)size;
+    (void)i;
+    return get_packet_type(packet) + get_packet_error(packet) + get_packet_size(packet) +
+           (u_llong)is_packet_hole(packet) + (u_llong)is_packet_manifest(packet) + packet->header.seq_num;
+}
+
+u_llong run_hole_encode(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)buff;
+    set_packet_hole(packet, (u_int)i, i * size, size);
+    return packet->header.info;
+}
+
+u_llong run_hole_decode(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)buff;
+    (void)size;
+    (void)i;
+    return is_packet_hole(packet) ? get_packet_hole(packet) : 0;
+}
+
+u_llong run_payload_copy(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)packet;
+    (void)i;
+    memcpy(target, buff, size);
+    return target[size-1];
+}
+
+// all zeros, so the whole buffer is scanned
+u_llong run_zero_scan(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)packet;
+    (void)buff;
+    (void)i;
+    return (u_llong)is_zero(zeros, size);
+}
+
+// up to CHUNK_MIN_SIZE is never looked at, so the gear hash runs over the rest
+u_llong run_chunk_cut(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)packet;
+    (void)i;
+    return chunk_cut(buff, size);
+}
+
+u_llong run_sha256(Packet *packet, u_char *buff, size_t size, u_llong i) {
+    (void)packet;
+    (void)i;
+    sha256_hash(buff, size, target);
+    return target[0];
+}
+
+static kernel kernels[] = {
+    { "header_encode", 1, 0, run_header_encode },
+    { "header_decode", 1, 0, run_header_decode },
+    { "hole_encode",   1, 0, run_hole_encode },
+    { "hole_decode",   1, 0, run_hole_decode },
+    { "payload_copy",  0, 0, run_payload_copy },
+    { "zero_scan",     0, 0, run_zero_scan },
+    { "chunk_cut",     0, CHUNK_MIN_SIZE + 1, run_chunk_cut },
+    { "sha256",        0, 0, run_sha256 },
+};
+
+// nanoseconds per call of the fastest round
+double measure(kernel *k, Packet *packet, size_t size, u_llong *sink) {
+    u_llong iterations, i, start, elapsed;
+    double best = 0, per_op;
+    int round;
+
+    for (round = 0; round < MICRO_ROUNDS; round++) {
+        for (iterations = 1024; ; iterations *= 2) {
+            start = micro_now();
+            for (i = 0; i < iterations; i++) {
+                *sink += k->run(packet, source, size, i);
+                BARRIER();
+            }
+            elapsed = micro_now() - start;
+            if (elapsed >= MICRO_MIN_NS) break;
+        }
+        per_op = (double)elapsed / (double)iterations;
+        if (round == 0 || per_op < best) best = per_op;
+    }
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes[] = { 16, 64, 256, 1024, MAX_BUFFER_SIZE, 65536, MICRO_MAX_SIZE };
+    size_t n_sizes = sizeof(sizes) / sizeof(sizes[0]), n_kernels = sizeof(kernels) / sizeof(kernels[0]);
+    size_t s, k, i, bytes;
+    int opt, csv = 0;
+    u_llong sink = 0;
+    double ns;
+
+    // command line arguments
+    while ((opt = getopt(argc, argv, "c")) != -1) {
+        if (opt == 'c') csv = 1;                // print CSV instead of a table
+        else            break;                  // unknown option, print what is expected
+    }
+    if (opt != -1 || optind != argc) {
+        printf("\nArguments expected: [-c]\n");
+        return -1;
+    }
+
+    for (i = 0; i < MICRO_MAX_SIZE; i++) source[i] = (u_char)(i * 31 + 7);
+    memset(zeros, 0, sizeof(zeros));
+    packets[0] = init_packet();
+    packets[1] = init_packet();
+    set_packet_header(&packets[0], 1, 0, 1, 100, MAX_BUFFER_SIZE);    // 1 is SEQ packet
+    set_packet_hole(&packets[1], 1, 0, MICRO_MAX_SIZE);
+
+    if (csv) printf("kernel,bytes,ns_per_op,gb_per_s\n");
+    else     printf("%-14s %8s %12s %10s\n", "kernel", "bytes", "ns/op", "GB/s");
+
+    for (k = 0; k < n_kernels; k++) {
+        for (s = 0; s < n_sizes; s++) {
+            // header kernels cost the same for any payload, so they are timed once
+            if (kernels[k].fixed_size && s > 0) break;
+            if (sizes[s] < kernels[k].min_size) continue;
+            bytes = kernels[k].fixed_size ? sizeof(packet_header) : sizes[s];
+            ns = measure(&kernels[k], &packets[kernels[k].run == run_hole_decode], sizes[s], &sink);
+
+            if (csv) printf("%s,%zu,%.3f,%.3f\n", kernels[k].name, bytes, ns, (double)bytes / ns);
+            else     printf("%-14s %8zu %12.3f %10.3f\n", kernels[k].name, bytes, ns, (double)bytes / ns);
+            fflush(stdout);
+        }
+    }
+
+    // the results have to be used, or the compiler may skip the work
+    fprintf(stderr, "sum of results: %llu\n", sink);
+    return 0;
+}
@@ -13,6 +13,8 @@ Packet init_packet(void) {
     new_packet.header.percent = 0x00;
     new_packet.header.data_size = 0;
     new_packet.header.seq_num = 0;
+    new_packet.header.offset = 0;
+    new_packet.header.conn_id = 0;
     memset(new_packet.buff, 0, MAX_BUFFER_SIZE);
     return new_packet;
 }
@@ -21,11 +23,12 @@ void set_packet_header(Packet *packet, u_int type, u_int error, u_int seq_num, u
     u_char temp;
     temp =        (u_char) ( (type << 6)           & 0xC0 );    // 0xC0  is  1100 0000
     temp = temp | (u_char) ( (error << 4)          & 0x30 );    // 0x30  is  0011 0000
-    temp = temp | (u_char) ( sizeof(packet_header) & 0x0F );    // 0x0F  is  0000 1111
+    temp = temp | (u_char) ( (sizeof(packet_header) / 4) & 0x0F );  // 0x0F  is  0000 1111
     packet->header.info = temp;
     packet->header.percent = (u_char)percent;
     packet->header.seq_num = seq_num;
     packet->header.data_size = data_size;
+    packet->header.offset = 0;
     return;
 }
 
@@ -41,6 +44,12 @@ u_short get_packet_size(Packet *packet) {
     return (u_short) ( sizeof(packet_header) + packet->header.data_size );
 }
 
+int is_packet_valid(Packet *packet, int size) {
+    if (size < (int)sizeof(packet_header)) return 0;
+    if ((packet->header.info & 0x0F) != sizeof(packet_header) / 4) return 0;  // 0x0F  is  0000 1111
+    return packet->header.data_size <= MAX_BUFFER_SIZE && size >= get_packet_size(packet);
+}
+
 int is_packet_error(Packet *packet) {
     return ( get_packet_type(packet) == 0 );
 }
@@ -49,14 +58,85 @@ int is_packet_sequence(Packet *packet) {
     return ( get_packet_type(packet) == 1 );
 }
 
+int is_packet_hole(Packet *packet) {
+    return ( is_packet_sequence(packet) && get_packet_error(packet) == 1 );
+}
+
+void set_packet_hole(Packet *packet, u_int seq_num, u_llong offset, u_llong length) {
+    // for hole packet:       1 is SEQ packet, 1 is Hole payload
+    set_packet_header(packet, 1, 1, seq_num, 100, sizeof(length));
+    packet->header.offset = offset;
+    memcpy(packet->buff, &length, sizeof(length));
+    return;
+}
+
+u_llong get_packet_hole(Packet *packet) {
+    u_llong length;
+    memcpy(&length, packet->buff, sizeof(length));
+    return length;
+}
+
+int is_packet_manifest(Packet *packet) {
+    return ( is_packet_sequence(packet) && get_packet_error(packet) == 2 );
+}
+
+int is_packet_chunks(Packet *packet) {
+    return ( is_packet_sequence(packet) && get_packet_error(packet) == 3 );
+}
+
 int is_packet_acknowledgement(Packet *packet) {
     return ( get_packet_type(packet) == 2 );
 }
 
+void set_packet_acknowledgement(Packet *packet, u_int ack_num, u_int percent, u_int window, const u_llong *held, u_int words) {
+    u_short size = (u_short)(sizeof(window) + (words > 1 ? words - 1 : 0) * sizeof(u_llong));
+
+    // for acknowledgement:       2 is ACK packet
+    set_packet_header(packet, 2, 0, ack_num, percent, size);
+    packet->header.offset = words > 0 ? held[0] : 0;
+    memcpy(packet->buff, &window, sizeof(window));
+    if (words > 1) memcpy(packet->buff + sizeof(window), held + 1, (words - 1) * sizeof(u_llong));
+    return;
+}
+
+u_int get_packet_window(Packet *packet) {
+    u_int window;
+
+    if (packet->header.data_size < sizeof(window)) return 0;
+    memcpy(&window, packet->buff, sizeof(window));
+    return window;
+}
+
+u_int get_packet_sack_size(Packet *packet) {
+    if (packet->header.data_size < sizeof(u_int)) return 64;
+    return 64 * (1 + (u_int)((packet->header.data_size - sizeof(u_int)) / sizeof(u_llong)));
+}
+
+int is_packet_sacked(Packet *packet, u_int i) {
+    u_llong word;
+
+    if (i < 64) return (int)(packet->header.offset >> i & 1);
+    if (i >= get_packet_sack_size(packet)) return 0;
+    memcpy(&word, packet->buff + sizeof(u_int) + (i / 64 - 1) * sizeof(u_llong), sizeof(word));
+    return (int)(word >> (i % 64) & 1);
+}
+
 int is_packet_finale(Packet *packet) {
     return ( get_packet_type(packet) == 3 );
 }
 
+// NULL until set_print_stream(), for stdout (which isn't a constant to start it at)
+static FILE *console;
+
+FILE *print_stream(void) {
+    return console != NULL ? console : stdout;
+}
+
+void set_print_stream(FILE *stream) {
+    console = stream;
+    return;
+}
+
 void print_packet(Packet *packet, int isSend, int isServer) {
     char *packet_type;
     char *arrow_dir;
@@ -69,13 +149,13 @@ void print_packet(Packet *packet, int isSend, int isServer) {
     if (isSend) arrow_dir = "->";
     else        arrow_dir = "<-";
 
-    if (isServer) printf("\nserver %s %s %d %s client", arrow_dir, packet_type, packet->header.seq_num, arrow_dir);
-    else printf("\nclient %s %s %d %s server", arrow_dir, packet_type, packet->header.seq_num, arrow_dir);
+    if (isServer) fprintf(print_stream(), "\nserver %s %s %d %s client", arrow_dir, packet_type, packet->header.seq_num, arrow_dir);
+    else fprintf(print_stream(), "\nclient %s %s %d %s server", arrow_dir, packet_type, packet->header.seq_num, arrow_dir);
     return;
 }
 
 void print_error(char *err, int line) {
-    printf("\nError: %s (line: %d)", err, line);
+    fprintf(print_stream(), "\nError: %s (line: %d)", err, line);
     return;
 }
 
@@ -84,7 +164,7 @@ void print_error_msg(Packet *packet, int line) {
     if      (error == 1) print_error("Bad Request!", line);
     else if (error == 2) print_error("file Not Found!", line);
     else if (error == 3) print_error("Unknown/Unhandled Error.", line);
-    else                 printf("\nNo Error Present.");
+    else                 fprintf(print_stream(), "\nNo Error Present.");
     return;
 }
 
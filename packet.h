@@ -20,10 +20,12 @@
 
 #define MAX_BUFFER_SIZE 1408
 #define MAX_RETRIES 8
+#define SOCKET_TIMEOUT_S 2  // how long a receive waits for a packet
 
 typedef unsigned char u_char;
 typedef unsigned short u_short;
 typedef unsigned int u_int;
+typedef unsigned long long u_llong;
 
 /*
  * packet_header Design:
@@ -39,26 +41,86 @@ typedef unsigned int u_int;
  *   - 10: ACK packet (acknowledgement)
  *   - 11: FIN packet (finale)
  * 
- *  B: Error Message Type
+ *  B: Error Message Type (ERR packets)
  *   - 00: No Error
  *   - 01: Bad Request
  *   - 10: File Not Found
  *   - 11: Unknown/Unhandled Error
+ *
+ *  B: Payload Type (SEQ packets)
+ *   - 00: Data, data_size bytes of the file starting at offset
+ *   - 01: Hole, offset is the start of a run of zeros, the payload is its u_llong length
+ *   - 10: Manifest, data_size bytes of the transfer's manifest starting at offset
+ *   - 11: Chunks, data_size bytes of the data stream's chunk list starting at offset
  * 
- *  C: Header Size (in bytes) (int this case, it's always 8, but if its ever over 15 this should be removed)
+ *  C: Header Size (in 4 byte words) (in this case, it's always 6, packets of any other size are dropped)
  * 
- * u_char percent
+ * u_char percent (on a data or hole packet, how much of the transfer's data its sender has sent
+ *                 so far, and on an ACK, how much its sender has landed, both 0 to 100.
+ *                 PERCENT_UNKNOWN until the size is known, and for a stream. 100 on the rest)
  * u_short data_size
  * u_int seq_num
+ * u_llong offset (offset of the payload in the data stream. On a FIN packet, its final size,
+ *                 or the size of the part sent for a ranged request.
+ *                 On a request, its deadline in milliseconds from when it is sent, 0 for none.
+ *                 On an ACK, a bitmap of the packets held past it, bit i for seq_num+1+i)
+ * u_llong conn_id (picked at random by the client, and the same on every packet of a session.
+ *                  A peer is known by it rather than by its address, so a session survives
+ *                  NAT rebinding, and packets of any other session are dropped)
  * 
- * Total Size: 8 Bytes
+ * Total Size: 24 Bytes
+ *
+ * An ACK's payload is the packets its sender has room for in its socket receive buffer
+ * (u_int window), then the rest of the bitmap of held packets, a u_llong for each 64
+ * packets past the first 64, as far as any are held.
  */
 
+/*
+ * Request Design (payload of the SEQ 1 packet that starts a transfer):
+ *
+ * u_char type:
+ *   0  1  2  3  4  5  6  7
+ *  |  C  |  B  |     A     |
+ *  |2Bits|2Bits|  4 Bits   |
+ *
+ *  A: Request Type
+ *   - 0: GET, the server sends the named files
+ *   - 1: PUT, the client sends its manifest and files, the server writes them under root
+ *
+ *  B: Priority class, 0 (the default) to 3. What is sent under a shared rate cap goes
+ *     to the highest class first
+ *
+ *  C: Flags
+ *   - x1: Range (GET only), only some parts of the data stream are sent, each from start
+ *         up to end. This is how a client downloads from several servers with the same
+ *         files at once, or only the chunks missing from its cache
+ *   - 1x: Chunks (Range only), the chunk list of the data stream is sent after the manifest
+ *
+ * u_short count (Range only)
+ * u_llong start, end (Range only, count of them, in order and not overlapping)
+ * char root[]  (remote path, '\0' terminated)
+ * char names[] (GET only: each file or directory under root, '\0' terminated)
+ */
+
+#define REQUEST_GET 0
+#define REQUEST_PUT 1
+#define REQUEST_RANGE 0x40
+#define REQUEST_CHUNKS 0x80
+#define REQUEST_TYPE(type) ((type) & 0x0F)
+#define REQUEST_PRIORITY(type) (((type) >> 4) & 0x03)
+#define REQUEST_RANGED(type) ((type) & REQUEST_RANGE)
+#define REQUEST_CHUNKED(type) ((type) & REQUEST_CHUNKS)
+#define REQUEST_RANGE_SIZE(count) (sizeof(u_short) + (count) * 2 * sizeof(u_llong))
+#define PRIORITY_CLASSES 4
+#define PERCENT_UNKNOWN 0xFF    // percent field of a transfer whose size isn't known
+
 typedef struct packet_header {
     u_char info;
     u_char percent;
     u_short data_size;
     u_int seq_num;
+    u_llong offset;
+    u_llong conn_id;
 } packet_header;
 
 typedef struct Packet {
@@ -91,6 +153,12 @@ u_int get_packet_error(Packet *packet);
  */
 u_short get_packet_size(Packet *packet);
 
+/**
+ * Returns true if size bytes received can be a packet: a whole header of this version,
+ * and no more payload than it says.
+ */
+int is_packet_valid(Packet *packet, int size);
+
 /**
  * Returns true if the packet is an error packet.
  */
@@ -101,16 +169,74 @@ int is_packet_error(Packet *packet);
  */
 int is_packet_sequence(Packet *packet);
 
+/**
+ * Returns true if the packet is a sequence packet describing a hole.
+ */
+int is_packet_hole(Packet *packet);
+
+/**
+ * Makes the packet a hole packet for length bytes of zeros starting at offset.
+ */
+void set_packet_hole(Packet *packet, u_int seq_num, u_llong offset, u_llong length);
+
+/**
+ * Returns the length of the hole described by a hole packet.
+ */
+u_llong get_packet_hole(Packet *packet);
+
+/**
+ * Returns true if the packet is a sequence packet carrying part of the manifest.
+ */
+int is_packet_manifest(Packet *packet);
+
+/**
+ * Returns true if the packet is a sequence packet carrying part of the chunk list.
+ */
+int is_packet_chunks(Packet *packet);
+
 /**
  * Returns true if the packet is an acknowledgement packet.
  */
 int is_packet_acknowledgement(Packet *packet);
 
+/**
+ * Makes the packet an ACK of ack_num, with percent landed, the packets the receiver has
+ * room for in window, and what it holds past ack_num in a bitmap of words u_llongs (bit
+ * i of word k for ack_num+1+64k+i). Only as many words as are given are sent.
+ */
+void set_packet_acknowledgement(Packet *packet, u_int ack_num, u_int percent, u_int window, const u_llong *held, u_int words);
+
+/**
+ * Returns the packets an ACK's sender has room for, 0 if it doesn't say.
+ */
+u_int get_packet_window(Packet *packet);
+
+/**
+ * Returns how many packets past its seq_num an ACK's bitmap of held packets covers.
+ */
+u_int get_packet_sack_size(Packet *packet);
+
+/**
+ * Returns true if an ACK says the packet i past the one after its seq_num is held.
+ */
+int is_packet_sacked(Packet *packet, u_int i);
+
 /**
  * Return true if the packet is a finale packet.
  */
 int is_packet_finale(Packet *packet);
 
+/**
+ * Where everything printed to the console goes: stdout, unless set_print_stream() moved it.
+ */
+FILE *print_stream(void);
+
+/**
+ * Moves everything printed to the console to stream, for a program whose stdout carries
+ * data (to stderr). Call it before any other thread starts.
+ */
+void set_print_stream(FILE *stream);
+
 /**
  * Prints packet information to the console.
  */
@@ -0,0 +1,164 @@
+/**
+ * @file progress.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief live progress, throughput and ETA of the transfers running now
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "progress.h"
+
+#define PROGRESS_LINE_SIZE 160
+
+// bytes with a binary unit, as "12.3 MB"
+static void format_bytes(char *buff, size_t size, double bytes) {
+    static const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    int unit = 0;
+
+    while (bytes >= 1024 && unit < 4) {
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(buff, size, unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return;
+}
+
+// the status line: percent, how much of how much, throughput and ETA, whatever is known
+static void print_status(progress *p, u_llong bytes, u_llong size, u_int peer, double eta, int final) {
+    char line[PROGRESS_LINE_SIZE], done[32], total[32];
+    size_t len = 0;
+
+    format_bytes(done, sizeof(done), (double)bytes);
+    if (size > 0) {
+        format_bytes(total, sizeof(total), (double)size);
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "%5.1f%%  %s of %s", (double)bytes * 100 / (double)size, done, total);
+    } else {
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "%s", done);
+    }
+    len += (size_t)snprintf(line + len, sizeof(line) - len, "  %.1f Mbit/s", p->rate * 8 / 1e6);
+    if (eta >= 0 && !final && len < sizeof(line)) {
+        len += (size_t)snprintf(line + len, sizeof(line) - len, "  ETA %llu:%02llu", (u_llong)eta / 60, (u_llong)eta % 60);
+    }
+    if (peer != PERCENT_UNKNOWN && len < sizeof(line)) snprintf(line + len, sizeof(line) - len, "  (peer %u%%)", peer);
+
+    if (p->tty) {
+        fprintf(stderr, final ? "\r%s\033[K\n" : "\r%s\033[K", line);
+    } else {
+        fprintf(stderr, "%s\n", line);
+    }
+    return;
+}
+
+static void print_json(progress *p, u_llong now, u_llong bytes, u_llong size, u_int peer, double eta, int final) {
+    fprintf(stderr, "{\"elapsed_s\":%.3f,\"bytes\":%llu", (double)(now - p->start) / 1e9, bytes);
+    if (size > 0) fprintf(stderr, ",\"size\":%llu,\"percent\":%.2f", size, (double)bytes * 100 / (double)size);
+    else          fprintf(stderr, ",\"size\":null,\"percent\":null");
+    if (peer != PERCENT_UNKNOWN) fprintf(stderr, ",\"peer_percent\":%u", peer);
+    else                         fprintf(stderr, ",\"peer_percent\":null");
+    fprintf(stderr, ",\"rate_bps\":%.0f", p->rate * 8);
+    if (eta >= 0) fprintf(stderr, ",\"eta_s\":%.1f", eta);
+    else          fprintf(stderr, ",\"eta_s\":null");
+    fprintf(stderr, ",\"done\":%s}\n", final ? "true" : "false");
+    return;
+}
+
+// read the counters of every connection and report them, unless nothing is moving
+static void report(progress *p, int final) {
+    u_llong now = stats_now(), bytes = 0, size = 0, s, moved;
+    u_int peer = PERCENT_UNKNOWN, q;
+    double seconds = (double)(now - p->last_time) / 1e9, eta = -1;
+    int i;
+
+    // mirrors each land part of one data stream, so their sizes are the same
+    for (i = 0; i < p->count; i++) {
+        bytes += STATS_GET(p->connects[i].stats.progress_bytes);
+        if ((s = STATS_GET(p->connects[i].stats.progress_size)) > size) size = s;
+        // of many servers, the one furthest behind
+        q = STATS_GET(p->connects[i].stats.peer_percent);
+        if (q != PERCENT_UNKNOWN && (peer == PERCENT_UNKNOWN || q < peer)) peer = q;
+    }
+    // a chunk a failed mirror handed back is landed twice
+    if (size > 0 && bytes > size) bytes = size;
+
+    // a new transfer starts its count over
+    moved = bytes >= p->last_bytes ? bytes - p->last_bytes : bytes;
+    if (moved == 0 && (bytes == 0 || (size > 0 && bytes >= size)) && !(final && p->reports > 0)) {
+        p->last_time = now;
+        p->last_bytes = bytes;
+        return;
+    }
+    // the last report keeps the rate the transfer ended at
+    if (seconds > 0 && !(final && moved == 0)) {
+        if (p->reports == 0) p->rate = (double)moved / seconds;
+        else                 p->rate += ((double)moved / seconds - p->rate) / PROGRESS_RATE_WEIGHT;
+    }
+    if (size > 0 && p->rate > 0) eta = (double)(size - bytes) / p->rate;
+    if (final) eta = size > 0 ? 0 : -1;
+
+    if (p->machine) print_json(p, now, bytes, size, peer, eta, final);
+    else            print_status(p, bytes, size, peer, eta, final);
+    fflush(stderr);
+    p->reports++;
+    p->last_time = now;
+    p->last_bytes = bytes;
+    return;
+}
+
+static void *progress_thread(void *arg) {
+    progress *p = (progress *)arg;
+    struct timespec until;
+    u_llong deadline;
+
+    pthread_mutex_lock(&p->lock);
+    deadline = stats_now();
+    while (!p->stop) {
+        deadline += p->refresh;
+        until.tv_sec = (time_t)(deadline / 1000000000ULL);
+        until.tv_nsec = (long)(deadline % 1000000000ULL);
+        while (!p->stop && pthread_cond_timedwait(&p->wake, &p->lock, &until) != ETIMEDOUT);
+        if (p->stop) break;
+
+        pthread_mutex_unlock(&p->lock);
+        report(p, 0);
+        pthread_mutex_lock(&p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    report(p, 1);
+    return NULL;
+}
+
+int progress_start(progress *p, connection *connects, int count, u_int refresh_ms, int machine) {
+    pthread_condattr_t attr;
+
+    memset(p, 0, sizeof(*p));
+    p->connects = connects;
+    p->count = count;
+    p->refresh = (u_llong)(refresh_ms ? refresh_ms : PROGRESS_REFRESH_MS) * 1000000ULL;
+    p->machine = machine;
+    p->tty = !machine && isatty(STDERR_FILENO);
+    p->start = p->last_time = stats_now();
+
+    // woken on CLOCK_MONOTONIC, like every other deadline
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&p->wake, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&p->thread, NULL, progress_thread, p) != 0) {
+        print_error("Could not start progress thread.", __LINE__);
+        pthread_cond_destroy(&p->wake);
+        pthread_mutex_destroy(&p->lock);
+        return -1;
+    }
+    return 0;
+}
+
+void progress_stop(progress *p) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_signal(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+    pthread_cond_destroy(&p->wake);
+    pthread_mutex_destroy(&p->lock);
+    return;
+}
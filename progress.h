@@ -0,0 +1,71 @@
+/**
+ * @file progress.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief live progress, throughput and ETA of the transfers running now
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <pthread.h>
+
+#include "connection.h"
+
+#define PROGRESS_REFRESH_MS 500     // between reports, by default
+#define PROGRESS_RATE_WEIGHT 4      // each report moves the smoothed rate 1/4 of the way to the last one
+
+/*
+ * progress Design:
+ *
+ * The transfer never prints anything per packet. It only keeps the progress counters of
+ * its connection (transfer_stats), with relaxed stores, and a thread of its own wakes up
+ * once every refresh to read them, so however often the report is refreshed the transfer
+ * runs as fast as with none.
+ *
+ * Each report sums the counters of every connection given, so a download from mirrors is
+ * one report. The size comes from the manifest before any data, so a percent and an ETA
+ * are there from the first report, unless a stream is being sent. A download made of
+ * ranged GETs (from mirrors, or of what a cache doesn't have) starts the progress once
+ * with the size of every file, and each ranged GET adds what it lands, so its report is of
+ * the whole download, with what the cache had counted as done.
+ * The throughput is the data landed (or ACKed, on an upload) since the last report, and
+ * is smoothed over a few reports for the ETA. The other side's progress, from the percent
+ * field of its packets, is reported too: how much the server has sent on a download, and
+ * how much it has landed on an upload.
+ *
+ * To a terminal, the report is one status line redrawn in place. Otherwise, or in machine
+ * mode, it is a line per report, machine mode being one JSON object per line. Nothing is
+ * reported while no transfer is moving (waiting for more names to be entered).
+ */
+
+typedef struct progress {
+    connection *connects;           // whose transfers are reported, summed
+    int count;
+    u_llong refresh;                // nanoseconds between reports
+    int machine;                    // JSON lines instead of a status line
+    int tty;                        // the status line is redrawn in place
+    u_int reports;
+    u_llong start;                  // CLOCK_MONOTONIC nanoseconds
+    u_llong last_time, last_bytes;  // at the last report
+    double rate;                    // smoothed bytes per second
+    int stop;                       // under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+} progress;
+
+/**
+ * Starts reporting the progress of the transfers of count connections to stderr, every
+ * refresh_ms milliseconds (PROGRESS_REFRESH_MS if 0). With machine, each report is a line
+ * of JSON. Start it before pinning the thread that runs the transfers.
+ */
+int progress_start(progress *p, connection *connects, int count, u_int refresh_ms, int machine);
+
+/**
+ * Makes one last report and stops the reporter.
+ */
+void progress_stop(progress *p);
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * @file rate.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief bandwidth caps per transfer, per client and in total, shared out by priority and weight
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "rate.h"
+
+#include <netinet/in.h>
+
+#include "stats.h"
+
+int rate_init(rate_limiter *l, u_llong transfer_rate, u_llong client_rate, u_llong global_rate) {
+    memset(l, 0, sizeof(*l));
+    if (pthread_mutex_init(&l->lock, NULL) != 0) {
+        print_error("Could not create the rate limiter lock.", __LINE__);
+        return -1;
+    }
+    l->transfer_rate = transfer_rate;
+    l->client_rate = client_rate;
+    l->global_rate = global_rate;
+    return 0;
+}
+
+void rate_free(rate_limiter *l) {
+    pthread_mutex_destroy(&l->lock);
+    return;
+}
+
+// same IP address, whatever the port
+int same_host(struct sockaddr_storage *a, struct sockaddr_storage *b) {
+    if (a->ss_family != b->ss_family) return 0;
+    if (a->ss_family == AF_INET) {
+        return ((struct sockaddr_in *)a)->sin_addr.s_addr == ((struct sockaddr_in *)b)->sin_addr.s_addr;
+    }
+    if (a->ss_family == AF_INET6) {
+        return memcmp(&((struct sockaddr_in6 *)a)->sin6_addr, &((struct sockaddr_in6 *)b)->sin6_addr, sizeof(struct in6_addr)) == 0;
+    }
+    return 0;
+}
+
+// add a share to the transfers under a cap, or take it away when leaving
+static void count_share(rate_classes *c, rate_share *s, int leaving) {
+    if (leaving) {
+        c->weight[s->priority] -= s->weight;
+        c->reserved[s->priority] -= s->reserve;
+    } else {
+        c->weight[s->priority] += s->weight;
+        c->reserved[s->priority] += s->reserve;
+    }
+    return;
+}
+
+void rate_join(rate_share *s, rate_limiter *l, struct sockaddr_storage *addr, u_int weight, u_int priority, u_llong reserve) {
+    rate_client *free_slot = NULL;
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->limiter = l;
+    s->weight = weight > 0 ? weight : 1;
+    s->priority = priority < PRIORITY_CLASSES ? priority : PRIORITY_CLASSES - 1;
+    s->reserve = reserve;
+    s->last = stats_now();
+    s->generation = (u_int)-1;          // work the rate out on the first packet
+    if (l == NULL) return;
+
+    pthread_mutex_lock(&l->lock);
+    count_share(&l->classes, s, 0);
+    if (l->client_rate > 0) {
+        for (i = 0; i < RATE_CLIENTS && s->client == NULL; i++) {
+            if (l->clients[i].transfers == 0) {
+                if (free_slot == NULL) free_slot = &l->clients[i];
+            } else if (same_host(&l->clients[i].addr, addr)) {
+                s->client = &l->clients[i];
+            }
+        }
+        if (s->client == NULL && free_slot != NULL) {
+            s->client = free_slot;
+            memcpy(&s->client->addr, addr, sizeof(*addr));
+        }
+        if (s->client != NULL) {
+            s->client->transfers++;
+            count_share(&s->client->classes, s, 0);
+        } else {
+            print_error("Too many clients to cap each, only the other caps apply.", __LINE__);
+        }
+    }
+    atomic_fetch_add(&l->generation, 1);
+    pthread_mutex_unlock(&l->lock);
+    return;
+}
+
+void rate_leave(rate_share *s) {
+    rate_limiter *l = s->limiter;
+
+    if (l == NULL) return;
+    pthread_mutex_lock(&l->lock);
+    count_share(&l->classes, s, 1);
+    if (s->client != NULL) {
+        s->client->transfers--;
+        count_share(&s->client->classes, s, 1);
+    }
+    atomic_fetch_add(&l->generation, 1);
+    pthread_mutex_unlock(&l->lock);
+    s->limiter = NULL;
+    return;
+}
+
+// the smaller of two caps, where 0 is none
+static u_llong min_rate(u_llong a, u_llong b) {
+    if (a == 0) return b;
+    if (b == 0) return a;
+    return a < b ? a : b;
+}
+
+// this transfer's share of a cap: the highest class sending gets it, less a trickle for the
+// classes below. In the class, deadlines reserve what they need first, and the rest goes by weight
+static u_llong class_share(u_llong cap, rate_classes *c, rate_share *s) {
+    u_llong below = 0, reserved, share = 0;
+    u_int top = PRIORITY_CLASSES - 1, i;
+
+    while (top > 0 && c->weight[top] == 0) top--;
+    for (i = 0; i < top; i++) below += c->weight[i];
+    if (s->priority < top) return cap / RATE_TRICKLE * s->weight / below;
+    if (below > 0) cap -= cap / RATE_TRICKLE;
+
+    reserved = c->reserved[top];
+    if (reserved > cap - cap / RATE_UNRESERVED) {
+        // more than can be reserved: each deadline gets the same fraction of what it needs
+        share = (u_llong)((double)s->reserve * (double)(cap - cap / RATE_UNRESERVED) / (double)reserved);
+        reserved = cap - cap / RATE_UNRESERVED;
+    } else {
+        share = s->reserve;
+    }
+    return share + (cap - reserved) * s->weight / c->weight[top];
+}
+
+// work out this transfer's rate again: the smallest of its shares of each cap.
+// A share too small to round to a byte a second is still a cap
+void rate_update(rate_share *s) {
+    rate_limiter *l = s->limiter;
+    u_llong rate, share;
+
+    pthread_mutex_lock(&l->lock);
+    s->generation = atomic_load(&l->generation);
+    rate = l->transfer_rate;
+    if (l->client_rate > 0 && s->client != NULL) {
+        share = class_share(l->client_rate, &s->client->classes, s);
+        rate = min_rate(rate, share > 0 ? share : 1);
+    }
+    if (l->global_rate > 0) {
+        share = class_share(l->global_rate, &l->classes, s);
+        rate = min_rate(rate, share > 0 ? share : 1);
+    }
+    pthread_mutex_unlock(&l->lock);
+    s->rate = rate;
+    return;
+}
+
+u_llong rate_due(rate_share *s, u_llong now) {
+    double burst;
+
+    if (s->limiter == NULL) return 0;
+    if (s->generation != atomic_load_explicit(&s->limiter->generation, memory_order_relaxed)) rate_update(s);
+    if (s->rate == 0) return 0;
+
+    // top the bucket up for the time since last, up to the burst
+    burst = (double)s->rate * RATE_BURST_NS / 1e9;
+    if (burst < RATE_MIN_BURST) burst = RATE_MIN_BURST;
+    s->tokens += (double)(now - s->last) * (double)s->rate / 1e9;
+    if (s->tokens > burst) s->tokens = burst;
+    s->last = now;
+
+    if (s->tokens >= 0) return 0;
+    return now + (u_llong)(-s->tokens * 1e9 / (double)s->rate) + 1;
+}
+
+void rate_take(rate_share *s, u_int size) {
+    if (s->limiter != NULL) s->tokens -= size;
+    return;
+}
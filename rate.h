@@ -0,0 +1,110 @@
+/**
+ * @file rate.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief bandwidth caps per transfer, per client and in total, shared out by priority and weight
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef RATE_H
+#define RATE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "packet.h"
+
+#define RATE_CLIENTS 256        // clients that can be sending at once under a per-client cap
+#define RATE_BURST_NS 10000000ULL   // a bucket holds 10 ms of its rate...
+#define RATE_MIN_BURST (2 * sizeof(Packet)) // ...and at least two full packets
+#define RATE_TRICKLE 32         // classes below the highest share 1/32 of a cap, so they don't time out
+#define RATE_UNRESERVED 4       // deadlines leave at least 1/4 of their class's cap unreserved
+
+/*
+ * rate_limiter Design:
+ *
+ * A limiter is shared by every transfer of a process. It holds three caps, in bytes per
+ * second (0 is no cap): one for each transfer, one for everything sent to one client
+ * (by IP address), and one for everything sent at all. Every sending transfer joins it
+ * and gets a share of each cap it falls under: of the client cap, shared with every
+ * transfer to the same client, and of the global cap, shared with every transfer. Its
+ * rate is the smallest of the three.
+ *
+ * A shared cap is handed out by priority class, then by deadline and weight. The highest
+ * class with a transfer sending gets the cap to itself, less 1/RATE_TRICKLE that every class
+ * below it shares by weight, just so their sessions don't time out. Within the class, a
+ * transfer with a deadline first reserves the rate it needs to send all of its files by
+ * then (together all but 1/RATE_UNRESERVED of the class's cap at most, scaled down if they
+ * need more), and the rest is split by weight among all of them. So a small urgent transfer
+ * goes at nearly the whole cap while big ones stream underneath.
+ *
+ * Each transfer spends its rate from a token bucket of its own, so the send loop never
+ * takes a lock. The lock is only taken to join, to leave, and to work out the rate again
+ * after someone joined or left, which bumps the generation.
+ */
+
+// the transfers sending under one cap
+typedef struct rate_classes {
+    u_llong weight[PRIORITY_CLASSES];   // of every transfer in each class
+    u_llong reserved[PRIORITY_CLASSES]; // bytes per second the deadlines in each class need
+} rate_classes;
+
+typedef struct rate_client {
+    struct sockaddr_storage addr;       // IP address, the port is ignored
+    u_int transfers;                    // sending to it, 0 if the slot is free
+    rate_classes classes;
+} rate_client;
+
+typedef struct rate_limiter {
+    pthread_mutex_t lock;
+    u_llong transfer_rate, client_rate, global_rate;    // bytes per second, 0 for none
+    rate_classes classes;               // of every transfer sending
+    _Atomic u_int generation;           // bumped whenever a transfer joins or leaves
+    rate_client clients[RATE_CLIENTS];
+} rate_limiter;
+
+// one transfer's share of a limiter, and its token bucket
+typedef struct rate_share {
+    rate_limiter *limiter;              // NULL if not limited
+    rate_client *client;                // NULL if no per-client cap applies
+    u_int weight;
+    u_int priority;                     // class, 0 to PRIORITY_CLASSES-1
+    u_llong reserve;                    // bytes per second its deadline needs, 0 for none
+    u_int generation;                   // of the limiter when rate was worked out
+    u_llong rate;                       // bytes per second, 0 for no cap
+    double tokens;                      // bytes that may go out now, negative while in debt
+    u_llong last;                       // when tokens were last topped up
+} rate_share;
+
+/**
+ * Initializes a limiter with caps in bytes per second, 0 for none.
+ */
+int rate_init(rate_limiter *l, u_llong transfer_rate, u_llong client_rate, u_llong global_rate);
+
+/**
+ * Frees a limiter. Every transfer must have left it.
+ */
+void rate_free(rate_limiter *l);
+
+/**
+ * Joins the limiter as a transfer sending to addr, in a priority class with a weight (at
+ * least 1), reserving the rate its deadline needs (0 for none). l may be NULL.
+ */
+void rate_join(rate_share *s, rate_limiter *l, struct sockaddr_storage *addr, u_int weight, u_int priority, u_llong reserve);
+
+/**
+ * Leaves the limiter, handing the share back to the rest.
+ */
+void rate_leave(rate_share *s);
+
+/**
+ * Returns 0 if a packet may be sent now, or when it may be (CLOCK_MONOTONIC nanoseconds).
+ */
+u_llong rate_due(rate_share *s, u_llong now);
+
+/**
+ * Spends size bytes, which may put the bucket in debt.
+ */
+void rate_take(rate_share *s, u_int size);
+
+#endif
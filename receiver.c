@@ -0,0 +1,704 @@
+/**
+ * @file receiver.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief receiving side of a transfer: manifest, then write-behind of the data stream
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE     // O_DIRECT
+
+#include "receiver.h"
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "log.h"
+
+// temporary names of files being received, unique across every transfer of this process
+static _Atomic u_int temp_count;
+
+int open_writer(writer *wr, manifest *files, int direct, int atomic, stream_range *range) {
+    int i;
+
+    memset(wr, 0, sizeof(*wr));
+    wr->files = files;
+    wr->direct = direct;
+    wr->atomic = atomic;
+    if (range != NULL) {
+        // O_DIRECT pads the last block, which would write over the start of the next range
+        wr->direct = 0;
+        wr->ranged = 1;
+    }
+    for (i = 0; i < WRITE_BUFFERS; i++) {
+        if (posix_memalign((void **)&wr->buffs[i], WRITE_ALIGN, WRITE_BUFFER_SIZE) != 0) {
+            print_error("Could not allocate write buffers.", __LINE__);
+            while (i-- > 0) free(wr->buffs[i]);
+            return -1;
+        }
+        wr->free_list[i] = i;
+    }
+    if (disk_io_init(&wr->io, WRITE_BUFFERS, disk_io_backend_from_env()) == -1) {
+        print_error("Could not set up disk I/O.", __LINE__);
+        for (i = 0; i < WRITE_BUFFERS; i++) free(wr->buffs[i]);
+        return -1;
+    }
+    // off the core of a low latency transfer
+    for (i = 0; wr->io.backend == DISK_IO_THREADS && i < DISK_IO_POOL_SIZE; i++) unpin_thread(wr->io.pool.threads[i]);
+    wr->free_count = WRITE_BUFFERS;
+    wr->current = -1;
+    return 0;
+}
+
+// create the missing directories leading up to path
+int make_parents(char *path) {
+    char *slash;
+    for (slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        if (mkdir(path, 0755) == -1 && errno != EEXIST) {
+            *slash = '/';
+            return -1;
+        }
+        *slash = '/';
+    }
+    return 0;
+}
+
+int open_local_file(writer *wr, char *path, u_int mode) {
+    int file_desc, made_parents = 0;
+
+    if (strcmp(path, STREAM_PATH) == 0) {
+        if ((file_desc = dup(STDOUT_FILENO)) == -1) print_error(strerror(errno), __LINE__);
+        return file_desc;
+    }
+    // other ranges are written into the same file at the same time, so it is never truncated
+    while ((file_desc = open(path, O_WRONLY | O_CREAT | (wr->ranged ? 0 : O_TRUNC) | (wr->direct ? O_DIRECT : 0), mode & 0777)) == -1) {
+        if (errno == ENOENT && !made_parents) {
+            made_parents = 1;
+            if (make_parents(path) == 0) continue;
+        } else if (errno == EINVAL && wr->direct) {
+            // the file system doesn't do direct I/O (tmpfs, ...), go through the page cache
+            print_error("O_DIRECT not supported here, using buffered writes.", __LINE__);
+            wr->direct = 0;
+            continue;
+        }
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    return file_desc;
+}
+
+// create a manifest entry that no data was sent for: a directory, or an empty file
+int create_entry(writer *wr, manifest_entry *entry) {
+    int file_desc;
+
+    if (S_ISDIR(entry->mode)) {
+        if (mkdir(entry->path, entry->mode & 0777) == -1 && errno == ENOENT && make_parents(entry->path) == 0) {
+            mkdir(entry->path, entry->mode & 0777);
+        }
+        return 0;
+    }
+    if ((file_desc = open_local_file(wr, entry->path, entry->mode)) == -1) return -1;
+    if (strcmp(entry->path, STREAM_PATH) != 0 && ftruncate(file_desc, (off_t)entry->size) == -1) print_error(strerror(errno), __LINE__);
+    close(file_desc);
+    return 0;
+}
+
+void restore_modes(manifest *files) {
+    manifest_entry *entry;
+    u_int i;
+
+    for (i = 0; i < files->count; i++) {
+        entry = &files->entries[i];
+        if (!S_ISDIR(entry->mode) && !(entry->mode & S_IWUSR) && chmod(entry->path, entry->mode & 0777) == -1) {
+            print_error(strerror(errno), __LINE__);
+        }
+    }
+    return;
+}
+
+int create_entries(manifest *files) {
+    writer wr;
+    manifest_entry entry;
+    u_int i;
+
+    memset(&wr, 0, sizeof(wr));
+    for (i = 0; i < files->count; i++) {
+        // every range opens the file again, so it stays writable until they are all in
+        entry = files->entries[i];
+        if (!S_ISDIR(entry.mode)) entry.mode |= S_IWUSR;
+        if (create_entry(&wr, &entry) == -1) return -1;
+    }
+    return 0;
+}
+
+// truncate a file to its final size (trailing holes, O_DIRECT padding) and close it. A
+// file written under a temporary name is renamed into place, or removed if incomplete
+void finish_file(writer *wr, open_file *file) {
+    if (!file->sequential && ftruncate(file->file_desc, file->size) == -1) {
+        print_error(strerror(errno), __LINE__);
+        wr->failed = 1;
+    }
+    if (close(file->file_desc) == -1) {
+        print_error(strerror(errno), __LINE__);
+        wr->failed = 1;
+    }
+    if (file->temp_path != NULL) {
+        if (!file->complete || wr->failed) {
+            unlink(file->temp_path);
+        } else if (rename(file->temp_path, file->path) == -1) {
+            print_error(strerror(errno), __LINE__);
+            unlink(file->temp_path);
+            wr->failed = 1;
+        }
+        free(file->temp_path);
+    }
+    free(file);
+    return;
+}
+
+// reap finished writes, handing their buffers back, and closing files with nothing left
+int reap_writes(writer *wr, int wait) {
+    disk_done done[WRITE_BUFFERS];
+    open_file *file;
+    int n, i, index;
+
+    n = disk_io_complete(&wr->io, done, WRITE_BUFFERS, wait);
+    if (n == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        index = (int)(unsigned long)done[i].tag;
+        if (done[i].result < 0) {
+            print_error(strerror((int)-done[i].result), __LINE__);
+            wr->failed = 1;
+        } else if ((size_t)done[i].result != wr->lens[index]) {
+            print_error("Short write to local file.", __LINE__);
+            wr->failed = 1;
+        }
+        file = wr->owners[index];
+        if (--file->pending == 0 && file->done) finish_file(wr, file);
+        wr->free_list[wr->free_count++] = index;
+    }
+    return wr->failed ? -1 : 0;
+}
+
+// write the buffer being filled to stdout, in order, right away
+int flush_sequential(writer *wr) {
+    u_char *data = wr->buffs[wr->current];
+    size_t left = wr->fill;
+    ssize_t n;
+
+    while (left > 0) {
+        n = write(wr->file->file_desc, data, left);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
+            print_error(strerror(errno), __LINE__);
+            wr->failed = 1;
+            break;
+        }
+        data += n;
+        left -= (size_t)n;
+    }
+    wr->free_list[wr->free_count++] = wr->current;
+    wr->offset += (off_t)wr->fill;
+    wr->current = -1;
+    wr->fill = 0;
+    return wr->failed ? -1 : 0;
+}
+
+// submit the buffer being filled as one positional write
+int flush_writes(writer *wr) {
+    size_t len = wr->fill;
+
+    if (wr->current == -1 || wr->fill == 0) return 0;
+    if (wr->file->sequential) return flush_sequential(wr);
+
+    // O_DIRECT needs whole blocks, so the tail is padded here and truncated on close
+    if (wr->file->direct && len % WRITE_ALIGN != 0) {
+        len += WRITE_ALIGN - len % WRITE_ALIGN;
+        memset(wr->buffs[wr->current] + wr->fill, 0, len - wr->fill);
+    }
+    wr->lens[wr->current] = len;
+    wr->owners[wr->current] = wr->file;
+    wr->file->pending++;
+    disk_io_write(&wr->io, wr->file->file_desc, wr->buffs[wr->current], len, wr->offset, (void *)(unsigned long)wr->current);
+    wr->offset += (off_t)wr->fill;
+    wr->current = -1;
+    wr->fill = 0;
+
+    if (disk_io_submit(&wr->io) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+// move the writer on to manifest entry index, creating every entry it passes over. The
+// file it leaves is complete, unless the transfer is being cut short
+int advance_writer(writer *wr, u_int index, int complete) {
+    manifest_entry *entry;
+    open_file *file;
+    size_t size;
+
+    if (flush_writes(wr) == -1) return -1;
+    if (wr->file != NULL) {
+        wr->file->done = 1;
+        wr->file->complete = complete;
+        if (wr->file->pending == 0) finish_file(wr, wr->file);
+        wr->file = NULL;
+    }
+    if (!complete) return 0;
+    while (!wr->ranged && wr->next_create < index && wr->next_create < wr->files->count) {
+        if (create_entry(wr, &wr->files->entries[wr->next_create++]) == -1) return -1;
+    }
+    if (index >= wr->files->count) return 0;
+
+    entry = &wr->files->entries[index];
+    if ((file = calloc(1, sizeof(open_file))) == NULL) {
+        print_error("Could not allocate file.", __LINE__);
+        return -1;
+    }
+    file->path = entry->path;
+    file->sequential = strcmp(entry->path, STREAM_PATH) == 0;
+    if (wr->atomic && !file->sequential) {
+        size = strlen(entry->path) + 32;
+        if ((file->temp_path = malloc(size)) == NULL) {
+            print_error("Could not allocate file.", __LINE__);
+            free(file);
+            return -1;
+        }
+        snprintf(file->temp_path, size, "%s.rft-%ld-%u", entry->path, (long)getpid(), atomic_fetch_add(&temp_count, 1));
+    }
+    if ((file->file_desc = open_local_file(wr, file->temp_path ? file->temp_path : entry->path, entry->mode)) == -1) {
+        free(file->temp_path);
+        free(file);
+        return -1;
+    }
+    file->direct = wr->direct && !file->sequential;
+    file->size = (off_t)entry->size;
+    wr->file = file;
+    wr->file_index = index;
+    wr->next_create = index + 1;
+    wr->offset = 0;
+    return 0;
+}
+
+// point the writer at the file holding offset of the data stream. Returns the offset in
+// that file, and sets left to how much of the file is left from there
+off_t seek_writer(writer *wr, u_llong offset, u_llong *left) {
+    manifest_entry *entry;
+    u_int index;
+
+    entry = wr->file ? &wr->files->entries[wr->file_index] : NULL;
+    if (entry == NULL || offset < entry->offset || offset >= entry->offset + entry->size) {
+        index = manifest_find(wr->files, offset);
+        if (index >= wr->files->count) {
+            print_error("Data is past the end of the manifest.", __LINE__);
+            return -1;
+        }
+        if (advance_writer(wr, index, 1) == -1) return -1;
+        entry = &wr->files->entries[index];
+    }
+    *left = entry->offset + entry->size - offset;
+    if (wr->ranged && (off_t)(offset - entry->offset) > wr->offset + (off_t)wr->fill) {
+        // the next part of the range, further on in the file
+        if (flush_writes(wr) == -1) return -1;
+        wr->offset = (off_t)(offset - entry->offset);
+    }
+    if ((off_t)(offset - entry->offset) != wr->offset + (off_t)wr->fill) {
+        print_error("Data is out of order.", __LINE__);
+        return -1;
+    }
+    return (off_t)(offset - entry->offset);
+}
+
+// append size bytes of data (or zeros, if data is NULL) to the write-behind buffer
+int buffer_bytes(writer *wr, u_char *data, size_t size) {
+    size_t n;
+
+    while (size > 0) {
+        if (wr->current == -1) {
+            if (reap_writes(wr, wr->free_count == 0) == -1) return -1;
+            wr->current = wr->free_list[--wr->free_count];
+        }
+        n = WRITE_BUFFER_SIZE - wr->fill;
+        if (n > size) n = size;
+        if (data == NULL) {
+            memset(wr->buffs[wr->current] + wr->fill, 0, n);
+        } else {
+            memcpy(wr->buffs[wr->current] + wr->fill, data, n);
+            data += n;
+        }
+        wr->fill += n;
+        size -= n;
+
+        if (wr->fill == WRITE_BUFFER_SIZE && flush_writes(wr) == -1) return -1;
+    }
+    return 0;
+}
+
+// append the next in-order payload, which may run across several small files
+int write_chunk(writer *wr, u_char *data, u_short size, u_llong offset) {
+    u_llong left;
+    size_t n;
+
+    while (size > 0) {
+        if (seek_writer(wr, offset, &left) == -1) return -1;
+        n = left < size ? (size_t)left : size;
+        if (buffer_bytes(wr, data, n) == -1) return -1;
+        data += n;
+        size -= (u_short)n;
+        offset += n;
+    }
+    return 0;
+}
+
+// skip over a run of zeros, leaving a hole in the local files. Only whole blocks are
+// skipped, the zeros in partial blocks at either end are buffered like data, which
+// keeps every write block aligned for O_DIRECT. Nothing can be skipped on stdout
+int write_hole(writer *wr, u_llong offset, u_llong length) {
+    u_llong left;
+    off_t start, end, skip_start, skip_end;
+
+    while (length > 0) {
+        if ((start = seek_writer(wr, offset, &left)) == -1) return -1;
+        if (left > length) left = length;
+        end = start + (off_t)left;
+        skip_start = (start + WRITE_ALIGN - 1) / WRITE_ALIGN * WRITE_ALIGN;
+        skip_end = end / WRITE_ALIGN * WRITE_ALIGN;
+
+        if (skip_end <= skip_start || wr->file->sequential) {
+            if (buffer_bytes(wr, NULL, (size_t)left) == -1) return -1;
+        } else {
+            if (buffer_bytes(wr, NULL, (size_t)(skip_start - start)) == -1) return -1;
+            if (flush_writes(wr) == -1) return -1;
+            wr->offset = skip_end;
+            if (buffer_bytes(wr, NULL, (size_t)(end - skip_end)) == -1) return -1;
+        }
+        offset += left;
+        length -= left;
+    }
+    return 0;
+}
+
+// wait for every write to land and close every file. If the transfer is complete, the
+// entries no data was sent for (directories, empty files) are created too
+int close_writer(writer *wr, int complete) {
+    int i;
+
+    if (advance_writer(wr, wr->files->count, complete) == -1) wr->failed = 1;
+    while (disk_io_pending(&wr->io) > 0) reap_writes(wr, 1);
+
+    disk_io_free(&wr->io);
+    for (i = 0; i < WRITE_BUFFERS; i++) free(wr->buffs[i]);
+    return wr->failed ? -1 : 0;
+}
+
+// the manifest is complete once data (or the FIN) shows up: decode it and start writing
+int start_writing(receiver *rc) {
+    if (manifest_decode(&rc->files, rc->manifest_data, rc->manifest_len, rc->local_path) == -1) {
+        print_error("Bad manifest.", __LINE__);
+        return -1;
+    }
+    if (strcmp(rc->local_path, STREAM_PATH) == 0 && (rc->files.count != 1 || S_ISDIR(rc->files.entries[0].mode))) {
+        print_error("Only one file can be written to stdout.", __LINE__);
+        return -1;
+    }
+    if (rc->range != NULL) {
+        // the chunk list is the caller's to read
+        rc->range->chunk_data = rc->chunk_data;
+        rc->range->chunk_len = rc->chunk_len;
+        rc->chunk_data = NULL;
+        if (rc->range->manifest_data == NULL) {
+            // the first part of a download: every other part has to come from the same files
+            rc->range->manifest_data = rc->manifest_data;
+            rc->range->manifest_len = rc->manifest_len;
+            rc->manifest_data = NULL;
+        } else if (rc->range->manifest_len != rc->manifest_len || memcmp(rc->range->manifest_data, rc->manifest_data, rc->manifest_len) != 0) {
+            print_error("The server's files differ from the first one's.", __LINE__);
+            return -1;
+        }
+    }
+    if (rc->files.total_size == STREAM_SIZE) fprintf(print_stream(), "\nreceiving a stream");
+    else if (rc->range == NULL)              fprintf(print_stream(), "\nreceiving %u files, %llu bytes", rc->files.count, rc->files.total_size);
+    else if (rc->range->count == 1)          fprintf(print_stream(), "\nreceiving bytes %llu to %llu of %u files", rc->range->parts[0].start, rc->range->parts[0].end, rc->files.count);
+    else if (rc->range->count > 1)           fprintf(print_stream(), "\nreceiving %llu bytes in %u parts of %u files", range_size(rc->range), rc->range->count, rc->files.count);
+    if (rc->range == NULL && rc->files.total_size != STREAM_SIZE) STATS_SET(rc->stats->progress_size, rc->files.total_size);
+    if (open_writer(&rc->wr, &rc->files, rc->direct, rc->atomic, rc->range) == -1) return -1;
+    rc->stats->disk_io = disk_io_backend_name(&rc->wr.io);
+    rc->stats->direct_io = rc->wr.direct;
+    rc->writing = 1;
+    return 0;
+}
+
+// land the payload of the next in-order SEQ packet
+int receive_packet(receiver *rc, Packet *packet) {
+    u_char *grown;
+
+    if (is_packet_manifest(packet)) {
+        if (rc->writing || packet->header.offset != rc->manifest_len) {
+            print_error("Manifest is out of order.", __LINE__);
+            return -1;
+        }
+        if ((grown = realloc(rc->manifest_data, rc->manifest_len + packet->header.data_size)) == NULL) {
+            print_error("Could not allocate manifest.", __LINE__);
+            return -1;
+        }
+        rc->manifest_data = grown;
+        memcpy(rc->manifest_data + rc->manifest_len, packet->buff, packet->header.data_size);
+        rc->manifest_len += packet->header.data_size;
+        return 0;
+    }
+    if (is_packet_chunks(packet)) {
+        if (rc->writing || rc->range == NULL || !rc->range->chunks || packet->header.offset != rc->chunk_len) {
+            print_error("Chunk list is out of order.", __LINE__);
+            return -1;
+        }
+        if ((grown = realloc(rc->chunk_data, rc->chunk_len + packet->header.data_size)) == NULL) {
+            print_error("Could not allocate chunk list.", __LINE__);
+            return -1;
+        }
+        rc->chunk_data = grown;
+        memcpy(rc->chunk_data + rc->chunk_len, packet->buff, packet->header.data_size);
+        rc->chunk_len += packet->header.data_size;
+        return 0;
+    }
+
+    if (!rc->writing && start_writing(rc) == -1) return -1;
+    if (is_packet_hole(packet)) return write_hole(&rc->wr, packet->header.offset, get_packet_hole(packet));
+    return write_chunk(&rc->wr, packet->buff, packet->header.data_size, packet->header.offset);
+}
+
+// land the next in-order SEQ packet, then every packet held past it that is now in
+// order. seq_num is moved on to the last one landed
+int land_packets(connection *connect, receiver *rc, Packet *packet, u_int *seq_num) {
+    u_int slot;
+
+    while (1) {
+        if (!is_packet_manifest(packet) && !is_packet_chunks(packet)) {
+            if (!is_packet_hole(packet)) STATS_ADD(connect->stats.payload_bytes, packet->header.data_size);
+            STATS_ADD(connect->stats.progress_bytes, is_packet_hole(packet) ? get_packet_hole(packet) : packet->header.data_size);
+        }
+        if (receive_packet(rc, packet) == -1) return -1;
+        (*seq_num)++;
+        rc->delivered++;
+
+        slot = (*seq_num + 1) % WINDOW_SIZE;
+        if (!rc->is_held[slot]) return 0;
+        rc->is_held[slot] = 0;
+        packet = &rc->held[slot];
+    }
+}
+
+// the sender answers the ACK of a manifest or chunks packet (sent one at a time) with the
+// next packet, so the time between them is an RTT
+void sample_listing_rtt(receiver *rc, u_llong now) {
+    u_llong rtt = now - rc->listing_acked;
+
+    rc->srtt = rc->srtt == 0 ? rtt : (7 * rc->srtt + rtt) / 8;
+    rc->listing_acked = 0;
+    return;
+}
+
+// dynamic right-sizing, as the sender does its window: once a smoothed RTT has passed,
+// the socket receive buffer is grown to hold twice the packets that landed in it. The
+// sender never has more in flight than the ACKs say the buffer holds, so growing it is
+// what lets the window grow. It never shrinks
+void tune_receive(connection *connect, receiver *rc, u_llong now) {
+    u_llong elapsed = now - rc->round_start;
+
+    if (rc->srtt == 0 || elapsed < rc->srtt) return;
+    tune_buffer(connect, SO_RCVBUF, 2 * (u_llong)rc->delivered * rc->srtt / elapsed * PACKET_BUFFER_COST);
+    rc->round_start = now;
+    rc->delivered = 0;
+    return;
+}
+
+// ACK everything landed up to seq_num, and tell the sender which packets past it are held
+// (SACK), so it resends only the ones that were lost
+int acknowledge_window(connection *connect, receiver *rc, Packet *ack_packet, u_int seq_num) {
+    u_llong held[WINDOW_SIZE / 64] = {0};
+    u_int i, words = 0;
+
+    // as far as anything is held, so the whole window can be described
+    for (i = 1; i < WINDOW_SIZE; i++) {
+        if (!rc->is_held[(seq_num + 1 + i) % WINDOW_SIZE]) continue;
+        held[i / 64] |= 1ULL << (i % 64);
+        words = i / 64 + 1;
+    }
+    return send_selective_acknowledgement(connect, ack_packet, seq_num, held, words);
+}
+
+// wait for the writes to land and close everything. A complete transfer also creates
+// the files no data was sent for, and learns the size of a stream from the FIN
+int finish_receiving(receiver *rc, int complete, u_llong stream_size) {
+    int rv = 0;
+
+    if (complete && !rc->writing) rv = start_writing(rc);
+    if (complete && rc->writing && rc->files.count == 1 && rc->files.entries[0].size == STREAM_SIZE) {
+        rc->files.entries[0].size = stream_size;
+        rc->files.total_size = stream_size;
+        if (rc->wr.file != NULL) rc->wr.file->size = (off_t)stream_size;
+    }
+    if (rc->writing && close_writer(&rc->wr, complete) == -1) rv = -1;
+    free(rc->held);
+    free(rc->manifest_data);
+    free(rc->chunk_data);
+    manifest_free(&rc->files);
+    return rv;
+}
+
+int receive_files(connection *connect, Packet *send_packet, Packet *recv_packet, u_int seq_num, char *local_path, int direct, int atomic, stream_range *range) {
+    receiver rc;
+    int rv, i = 0, pending, landed, finished = 0;
+    u_int temp, unacked = 0, request = seq_num;
+    u_llong now;
+
+    memset(&rc, 0, sizeof(rc));
+    manifest_init(&rc.files);
+    rc.local_path = local_path;
+    rc.direct = direct;
+    rc.atomic = atomic;
+    rc.range = range;
+    rc.stats = &connect->stats;
+    STATS_ADD(connect->stats.transfers, 1);
+    // the parts of a ranged GET add to the progress of whatever download asked for them
+    if (range == NULL) stats_begin_progress(&connect->stats, 0);
+    if ((rc.held = malloc(WINDOW_SIZE * sizeof(Packet))) == NULL) {
+        print_error("Could not allocate receive window.", __LINE__);
+        return -1;
+    }
+
+    // the first packet may already be here, if it came in place of the ACK of the request
+    pending = is_packet_sequence(recv_packet) && recv_packet->header.seq_num == seq_num+1;
+
+    do {    // while is not a finale packet, and tried less than 8 times
+        if (pending) {
+            rv = get_packet_size(recv_packet);
+            pending = 0;
+        } else if (unacked > 0 && wait_for_data(connect, ACK_DELAY_US) == 0) {
+            // the burst is over, ACK the rest of it
+            unacked = 0;
+            if (acknowledge_window(connect, &rc, send_packet, seq_num) == -1) {
+                finish_receiving(&rc, 0, 0);
+                return -1;
+            }
+            continue;
+        } else {
+            rv = recv_data(connect, recv_packet);
+            if (rv != -1) log_packet(LOG_EVENT_RECV, recv_packet, connect->is_server);
+        }
+        // didn't receive data
+        if (rv == -1) {
+            log_event(LOG_DEBUG, LOG_EVENT_TIMEOUT, connect->is_server);
+            i++;
+            // ACK again, in case ours was lost, or our address changed (NAT rebinding) and
+            // the sender can only learn the new one from a packet of ours
+            acknowledge_window(connect, &rc, send_packet, seq_num);
+        } else {    // received data
+            i = 0;
+
+            temp = recv_packet->header.seq_num;
+            landed = 0;
+            now = stats_now();
+            if (rc.listing_acked != 0) sample_listing_rtt(&rc, now);
+            if (is_packet_sequence(recv_packet) && !is_packet_manifest(recv_packet) && !is_packet_chunks(recv_packet)) {
+                STATS_SET(connect->stats.peer_percent, recv_packet->header.percent);
+            }
+
+            // if is a sequence packet
+            if (is_packet_sequence(recv_packet)) {
+
+                // if correct next packet
+                if (temp == seq_num+1) {
+                    // land the data (and what was held past it), move to next packet
+                    if (land_packets(connect, &rc, recv_packet, &seq_num) == -1) {
+                        finish_receiving(&rc, 0, 0);               // 3 is Unknown/Unhandled Error
+                        return send_error_packet(connect, send_packet, recv_packet, 3);
+                    }
+                    landed = 1;
+                    unacked++;
+                    tune_receive(connect, &rc, now);
+
+                // if past a gap, hold it until the gap is filled
+                } else if (temp - seq_num - 1 < WINDOW_SIZE && !rc.is_held[temp % WINDOW_SIZE]) {
+                    memcpy(&rc.held[temp % WINDOW_SIZE], recv_packet, get_packet_size(recv_packet));
+                    rc.is_held[temp % WINDOW_SIZE] = 1;
+                } else {
+                    STATS_ADD(connect->stats.duplicate_packets, 1);
+                }
+
+                // ACK the data every ACK_EVERY packets. A previous packet (our ACK of it was
+                // lost) or one past a gap is ACKed right away, so the sender hears of the
+                // loss from the repeated ACKs, and so is a filled gap, and the manifest and
+                // chunk list, which are sent one packet at a time
+                if (!landed || temp != seq_num || is_packet_manifest(recv_packet) || is_packet_chunks(recv_packet) || unacked >= ACK_EVERY) {
+                    unacked = 0;
+                    rv = acknowledge_window(connect, &rc, send_packet, seq_num);
+                    if (rv == -1) {
+                        finish_receiving(&rc, 0, 0);
+                        return rv;
+                    }
+                    if (landed && (is_packet_manifest(recv_packet) || is_packet_chunks(recv_packet))) {
+                        rc.listing_acked = stats_now();
+                        rc.round_start = rc.listing_acked;
+                        rc.delivered = 0;
+                    }
+                }
+
+            // an ACK of the request: the sender is still getting the data ready (cutting
+            // the files into chunks), and keeps the request alive until it is
+            } else if (is_packet_acknowledgement(recv_packet) && temp == request) {
+                continue;
+
+            // not a sequence packet, and not an error or finale of this transfer: the FIN only
+            // comes once all the data is ACKed, so with the last seq_num, and an ERR with the
+            // seq_num of the request. One from an earlier request of the session (its FIN
+            // again, as our ACK was lost) is ACKed again, anything else is only a duplicate
+            } else if (!(is_packet_finale(recv_packet) && temp == seq_num) && !(is_packet_error(recv_packet) && temp == request)) {
+                STATS_ADD(connect->stats.duplicate_packets, 1);
+                if (!is_packet_acknowledgement(recv_packet) && (int)(temp - request) < 0) {
+                    if (send_acknowledgement(connect, send_packet, temp) == -1) {
+                        finish_receiving(&rc, 0, 0);
+                        return -1;
+                    }
+                }
+
+            // an error or the finale
+            } else {
+                // send acknowledgement
+                rv = send_acknowledgement(connect, send_packet, temp);
+                if (is_packet_finale(recv_packet)) {
+                    STATS_ADD(connect->stats.stream_bytes, recv_packet->header.offset);
+                    connect->seq_num = temp;
+                    finished = 1;
+                }
+
+                // let every queued write land before reporting anything
+                if (finish_receiving(&rc, is_packet_finale(recv_packet), recv_packet->header.offset) == -1 || rv == -1) return -1;
+
+                // if it is an error packet
+                if (is_packet_error(recv_packet)) {
+                    print_error_msg(recv_packet, __LINE__);
+                    return -1;
+
+                // else if it is a finale packet
+                } else if (is_packet_finale(recv_packet) && rc.range == NULL) {  // a range is only part of it
+                    fprintf(print_stream(), "\nFile Transfer Complete!");
+                }
+
+            }
+        }
+    } while (!finished && i < MAX_RETRIES);
+
+    if (i >= MAX_RETRIES) {
+        finish_receiving(&rc, 0, 0);
+        print_error("Connection Closed.", __LINE__);
+        return -1;
+    }
+
+    return 0;
+}
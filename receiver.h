@@ -0,0 +1,113 @@
+/**
+ * @file receiver.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief receiving side of a transfer: manifest, then write-behind of the data stream
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef RECEIVER_H
+#define RECEIVER_H
+
+#include "connection.h"
+#include "diskio.h"
+#include "manifest.h"
+#include "packet.h"
+
+#define WRITE_BUFFERS 4                 // coalescing buffers, one filling while the rest land
+#define WRITE_BUFFER_SIZE (2 << 20)     // bytes per coalesced write (2 MB)
+#define WRITE_ALIGN 4096                // O_DIRECT alignment of buffers, offsets and lengths
+#define ACK_EVERY 8                     // in-order data packets per ACK
+#define ACK_DELAY_US 500                // quiet microseconds before the last packets are ACKed
+
+// a local file being written, closed once its last write has landed
+typedef struct open_file {
+    int file_desc;
+    int direct;                     // opened with O_DIRECT, bypassing the page cache
+    int sequential;                 // stdout, which can only be written in order
+    off_t size;                     // final size, truncated to once every write has landed
+    u_int pending;                  // writes in flight
+    int done;                       // no more writes will be queued
+    int complete;                   // every byte of it was received
+    char *path;                     // final name
+    char *temp_path;                // name written under until complete, or NULL
+} open_file;
+
+// write-behind file writer: coalesces contiguous payloads into large aligned positional
+// writes, so the network loop never blocks on storage or pays for a write per packet.
+// The data stream covers every file of the manifest, one after the other. Writing part
+// of it, the files are already there, and other writers fill in the rest at the same time
+typedef struct writer {
+    manifest *files;
+    u_int next_create;              // first manifest entry not created yet
+    u_int file_index;               // entry the buffer belongs to
+    open_file *file;                // open file of file_index, or NULL
+    int direct;                     // open files with O_DIRECT
+    int atomic;                     // write files under a temporary name, rename when complete
+    int ranged;                     // writing parts of the data stream, each from its start
+    int failed;                     // a write, truncate or close failed
+    off_t offset;                   // file offset of the buffer being filled
+    disk_io io;
+    u_char *buffs[WRITE_BUFFERS];
+    size_t lens[WRITE_BUFFERS];     // bytes submitted from each buffer
+    open_file *owners[WRITE_BUFFERS];
+    int free_list[WRITE_BUFFERS];
+    int free_count;
+    int current;                    // buffer being filled, or -1
+    size_t fill;                    // bytes in the buffer being filled
+} writer;
+
+// everything needed to land one transfer: the manifest as it arrives, then the writer
+typedef struct receiver {
+    manifest files;
+    u_char *manifest_data;
+    size_t manifest_len;
+    u_char *chunk_data;             // the chunk list, if the range asked for it
+    size_t chunk_len;
+    int writing;                    // manifest decoded and writer open
+    writer wr;
+    Packet *held;                   // SEQ packets that came in past a gap, by seq_num % WINDOW_SIZE
+    int is_held[WINDOW_SIZE];
+    char *local_path;
+    int direct;
+    int atomic;
+    stream_range *range;            // the parts of the data stream asked for, or NULL
+    u_llong listing_acked;          // when the last manifest or chunks packet was ACKed, for an RTT sample
+    u_llong srtt;                   // smoothed RTT in nanoseconds, 0 until the first sample
+    u_llong round_start;            // a delivery rate sample is taken once srtt has passed since
+    u_int delivered;                // packets landed since then
+    transfer_stats *stats;          // of the connection, whose progress gets its size from the manifest (unless ranged)
+} receiver;
+
+/**
+ * Receives a manifest and the data stream of its files up to the FIN, writing every
+ * file under local_path. The first packet expected is seq_num+1. With direct, files are
+ * written with O_DIRECT. With atomic, each file is written under a temporary name and
+ * renamed into place once complete, so a partial file is never seen under its name.
+ * Data is ACKed every ACK_EVERY packets, or once none has come in for ACK_DELAY_US, and
+ * anything out of order is ACKed right away. Packets up to WINDOW_SIZE past a gap are
+ * held until it is filled. The socket receive buffer is autotuned to twice the packets
+ * that land in an RTT (timed from the ACK of the manifest to the next packet), and each
+ * ACK says how many packets it has room for, and which are held past the gap. The
+ * connection's progress starts over with the size from the manifest, and each ACK carries
+ * the percent landed. If local_path is STREAM_PATH, the one file sent is written to stdout.
+ * If range isn't NULL, only its parts of the data stream come, and are written into files
+ * create_entries() made, with no O_DIRECT, adding to the progress its caller started. Its
+ * manifest has to match range's, or if that is NULL, is left in it (to be freed by the
+ * caller), and so is the chunk list, if asked for.
+ */
+int receive_files(connection *connect, Packet *send_packet, Packet *recv_packet, u_int seq_num, char *local_path, int direct, int atomic, stream_range *range);
+
+/**
+ * Creates every entry of a manifest: its directories, and its files at their full size
+ * with nothing written in them yet, for ranges of the data stream to be received into.
+ * Files are writable by their owner, whatever their mode.
+ */
+int create_entries(manifest *files);
+
+/**
+ * Gives the files create_entries() made back their own mode, once every range is in.
+ */
+void restore_modes(manifest *files);
+
+#endif
@@ -0,0 +1,305 @@
+/**
+ * @file relay.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief UDP relay that emulates a bad network (delay, jitter, loss, reordering, duplication)
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#define _GNU_SOURCE     // ppoll()
+
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#include "packet.h"
+
+#define RELAY_QUEUE 4096        // packets that can be held back at once, more are dropped
+#define TO_SERVER 0
+#define TO_CLIENT 1
+
+/*
+ * The client talks to the relay as if it were the server. Everything from the client is
+ * sent on to the server from a second socket, and everything the server sends back goes
+ * to the last address the client sent from.
+ *
+ * Every packet is dropped, duplicated, delayed and held back (so later packets overtake
+ * it) by rolling a seeded random number generator. With a bottleneck, each direction is
+ * also a link of that rate, with room to queue that many packets: a packet waits for the
+ * ones ahead of it to be sent, and is dropped if the queue is full, like at a switch. A FIN
+ * can also be sent again a while later, as a copy that turns up long after the transfer it
+ * ended, in the middle of the next one of the session. Each direction has its own generator,
+ * so the same seed makes the same decisions for the same packets, however the two
+ * directions interleave.
+ */
+
+typedef struct conditions {
+    double delay_ms, jitter_ms, reorder_ms;
+    double loss, reorder, duplicate;    // chance per packet, 0 to 1
+    double rate_mbps;                   // bottleneck link rate, 0 for none
+    u_int queue;                        // packets the bottleneck can queue, more are dropped
+    double replay_ms;                   // every FIN comes again this much later, 0 for never
+} conditions;
+
+typedef struct held_packet {
+    u_llong release;                    // CLOCK_MONOTONIC nanoseconds
+    int direction;
+    size_t len;
+    u_char data[sizeof(Packet)];
+} held_packet;
+
+// min-heap of held packets by release time
+typedef struct relay_queue {
+    held_packet *heap[RELAY_QUEUE];
+    u_int count;
+} relay_queue;
+
+typedef struct relay_counts {
+    u_llong received[2], sent[2], lost[2], duplicated[2], reordered[2], overflowed[2];
+} relay_counts;
+
+static volatile sig_atomic_t stopping;
+
+static void stop_relay(int sig) {
+    (void)sig;
+    stopping = 1;
+    return;
+}
+
+u_llong now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_llong)ts.tv_sec * 1000000000ULL + (u_llong)ts.tv_nsec;
+}
+
+// xorshift64*, returns a number in [0, 1)
+double roll(u_llong *state) {
+    u_llong x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return (double)((x * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+int queue_push(relay_queue *q, held_packet *p) {
+    u_int i, parent;
+    held_packet *swap;
+
+    if (q->count == RELAY_QUEUE) return -1;
+    i = q->count++;
+    q->heap[i] = p;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (q->heap[parent]->release <= q->heap[i]->release) break;
+        swap = q->heap[parent];
+        q->heap[parent] = q->heap[i];
+        q->heap[i] = swap;
+        i = parent;
+    }
+    return 0;
+}
+
+held_packet *queue_pop(relay_queue *q) {
+    held_packet *top = q->heap[0], *swap;
+    u_int i = 0, child;
+
+    q->heap[0] = q->heap[--q->count];
+    while ((child = 2 * i + 1) < q->count) {
+        if (child + 1 < q->count && q->heap[child + 1]->release < q->heap[child]->release) child++;
+        if (q->heap[i]->release <= q->heap[child]->release) break;
+        swap = q->heap[child];
+        q->heap[child] = q->heap[i];
+        q->heap[i] = swap;
+        i = child;
+    }
+    return top;
+}
+
+// decide what happens to a packet that just came in, and hold back what gets through.
+// link_free is when the bottleneck link of this direction is done sending what it has
+void hold_packet(relay_queue *q, conditions *c, u_llong *rng, relay_counts *counts, int direction, u_char *data, size_t len, u_llong *link_free) {
+    held_packet *p;
+    double delay;
+    int copies, i;
+    u_llong now = now_ns(), sent = now, transmit;
+
+    counts->received[direction]++;
+    if (roll(rng) < c->loss) {
+        counts->lost[direction]++;
+        return;
+    }
+    if (c->rate_mbps > 0) {
+        // queued behind what the link hasn't sent yet, dropped if that is a full queue
+        transmit = (u_llong)((double)len * 8 * 1000 / c->rate_mbps);
+        if (*link_free > now && *link_free - now > transmit * c->queue) {
+            counts->lost[direction]++;
+            return;
+        }
+        sent = (*link_free > now ? *link_free : now) + transmit;
+        *link_free = sent;
+    }
+    copies = 1;
+    if (roll(rng) < c->duplicate) {
+        counts->duplicated[direction]++;
+        copies = 2;
+    }
+    for (i = 0; i < copies; i++) {
+        delay = c->delay_ms + c->jitter_ms * (2 * roll(rng) - 1);
+        if (roll(rng) < c->reorder) {
+            counts->reordered[direction]++;
+            delay += c->reorder_ms;
+        }
+        if (delay < 0) delay = 0;
+
+        if ((p = malloc(sizeof(held_packet))) == NULL) return;
+        p->release = sent + (u_llong)(delay * 1e6);
+        p->direction = direction;
+        p->len = len;
+        memcpy(p->data, data, len);
+        if (queue_push(q, p) == -1) {
+            counts->overflowed[direction]++;
+            free(p);
+        }
+    }
+
+    // a late copy of a FIN, past whatever the rolls did to it
+    if (c->replay_ms > 0 && len >= sizeof(packet_header) && is_packet_finale((Packet *)data)) {
+        if ((p = malloc(sizeof(held_packet))) == NULL) return;
+        p->release = sent + (u_llong)((c->delay_ms + c->replay_ms) * 1e6);
+        p->direction = direction;
+        p->len = len;
+        memcpy(p->data, data, len);
+        counts->duplicated[direction]++;
+        if (queue_push(q, p) == -1) {
+            counts->overflowed[direction]++;
+            free(p);
+        }
+    }
+    return;
+}
+
+int main(int argc, char *argv[]) {
+    int opt, rv, front, back, have_client = 0;
+    u_llong seed = 1, rngs[2], now, link_free[2] = { 0, 0 };
+    conditions c = { 0, 0, 0, 0, 0, 0, 0, 64, 0 };
+    relay_counts counts;
+    relay_queue queue;
+    held_packet *p;
+    struct addrinfo hints, *listen_info, *server_info;
+    struct sockaddr_storage client_addr;
+    socklen_t client_len = 0;
+    struct pollfd fds[2];
+    struct timespec timeout;
+    u_char data[sizeof(Packet)];
+    ssize_t n;
+
+    // command line arguments
+    while ((opt = getopt(argc, argv, "d:j:l:r:o:u:b:q:f:s:")) != -1) {
+        if      (opt == 'd') c.delay_ms = atof(optarg);         // one way delay
+        else if (opt == 'j') c.jitter_ms = atof(optarg);        // +/- uniform jitter on the delay
+        else if (opt == 'l') c.loss = atof(optarg) / 100;       // percent of packets lost
+        else if (opt == 'r') c.reorder = atof(optarg) / 100;    // percent of packets held back
+        else if (opt == 'o') c.reorder_ms = atof(optarg);       // how long they are held back
+        else if (opt == 'u') c.duplicate = atof(optarg) / 100;  // percent of packets duplicated
+        else if (opt == 'b') c.rate_mbps = atof(optarg);        // bottleneck rate, Mbit/s
+        else if (opt == 'q') c.queue = (u_int)atoi(optarg);     // bottleneck queue, packets
+        else if (opt == 'f') c.replay_ms = atof(optarg);        // send every FIN again this much later
+        else if (opt == 's') seed = strtoull(optarg, NULL, 10);
+        else                 optind = argc;                     // unknown option, print what is expected
+    }
+    if (argc - optind != 3) {
+        printf("\nArguments expected: [-d <Delay ms>] [-j <Jitter ms>] [-l <Loss %%>] [-r <Reorder %%>] [-o <Reorder ms>] "
+               "[-u <Duplicate %%>] [-b <Bottleneck Mbit/s>] [-q <Queue packets>] [-f <FIN replay ms>] [-s <Seed>] <Relay Port> <Server IP> <Server Port>\n");
+        return -1;
+    }
+    if (c.reorder > 0 && c.reorder_ms == 0) c.reorder_ms = c.delay_ms + c.jitter_ms + 1;
+
+    // seed each direction apart, and never with 0, which xorshift can't leave
+    rngs[TO_SERVER] = seed * 2 + 1;
+    rngs[TO_CLIENT] = seed * 2 + 2;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;          // IPv4
+    hints.ai_socktype = SOCK_DGRAM;     // UDP
+    hints.ai_flags = AI_PASSIVE;        // Listen
+    if ((rv = getaddrinfo(NULL, argv[optind], &hints, &listen_info)) != 0) {
+        print_error((char *)gai_strerror(rv), __LINE__);
+        return -1;
+    }
+    hints.ai_flags = 0;
+    if ((rv = getaddrinfo(argv[optind+1], argv[optind+2], &hints, &server_info)) != 0) {
+        print_error((char *)gai_strerror(rv), __LINE__);
+        return -1;
+    }
+
+    front = socket(listen_info->ai_family, listen_info->ai_socktype, listen_info->ai_protocol);
+    back = socket(server_info->ai_family, server_info->ai_socktype, server_info->ai_protocol);
+    if (front == -1 || back == -1 ||
+        bind(front, listen_info->ai_addr, listen_info->ai_addrlen) == -1 ||
+        connect(back, server_info->ai_addr, server_info->ai_addrlen) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    freeaddrinfo(listen_info);
+    freeaddrinfo(server_info);
+
+    signal(SIGINT, stop_relay);
+    signal(SIGTERM, stop_relay);
+    memset(&counts, 0, sizeof(counts));
+    queue.count = 0;
+    fds[0].fd = front;
+    fds[0].events = POLLIN;
+    fds[1].fd = back;
+    fds[1].events = POLLIN;
+
+    while (!stopping) {
+        // sleep until a packet comes in, or the next held packet is due
+        now = now_ns();
+        if (queue.count > 0) {
+            now = queue.heap[0]->release > now ? queue.heap[0]->release - now : 0;
+            timeout.tv_sec = (time_t)(now / 1000000000ULL);
+            timeout.tv_nsec = (long)(now % 1000000000ULL);
+        }
+        rv = ppoll(fds, 2, queue.count > 0 ? &timeout : NULL, NULL);
+        if (rv == -1 && errno != EINTR) {
+            print_error(strerror(errno), __LINE__);
+            break;
+        }
+
+        if (rv > 0 && (fds[0].revents & POLLIN)) {
+            client_len = sizeof(client_addr);
+            n = recvfrom(front, data, sizeof(data), 0, (struct sockaddr *)&client_addr, &client_len);
+            if (n > 0) {
+                have_client = 1;
+                hold_packet(&queue, &c, &rngs[TO_SERVER], &counts, TO_SERVER, data, (size_t)n, &link_free[TO_SERVER]);
+            }
+        }
+        if (rv > 0 && (fds[1].revents & POLLIN)) {
+            n = recv(back, data, sizeof(data), 0);
+            if (n > 0) hold_packet(&queue, &c, &rngs[TO_CLIENT], &counts, TO_CLIENT, data, (size_t)n, &link_free[TO_CLIENT]);
+        }
+
+        // send everything that is due
+        now = now_ns();
+        while (queue.count > 0 && queue.heap[0]->release <= now) {
+            p = queue_pop(&queue);
+            if (p->direction == TO_SERVER)  n = send(back, p->data, p->len, 0);
+            else if (have_client)           n = sendto(front, p->data, p->len, 0, (struct sockaddr *)&client_addr, client_len);
+            else                            n = -1;
+            if (n > 0) counts.sent[p->direction]++;
+            free(p);
+        }
+    }
+
+    while (queue.count > 0) free(queue_pop(&queue));
+    close(front);
+    close(back);
+    fprintf(stderr, "{\"to_server\":{\"received\":%llu,\"sent\":%llu,\"lost\":%llu,\"duplicated\":%llu,\"reordered\":%llu,\"overflowed\":%llu},"
+                    "\"to_client\":{\"received\":%llu,\"sent\":%llu,\"lost\":%llu,\"duplicated\":%llu,\"reordered\":%llu,\"overflowed\":%llu}}\n",
+            counts.received[TO_SERVER], counts.sent[TO_SERVER], counts.lost[TO_SERVER],
+            counts.duplicated[TO_SERVER], counts.reordered[TO_SERVER], counts.overflowed[TO_SERVER],
+            counts.received[TO_CLIENT], counts.sent[TO_CLIENT], counts.lost[TO_CLIENT],
+            counts.duplicated[TO_CLIENT], counts.reordered[TO_CLIENT], counts.overflowed[TO_CLIENT]);
+    return 0;
+}
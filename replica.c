@@ -0,0 +1,199 @@
+/**
+ * @file replica.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief downloading from several servers with the same files at once
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "replica.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "receiver.h"
+#include "rft.h"
+#include "stats.h"
+
+// how much of what is left a replica asks for: as much as it would download in
+// REPLICA_CHUNK_NS at rate (bytes a second, 0 before its first chunk), but no more than its
+// share of what is left, by how fast each replica came at last (an even share while they
+// aren't known), so near the end a slow replica never holds a chunk the others wait on
+static u_llong chunk_size(replica_work *work, u_llong rate) {
+    u_llong size, share, left = work->total - work->next, sum = 0;
+    int i, known = 0;
+
+    size = rate * REPLICA_CHUNK_NS / 1000000000ULL;
+    if (size < REPLICA_MIN_CHUNK) size = REPLICA_MIN_CHUNK;
+    if (size > REPLICA_MAX_CHUNK) size = REPLICA_MAX_CHUNK;
+
+    for (i = 0; i < MAX_REPLICAS; i++) {
+        sum += work->rates[i];
+        known += work->rates[i] > 0;
+    }
+    // those that don't have a rate yet are counted at the mean of the others
+    if (rate > 0) share = (u_llong)((double)left * (double)rate * known / ((double)sum * work->live));
+    else          share = (left + (u_llong)work->live - 1) / (u_llong)work->live;
+    if (share < REPLICA_MIN_CHUNK) share = REPLICA_MIN_CHUNK;
+
+    if (size > share) size = share;
+    if (size > left) size = left;
+    return size;
+}
+
+// the next chunk for replica id: one handed back, or the next chunk_size() of what is
+// left. With nothing left, waits while chunks are out that may still be handed back, and
+// every REPLICA_IDLE_NS of it claims an empty chunk to keep its session open. Returns 0
+// once there is nothing left to do
+int claim_chunk(replica_work *work, int id, u_llong rate, stream_range *chunk) {
+    struct timespec until;
+    int rv = 0;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += (time_t)(REPLICA_IDLE_NS / 1000000000ULL);
+
+    pthread_mutex_lock(&work->lock);
+    work->rates[id] = rate;
+    while (work->returned_count == 0 && work->next == work->total && work->busy > 0 && rv != ETIMEDOUT) {
+        rv = pthread_cond_timedwait(&work->changed, &work->lock, &until);
+    }
+    if (work->returned_count > 0) {
+        *chunk = work->returned[--work->returned_count];
+    } else if (work->next < work->total) {
+        chunk->count = 1;
+        chunk->parts[0].start = work->next;
+        chunk->parts[0].end = work->next + chunk_size(work, rate);
+        work->next = chunk->parts[0].end;
+    } else if (work->busy > 0) {
+        chunk->count = 0;
+    } else {
+        pthread_mutex_unlock(&work->lock);
+        return 0;
+    }
+    work->busy++;
+    pthread_mutex_unlock(&work->lock);
+
+    chunk->manifest_data = work->manifest_data;
+    chunk->manifest_len = work->manifest_len;
+    return 1;
+}
+
+// replica id is done with its chunk: downloaded, or handed back if the replica failed
+void finish_chunk(replica_work *work, int id, stream_range *chunk, int failed) {
+    pthread_mutex_lock(&work->lock);
+    if (failed) {
+        if (chunk->count > 0) work->returned[work->returned_count++] = *chunk;
+        work->rates[id] = 0;
+        work->live--;
+    } else {
+        work->done += range_size(chunk);
+    }
+    work->busy--;
+    pthread_cond_broadcast(&work->changed);
+    pthread_mutex_unlock(&work->lock);
+    return;
+}
+
+// a replica's thread: download chunks until none are left, or the replica fails
+void *run_replica(void *arg) {
+    replica_worker *r = (replica_worker *)arg;
+    replica_work *work = r->work;
+    stream_range chunk;
+    u_llong rate = 0, began, took;
+
+    memset(&chunk, 0, sizeof(chunk));
+    while (claim_chunk(work, r->id, rate, &chunk)) {
+        began = stats_now();
+        if (rft_request_range(r->connect, work->request, work->request_size, work->local_path, &chunk) == -1) {
+            finish_chunk(work, r->id, &chunk, 1);
+            close(r->connect->socket_desc);
+            r->connect->socket_desc = -1;
+            break;
+        }
+        took = stats_now() - began;
+        if (chunk.count > 0) rate = range_size(&chunk) * 1000000000ULL / (took > 0 ? took : 1);
+        finish_chunk(work, r->id, &chunk, 0);
+    }
+    return NULL;
+}
+
+// get the manifest from the first replica that answers, with a range of nothing
+int fetch_manifest(connection *replicas, int count, char *request, u_short request_size, char *local_path, stream_range *probe) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (replicas[i].socket_desc == -1) continue;
+        memset(probe, 0, sizeof(*probe));
+        if (rft_request_range(&replicas[i], request, request_size, local_path, probe) != -1) return 0;
+        free(probe->manifest_data);
+        close(replicas[i].socket_desc);
+        replicas[i].socket_desc = -1;
+    }
+    memset(probe, 0, sizeof(*probe));
+    print_error("No server could send the files.", __LINE__);
+    return -1;
+}
+
+int rft_get_replicas(connection *replicas, int count, char *request, u_short request_size, char *local_path) {
+    replica_worker workers[MAX_REPLICAS];
+    replica_work work;
+    stream_range probe;
+    manifest files;
+    int i, started = 0, rv = -1;
+
+    if (REQUEST_TYPE(request[0]) != REQUEST_GET || strcmp(local_path, STREAM_PATH) == 0 || count > MAX_REPLICAS) {
+        print_error("Only a GET of files can come from several servers.", __LINE__);
+        return -1;
+    }
+    if (fetch_manifest(replicas, count, request, request_size, local_path, &probe) == -1) return -1;
+
+    manifest_init(&files);
+    if (manifest_decode(&files, probe.manifest_data, probe.manifest_len, local_path) == -1 || create_entries(&files) == -1) {
+        print_error("Could not create the files.", __LINE__);
+        manifest_free(&files);
+        free(probe.manifest_data);
+        return -1;
+    }
+    fprintf(print_stream(), "\ndownloading %u files, %llu bytes from %d servers", files.count, files.total_size, count);
+
+    memset(&work, 0, sizeof(work));
+    pthread_mutex_init(&work.lock, NULL);
+    pthread_cond_init(&work.changed, NULL);
+    work.total = files.total_size;
+    work.manifest_data = probe.manifest_data;
+    work.manifest_len = probe.manifest_len;
+    work.request = request;
+    work.request_size = request_size;
+    work.local_path = local_path;
+    for (i = 0; i < count; i++) work.live += replicas[i].socket_desc != -1;
+    // every replica's progress is of the whole data stream, each landing its own chunks of it
+    for (i = 0; i < count; i++) stats_begin_progress(&replicas[i].stats, files.total_size);
+
+    for (i = 0; i < count; i++) {
+        if (replicas[i].socket_desc == -1) continue;
+        workers[started].connect = &replicas[i];
+        workers[started].work = &work;
+        workers[started].id = started;
+        if (pthread_create(&workers[started].thread, NULL, run_replica, &workers[started]) != 0) {
+            print_error("Couldn't start a replica thread!", __LINE__);
+            pthread_mutex_lock(&work.lock);
+            work.live--;
+            pthread_mutex_unlock(&work.lock);
+            continue;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) pthread_join(workers[i].thread, NULL);
+
+    if (work.done == work.total) {
+        restore_modes(&files);
+        fprintf(print_stream(), "\nFile Transfer Complete!");
+        rv = 0;
+    } else {
+        print_error("Every server failed before the download was done.", __LINE__);
+    }
+    pthread_cond_destroy(&work.changed);
+    pthread_mutex_destroy(&work.lock);
+    manifest_free(&files);
+    free(probe.manifest_data);
+    return rv;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file replica.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief downloading from several servers with the same files at once
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <pthread.h>
+
+#include "connection.h"
+#include "manifest.h"
+#include "packet.h"
+
+#define MAX_REPLICAS 16
+#define REPLICA_MIN_CHUNK (256ULL << 10)    // bytes a replica asks for at first, and at least after
+#define REPLICA_MAX_CHUNK (64ULL << 20)     // bytes a replica asks for at most
+#define REPLICA_CHUNK_NS 500000000ULL       // a replica asks for as much as its last chunk came at in this long
+#define REPLICA_IDLE_NS 2000000000ULL       // a replica waiting on the others asks for nothing this often
+
+/*
+ * replica Design:
+ *
+ * Servers with the same files (replicas) lay them out in the same data stream, so any part
+ * of it can come from any of them. A download from several first gets the manifest from
+ * one (a ranged GET with nothing in the range), creates every file at its full size, then
+ * runs a session with each replica on a thread of its own. Each session asks for the next
+ * chunk of what is left of the data stream in a ranged GET, writes it into the files, and
+ * comes back for another, until nothing is left.
+ *
+ * Nobody decides up front who gets what. A fast replica comes back sooner, and asks for as
+ * much as it downloads in REPLICA_CHUNK_NS, so it ends up with most of the stream, while a
+ * slow one only ever holds up a small chunk. No chunk is more than the replica's share of
+ * what is left, by the rate each replica's last chunk came at, so near the end the chunks
+ * get smaller, the slow replicas' the most, and the replicas finish together instead of
+ * the fast ones waiting out the last big chunk of a slow one. The first chunk, taken before
+ * any rate is known, is small for the same reason. A replica that fails hands its chunk
+ * back for the others to take, and is left out from then on. Every chunk's manifest has
+ * to match the first one, or that replica fails.
+ *
+ * A replica with nothing to take waits, as a chunk may yet be handed back. Its server would
+ * end a session that goes quiet for long, so every REPLICA_IDLE_NS it asks for an empty
+ * range, which is just the manifest again.
+ */
+
+// what is left of a download from several replicas, handed out a chunk at a time
+typedef struct replica_work {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;         // a chunk was downloaded or handed back
+    u_llong next;                   // first byte of the data stream not handed out yet
+    u_llong total;
+    u_llong done;                   // bytes downloaded
+    stream_range returned[MAX_REPLICAS];    // chunks handed back by replicas that failed
+    int returned_count;
+    int busy;                       // replicas downloading a chunk
+    u_llong rates[MAX_REPLICAS];    // bytes a second each replica's last chunk came at, 0 until known or once failed
+    int live;                       // replicas that haven't failed
+    u_char *manifest_data;          // of the first replica, every chunk's has to match it
+    size_t manifest_len;
+    char *request;
+    u_short request_size;
+    char *local_path;
+} replica_work;
+
+// one replica's session, downloading chunk after chunk
+typedef struct replica_worker {
+    connection *connect;
+    replica_work *work;
+    int id;                         // its rate in the work
+    pthread_t thread;
+} replica_worker;
+
+/**
+ * Downloads the files a GET request names from every replica at once into local_path.
+ * Each replica is a session rft_connect()ed to one of the servers, with the priority class
+ * and deadline to ask for, and can be used for any number of downloads, then rft_close()d.
+ * A replica that fails is closed, and its socket_desc set to -1 so later downloads leave it
+ * out. Returns 0 once every byte is in, -1 if not (no replica was left).
+ */
+int rft_get_replicas(connection *replicas, int count, char *request, u_short request_size, char *local_path);
+
+#endif
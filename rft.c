@@ -0,0 +1,829 @@
+/**
+ * @file rft.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief librft: requesting and serving transfers, on the calling thread or on threads of their own
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "rft.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "log.h"
+#include "chunk.h"
+#include "manifest.h"
+#include "receiver.h"
+#include "sender.h"
+
+
+int rft_build_request(char *request, u_short *request_size, u_char type, const char *remote_path, const char *const *names, int count) {
+    const char *name;
+    size_t size = strlen(remote_path) + 2, name_size;
+    int i;
+
+    if (size >= MAX_BUFFER_SIZE) {
+        print_error("Remote Path is too big!", __LINE__);
+        return -1;
+    }
+    request[0] = (char)type;
+    memcpy(request + 1, remote_path, size - 1);
+
+    for (i = 0; i < count; i++) {
+        name = names[i];
+        while (*name == '/') name++;
+        name_size = strlen(name) + 1;
+        if (name_size == 1) continue;
+        if (size + name_size > MAX_BUFFER_SIZE) {
+            print_error("File names are too big!", __LINE__);
+            return -1;
+        }
+        memcpy(request + size, name, name_size);
+        size += name_size;
+    }
+    if (size == strlen(remote_path) + 2) {
+        print_error("No file names given!", __LINE__);
+        return -1;
+    }
+    *request_size = (u_short)size;
+    return 0;
+}
+
+// open a UDP socket with the receive timeout every wait relies on. Listening binds it to
+// the port (shared with other sockets, if shared), otherwise the remote address is kept to
+// send to
+int open_socket(connection *connect, const char *host, const char *port, int listening, int shared) {
+    int rv, socket_desc = -1, one = 1;
+    struct addrinfo hints, *servInfo, *p;
+    struct timeval tv;
+
+    memset(&hints, 0, sizeof(hints));   // set all data in struct to 0
+    hints.ai_family = AF_INET;          // IPv4
+    hints.ai_socktype = SOCK_DGRAM;     // UDP
+    if (listening) hints.ai_flags = AI_PASSIVE;    // Listen
+
+    // set timer
+    tv.tv_sec = SOCKET_TIMEOUT_S;
+    tv.tv_usec = 0;
+
+    rv = getaddrinfo(host, port, &hints, &servInfo);
+    if (rv != 0) {
+        print_error((char *)gai_strerror(rv), __LINE__);
+        return -1;
+    }
+
+    for (p = servInfo; p != NULL; p = p->ai_next) {
+        // socket(): creates a new socket, no address was assigned yet
+        socket_desc = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+        if (socket_desc == -1) {
+            print_error(strerror(errno), __LINE__);
+            continue;
+        }
+        if (shared && setsockopt(socket_desc, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) {
+            print_error(strerror(errno), __LINE__);
+            close(socket_desc);
+            continue;
+        }
+        if (listening && bind(socket_desc, p->ai_addr, p->ai_addrlen) == -1) {
+            print_error(strerror(errno), __LINE__);
+            close(socket_desc);
+            continue;
+        }
+        break;
+    }
+    if (p == NULL) {
+        freeaddrinfo(servInfo);
+        return -1;
+    }
+
+    rv = setsockopt(socket_desc, SOL_SOCKET, SO_RCVTIMEO, (struct timeval *)&tv, sizeof(struct timeval));
+    if (rv == -1) {
+        print_error(strerror(errno), __LINE__);
+        close(socket_desc);
+        freeaddrinfo(servInfo);
+        return -1;
+    }
+
+    // set connection data
+    memset(connect, 0, sizeof(connection));
+    if (!listening) {
+        memcpy(&connect->remote_addr, p->ai_addr, p->ai_addrlen);
+        connect->addr_len = p->ai_addrlen;
+        connect->conn_id = new_connection_id();
+    }
+    connect->socket_desc = socket_desc;
+    connect->is_server = listening;
+    freeaddrinfo(servInfo);
+    return 0;
+}
+
+// the socket side of low latency mode
+int low_latency_socket(connection *connect) {
+    int busy_poll = BUSY_POLL_US;
+
+    // the kernel polls the device queue itself while a receive waits. Raising it past
+    // net.core.busy_read takes CAP_NET_ADMIN, and without it the spin the waits do is the
+    // same in user space, so a refusal is fine
+    setsockopt(connect->socket_desc, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll));
+    // room for a whole burst from the start, rather than once autotuning has grown them,
+    // so none of it is dropped while this side is busy
+    if (tune_buffer(connect, SO_RCVBUF, LOW_LATENCY_BUFFER) == -1 || tune_buffer(connect, SO_SNDBUF, LOW_LATENCY_BUFFER) == -1) return -1;
+    return 0;
+}
+
+int rft_low_latency(connection *connect, int cpu) {
+    char *env = getenv("RFT_SPIN_US");
+
+    if (cpu >= 0 && pin_thread(cpu) == -1) return -1;
+    if (low_latency_socket(connect) == -1) return -1;
+    connect->spin_ns = (u_llong)(env != NULL ? atoi(env) : SPIN_BUDGET_US) * 1000;
+    return 0;
+}
+
+int rft_connect(connection *connect, const char *host, const char *port) {
+    return open_socket(connect, host, port, 0, 0);
+}
+
+int rft_listen(connection *connect, const char *port) {
+    return open_socket(connect, NULL, port, 1, 1);
+}
+
+// send a request and run its transfer. A range is sent right after the type, which moves
+// the rest of the request along
+int request_transfer(connection *connect, char *request, u_short request_size, char *local_path, int direct, stream_range *range) {
+    int rv;
+    u_int seq_num = connect->seq_num + 1;  // requests go on from the last transfer of the session
+    u_short skip = 1, count;
+    u_int i;
+    manifest files;
+    char *root = request + 1;
+    u_char type = REQUEST_TYPE(request[0]);
+
+    Packet send_packet = init_packet();
+    Packet recv_packet = init_packet();
+
+    if (range != NULL) {
+        if (type != REQUEST_GET || range->count > MAX_RANGE_PARTS || request_size + REQUEST_RANGE_SIZE(range->count) > MAX_BUFFER_SIZE) {
+            print_error("Only a GET can ask for a range, with room for it.", __LINE__);
+            return -1;
+        }
+        count = (u_short)range->count;
+        memcpy(send_packet.buff + skip, &count, sizeof(u_short));
+        skip += sizeof(u_short);
+        for (i = 0; i < range->count; i++) {
+            memcpy(send_packet.buff + skip, &range->parts[i].start, sizeof(u_llong));
+            memcpy(send_packet.buff + skip + sizeof(u_llong), &range->parts[i].end, sizeof(u_llong));
+            skip += 2 * sizeof(u_llong);
+        }
+    }
+
+    manifest_init(&files);
+    if (type == REQUEST_PUT) {
+        // the names are local on an upload, so they go out in the manifest rather than the request
+        if (strcmp(local_path, STREAM_PATH) == 0) rv = manifest_add_stream(&files, root + strlen(root) + 1);
+        else                                      rv = manifest_add_names(&files, local_path, root + strlen(root) + 1, request + request_size);
+        if (rv == -1) {
+            print_error(strerror(errno), __LINE__);
+            manifest_free(&files);
+            return -1;
+        }
+        request_size = (u_short)(strlen(root) + 2);
+    }
+
+    // for inital request           1 is SEQ packet
+    set_packet_header(&send_packet, 1, 0, seq_num, 100, (u_short)(request_size - 1 + skip));
+    memcpy(send_packet.buff + skip, request + 1, request_size - 1);
+    send_packet.buff[0] = (u_char)(type | (connect->priority & 0x03) << 4);
+    if (range != NULL) send_packet.buff[0] |= REQUEST_RANGE | (range->chunks ? REQUEST_CHUNKS : 0);
+    send_packet.header.offset = connect->deadline;
+
+    // send request header
+    rv = send_data(connect, &send_packet, __LINE__);
+    if (rv == -1) {
+        manifest_free(&files);
+        return rv;
+    }
+
+    // wait for acknowledgement, or on a GET, the first data in its place
+    rv = wait_for_acknowledgement(connect, &send_packet, &recv_packet);
+    if (rv == -1) {
+        manifest_free(&files);
+        return rv;
+    }
+
+    if (type == REQUEST_PUT) {
+        rv = send_files(connect, &files, &send_packet, &recv_packet, seq_num, 0, NULL);
+        if (rv != -1) fprintf(print_stream(), "\nFile Transfer Complete!");
+    } else {
+        rv = receive_files(connect, &send_packet, &recv_packet, seq_num, local_path, direct, 0, range);
+    }
+    manifest_free(&files);
+    return rv;
+}
+
+int rft_request(connection *connect, char *request, u_short request_size, char *local_path, int direct) {
+    return request_transfer(connect, request, request_size, local_path, direct, NULL);
+}
+
+int rft_request_range(connection *connect, char *request, u_short request_size, char *local_path, stream_range *range) {
+    return request_transfer(connect, request, request_size, local_path, 0, range);
+}
+
+// check a request and, for a GET, build the manifest of the files it names. The request is
+// its type, then the remote root and each name under it, all '\0' terminated. When
+// streaming, a root of STREAM_PATH means stdin (one name, which it is sent as) or stdout.
+// A ranged GET has the parts of the range after the type, which are cut down to the data stream
+int parse_request(manifest *files, Packet *request, int streaming, stream_range *range) {
+    char *root, *name, *end;
+    u_short size = request->header.data_size, skip = 1, count;
+    byte_range *part;
+    u_int i;
+
+    if (size < 2 || size > MAX_BUFFER_SIZE || request->buff[size-1] != '\0') return 1;  // 1 is Bad Request
+    if (REQUEST_CHUNKED(request->buff[0]) && !REQUEST_RANGED(request->buff[0])) return 1;
+    if (REQUEST_RANGED(request->buff[0])) {
+        if (REQUEST_TYPE(request->buff[0]) != REQUEST_GET || size < 2 + REQUEST_RANGE_SIZE(0)) return 1;
+        memcpy(&count, request->buff + skip, sizeof(u_short));
+        if (count > MAX_RANGE_PARTS || size < 2 + REQUEST_RANGE_SIZE(count)) return 1;
+        skip += sizeof(u_short);
+        for (i = 0; i < count; i++) {
+            part = &range->parts[i];
+            memcpy(&part->start, request->buff + skip, sizeof(u_llong));
+            memcpy(&part->end, request->buff + skip + sizeof(u_llong), sizeof(u_llong));
+            skip += 2 * sizeof(u_llong);
+            if (part->end < part->start || (i > 0 && part->start < range->parts[i - 1].end)) return 1;
+        }
+        range->count = count;
+        range->chunks = REQUEST_CHUNKED(request->buff[0]) != 0;
+    }
+    root = (char *)request->buff + skip;
+    end = (char *)request->buff + size;
+
+    if (REQUEST_TYPE(request->buff[0]) == REQUEST_PUT) return 0;
+    if (REQUEST_TYPE(request->buff[0]) != REQUEST_GET) return 1;                      // 1 is Bad Request
+
+    if (streaming && strcmp(root, STREAM_PATH) == 0) {
+        name = root + strlen(root) + 1;
+        if (name >= end || name + strlen(name) + 1 != end) return 1;                 // 1 is Bad Request
+        if (REQUEST_RANGED(request->buff[0])) return 1;                              // a stream has no offsets yet
+        return manifest_add_stream(files, name) == -1 ? 3 : 0;                       // 3 is Unknown/Unhandled Error
+    }
+
+    if (manifest_add_names(files, root, root + strlen(root) + 1, end) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return 2;                                                                      // 2 is File Not Found
+    }
+    if (files->count == 0) return 1;                                                  // 1 is Bad Request
+    for (i = 0; i < range->count; i++) {
+        part = &range->parts[i];
+        if (part->end > files->total_size) part->end = files->total_size;
+        if (part->start > part->end) part->start = part->end;
+    }
+    return 0;
+}
+
+// cut the files into chunks for a request that asks for the chunk list, and encode it
+int encode_chunks(manifest *files, stream_range *range) {
+    chunk_list chunks;
+    long len;
+
+    chunk_list_init(&chunks);
+    if (chunk_list_build(&chunks, files) == -1 || (len = chunk_list_encode(&chunks, &range->chunk_data)) == -1) {
+        chunk_list_free(&chunks);
+        return -1;
+    }
+    range->chunk_len = (size_t)len;
+    chunk_list_free(&chunks);
+    return 0;
+}
+
+// a request's files being cut into chunks, on a thread of its own
+typedef struct chunk_job {
+    manifest *files;
+    stream_range *range;
+    int done_desc;          // eventfd, readable once it is done
+    int rv;
+} chunk_job;
+
+void *run_chunks(void *arg) {
+    chunk_job *job = (chunk_job *)arg;
+    u_llong one = 1;
+
+    job->rv = encode_chunks(job->files, job->range);
+    if (write(job->done_desc, &one, sizeof(one)) == -1) print_error(strerror(errno), __LINE__);
+    return NULL;
+}
+
+// cut the files into chunks on a worker, keeping the request alive with ACKs of it while it
+// runs: reading and hashing a large file takes longer than the client waits for an answer,
+// and an ACK of the request tells it the request came in and its data is on the way.
+// Returns -1 if the client gave up, 3 (Unknown/Unhandled Error) if the files couldn't be
+// cut, else 0
+int build_chunks(connection *connect, manifest *files, stream_range *range, Packet *send_packet, Packet *recv_packet, u_int seq_num) {
+    chunk_job job = { files, range, -1, -1 };
+    pthread_t thread;
+    int rv, ready;
+
+    if ((job.done_desc = eventfd(0, 0)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return 3;
+    }
+    if (pthread_create(&thread, NULL, run_chunks, &job) != 0) {
+        print_error("Couldn't start the chunk thread!", __LINE__);
+        close(job.done_desc);
+        return 3;
+    }
+    rv = send_acknowledgement(connect, send_packet, seq_num) == -1 ? -1 : 0;
+    while (rv == 0) {
+        if (keep_alive(connect, send_packet, seq_num) == -1 || (ready = wait_for_timer(connect, job.done_desc, connect->last_send + KEEPALIVE_NS)) == -1) {
+            rv = -1;
+        } else if (ready & WAIT_TIMER) {
+            break;
+        } else if (ready & WAIT_PACKET && recv_data(connect, recv_packet) != -1) {
+            // the request again, or ACKs of the session, are answered by the next ACK
+            log_packet(LOG_EVENT_RECV, recv_packet, connect->is_server);
+            if (is_packet_error(recv_packet) && recv_packet->header.seq_num == seq_num) {     // the client gave up
+                print_error_msg(recv_packet, __LINE__);
+                send_acknowledgement(connect, send_packet, seq_num);
+                rv = -1;
+            }
+        }
+    }
+    pthread_join(thread, NULL);
+    close(job.done_desc);
+    if (rv == 0 && job.rv == -1) rv = 3;
+    return rv;
+}
+
+// where an upload to the root a client asked for goes: under the upload directory, and
+// never out of it. Returns the Bad Request error if the root is absolute, climbs out with
+// .., or doesn't fit, else 0
+int upload_path(char *path, size_t size, const char *upload_dir, const char *root, int streaming) {
+    int len;
+
+    // when streaming, - is stdout
+    if (streaming && strcmp(root, STREAM_PATH) == 0) {
+        strcpy(path, STREAM_PATH);
+        return 0;
+    }
+    if (!is_safe_name(root)) return 1;                                                // 1 is Bad Request
+    len = snprintf(path, size, "%s/%s", upload_dir != NULL ? upload_dir : ".", root);
+    if (len < 0 || (size_t)len >= size) return 1;                                     // 1 is Bad Request
+    return 0;
+}
+
+// answer the request in recv_packet: send or receive the files it names
+int serve_request(connection *connect, Packet *send_packet, Packet *recv_packet, int zero_elision, int streaming) {
+    int rv;
+    u_int seq_num = recv_packet->header.seq_num;
+    manifest files;
+    char root[PATH_MAX];
+    stream_range range;
+    int ranged = REQUEST_RANGED(recv_packet->buff[0]);
+
+    // the answer to a request ACKs it: the ERR, the first data of a GET, or the ACK of a PUT
+    manifest_init(&files);
+    memset(&range, 0, sizeof(range));
+    rv = parse_request(&files, recv_packet, streaming, &range);
+    if (rv == 0 && REQUEST_TYPE(recv_packet->buff[0]) == REQUEST_PUT) {
+        rv = upload_path(root, sizeof(root), connect->upload_dir, (char *)recv_packet->buff + 1, streaming);
+    }
+    if (rv != 0) {
+        manifest_free(&files);
+        return send_error_packet(connect, send_packet, recv_packet, (u_int)rv);
+    }
+
+    // what we send for it is scheduled by the class and deadline it asks for
+    connect->priority = REQUEST_PRIORITY(recv_packet->buff[0]);
+    connect->deadline = recv_packet->header.offset > UINT_MAX ? UINT_MAX : (u_int)recv_packet->header.offset;
+
+    if (REQUEST_TYPE(recv_packet->buff[0]) == REQUEST_PUT) {
+        rv = send_acknowledgement(connect, send_packet, seq_num);
+        if (rv == -1) {
+            manifest_free(&files);
+            return rv;
+        }
+        // the client sends, we write under the root, renaming each file into place once complete
+        rv = receive_files(connect, send_packet, recv_packet, seq_num, root, 0, 1, NULL);
+    } else {
+        if (range.chunks && (rv = build_chunks(connect, &files, &range, send_packet, recv_packet, seq_num)) != 0) {
+            manifest_free(&files);
+            free(range.chunk_data);
+            if (rv == -1) return rv;
+            print_error("Could not cut the files into chunks.", __LINE__);   // 3 is Unknown/Unhandled Error
+            return send_error_packet(connect, send_packet, recv_packet, 3);
+        }
+        rv = send_files(connect, &files, send_packet, recv_packet, seq_num, zero_elision, ranged ? &range : NULL);
+        free(range.chunk_data);
+    }
+    manifest_free(&files);
+    return rv;
+}
+
+// ACK the FIN that ends the session, then linger for two timeouts, ACKing it again if it
+// comes again, so a lost ACK doesn't leave the client retrying to nobody. One timeout
+// would race the client's own timeout before it resends
+int close_session(connection *connect, Packet *send_packet, Packet *recv_packet) {
+    u_int seq_num = recv_packet->header.seq_num;
+    int quiet = 0;
+
+    if (send_acknowledgement(connect, send_packet, seq_num) == -1) return -1;
+    while (quiet < 2) {
+        if (recv_data(connect, recv_packet) == -1) {
+            quiet++;
+            continue;
+        }
+        log_packet(LOG_EVENT_RECV, recv_packet, connect->is_server);
+        if (is_packet_finale(recv_packet) && recv_packet->header.seq_num == seq_num) {
+            if (send_acknowledgement(connect, send_packet, seq_num) == -1) return -1;
+        }
+    }
+    return 0;
+}
+
+// serve a session, from its first request if that was already taken in (by rft_accept())
+int serve_session(connection *connect, Packet *first, int zero_elision, int streaming) {
+    int rv, idle = 0, pending = 0;
+    u_int seq_num;
+
+    Packet send_packet = init_packet();
+    Packet recv_packet = init_packet();
+
+    if (first != NULL) {
+        memcpy(&recv_packet, first, get_packet_size(first));
+        pending = 1;
+    }
+
+    while (1) {
+        // wait for the next request, forever for the first one. The request may already be
+        // here, if it came in place of the ACK of the last FIN
+        if (!pending) {
+            rv = recv_data(connect, &recv_packet);
+            if (rv == -1) {
+                log_event(LOG_DEBUG, LOG_EVENT_TIMEOUT, connect->is_server);
+                if (connect->seq_num > 0 && ++idle >= MAX_RETRIES) {
+                    print_error("Session timed out.", __LINE__);
+                    return 0;
+                }
+                continue;
+            }
+            log_packet(LOG_EVENT_RECV, &recv_packet, connect->is_server);
+        }
+        pending = 0;
+        idle = 0;
+        seq_num = recv_packet.header.seq_num;
+
+        if (connect->seq_num == 0) {    // first packet of the session
+            STATS_SET(connect->stats.start, stats_now());
+            if (!is_packet_sequence(&recv_packet) || seq_num != 1) {        // 1 is Bad Request
+                send_acknowledgement(connect, &send_packet, seq_num);
+                return send_error_packet(connect, &send_packet, &recv_packet, 1);
+            }
+        } else if (seq_num != connect->seq_num + 1) {
+            // the tail of the last transfer (its FIN again, when our ACK was lost): ACK it again
+            if (!is_packet_acknowledgement(&recv_packet) && seq_num <= connect->seq_num) {
+                send_acknowledgement(connect, &send_packet, seq_num);
+            }
+            continue;
+        } else if (is_packet_finale(&recv_packet)) {   // the client is done with the session
+            return close_session(connect, &send_packet, &recv_packet);
+        } else if (!is_packet_sequence(&recv_packet)) {
+            // the client gave up on the last request after we were done with it
+            if (is_packet_error(&recv_packet)) send_acknowledgement(connect, &send_packet, seq_num);
+            continue;
+        }
+
+        rv = serve_request(connect, &send_packet, &recv_packet, zero_elision, streaming);
+        if (rv == -1) return rv;
+        pending = is_packet_sequence(&recv_packet) && recv_packet.header.seq_num == connect->seq_num + 1;
+    }
+}
+
+int rft_respond(connection *connect, int zero_elision, int streaming) {
+    return serve_session(connect, NULL, zero_elision, streaming);
+}
+
+int rft_close(connection *connect) {
+    Packet send_packet = init_packet();
+    Packet recv_packet = init_packet();
+    return send_finale_packet(connect, &send_packet, &recv_packet, connect->seq_num + 1, 0);
+}
+
+int rft_init(rft_context *ctx) {
+    ctx->event_desc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ctx->event_desc == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    if (rate_init(&ctx->limiter, 0, 0, 0) == -1) {
+        close(ctx->event_desc);
+        return -1;
+    }
+    pthread_mutex_init(&ctx->lock, NULL);
+    ctx->done = NULL;
+    ctx->running = 0;
+    ctx->sessions = NULL;
+    return 0;
+}
+
+void rft_limit(rft_context *ctx, u_llong transfer_rate, u_llong client_rate, u_llong global_rate) {
+    pthread_mutex_lock(&ctx->limiter.lock);
+    ctx->limiter.transfer_rate = transfer_rate;
+    ctx->limiter.client_rate = client_rate;
+    ctx->limiter.global_rate = global_rate;
+    atomic_fetch_add(&ctx->limiter.generation, 1);
+    pthread_mutex_unlock(&ctx->limiter.lock);
+    return;
+}
+
+int rft_fd(rft_context *ctx) {
+    return ctx->event_desc;
+}
+
+// take a transfer off the sessions of its context, if it is one. The lock is held
+void unlist_session(rft_context *ctx, rft_transfer *t) {
+    rft_transfer **session;
+
+    for (session = &ctx->sessions; *session != NULL; session = &(*session)->next_session) {
+        if (*session == t) {
+            *session = t->next_session;
+            break;
+        }
+    }
+    return;
+}
+
+// a transfer's thread: run it to the end, then hand it to rft_poll()
+void *run_transfer(void *arg) {
+    rft_transfer *t = (rft_transfer *)arg;
+    rft_context *ctx = t->ctx;
+    u_llong one = 1;
+
+    if (t->is_server) {
+        t->result = serve_session(&t->connect, t->first.header.seq_num != 0 ? &t->first : NULL, t->zero_elision, t->streaming);
+    } else {
+        t->result = rft_request(&t->connect, t->request, t->request_size, t->local_path, t->direct);
+        if (t->result != -1) rft_close(&t->connect);
+    }
+    stats_finish(&t->connect.stats);
+    close(t->connect.socket_desc);
+    log_release();
+
+    pthread_mutex_lock(&ctx->lock);
+    unlist_session(ctx, t);
+    t->next = ctx->done;
+    ctx->done = t;
+    pthread_mutex_unlock(&ctx->lock);
+    if (write(ctx->event_desc, &one, sizeof(one)) == -1) print_error(strerror(errno), __LINE__);
+    return NULL;
+}
+
+// start the thread of a transfer whose socket is open, or free it
+rft_transfer *start_transfer(rft_context *ctx, rft_transfer *t) {
+    t->ctx = ctx;
+    t->connect.limiter = &ctx->limiter;
+    // before the thread starts, so the caller can show the stats right away
+    stats_init(&t->connect.stats);
+    pthread_mutex_lock(&ctx->lock);
+    ctx->running++;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (pthread_create(&t->thread, NULL, run_transfer, t) != 0) {
+        print_error("Couldn't start the transfer thread!", __LINE__);
+        pthread_mutex_lock(&ctx->lock);
+        unlist_session(ctx, t);
+        ctx->running--;
+        pthread_mutex_unlock(&ctx->lock);
+        close(t->connect.socket_desc);
+        free(t->local_path);
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+rft_transfer *start_client(rft_context *ctx, const char *host, const char *port, u_char type, const char *remote_path,
+                           const char *const *names, int count, const char *local_path, int direct,
+                           u_int priority, u_int deadline, rft_callback callback, void *arg) {
+    rft_transfer *t = calloc(1, sizeof(rft_transfer));
+    if (t == NULL) {
+        print_error(strerror(errno), __LINE__);
+        return NULL;
+    }
+    if (rft_build_request(t->request, &t->request_size, type, remote_path, names, count) == -1 ||
+        (t->local_path = strdup(local_path)) == NULL) {
+        free(t);
+        return NULL;
+    }
+    if (rft_connect(&t->connect, host, port) == -1) {
+        free(t->local_path);
+        free(t);
+        return NULL;
+    }
+    t->direct = direct;
+    t->connect.priority = priority;
+    t->connect.deadline = deadline;
+    t->callback = callback;
+    t->arg = arg;
+    return start_transfer(ctx, t);
+}
+
+rft_transfer *rft_get(rft_context *ctx, const char *host, const char *port, const char *remote_path,
+                      const char *const *names, int count, const char *local_path, int direct,
+                      u_int priority, u_int deadline, rft_callback callback, void *arg) {
+    return start_client(ctx, host, port, REQUEST_GET, remote_path, names, count, local_path, direct, priority, deadline, callback, arg);
+}
+
+rft_transfer *rft_put(rft_context *ctx, const char *host, const char *port, const char *remote_path,
+                      const char *const *names, int count, const char *local_path,
+                      u_int priority, u_int deadline, rft_callback callback, void *arg) {
+    return start_client(ctx, host, port, REQUEST_PUT, remote_path, names, count, local_path, 0, priority, deadline, callback, arg);
+}
+
+rft_transfer *rft_serve(rft_context *ctx, const char *port, int zero_elision, u_int weight, rft_callback callback, void *arg) {
+    rft_transfer *t = calloc(1, sizeof(rft_transfer));
+    if (t == NULL) {
+        print_error(strerror(errno), __LINE__);
+        return NULL;
+    }
+    if (open_socket(&t->connect, NULL, port, 1, 0) == -1) {
+        free(t);
+        return NULL;
+    }
+    t->is_server = 1;
+    t->connect.weight = weight;
+    t->zero_elision = zero_elision;
+    t->callback = callback;
+    t->arg = arg;
+    return start_transfer(ctx, t);
+}
+
+// a socket for a session on the listener's port, connected to its client at addr
+int open_session(connection *listener, connection *session, struct sockaddr_storage *addr, socklen_t addr_len) {
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    struct timeval tv;
+    int socket_desc, one = 1;
+
+    tv.tv_sec = SOCKET_TIMEOUT_S;
+    tv.tv_usec = 0;
+    if (getsockname(listener->socket_desc, (struct sockaddr *)&local, &local_len) == -1 ||
+        (socket_desc = socket(local.ss_family, SOCK_DGRAM, 0)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    if (setsockopt(socket_desc, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1 ||
+        bind(socket_desc, (struct sockaddr *)&local, local_len) == -1 ||
+        connect(socket_desc, (struct sockaddr *)addr, addr_len) == -1 ||
+        setsockopt(socket_desc, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        close(socket_desc);
+        return -1;
+    }
+
+    // the listener's settings, and nothing of its own
+    memcpy(session, listener, sizeof(connection));
+    session->socket_desc = socket_desc;
+    memcpy(&session->remote_addr, addr, addr_len);
+    session->addr_len = addr_len;
+    if (session->spin_ns > 0 && low_latency_socket(session) == -1) {
+        close(socket_desc);
+        return -1;
+    }
+    return 0;
+}
+
+// a packet of a running session that came in on the listener is from an address its socket
+// isn't connected to: its client's address changed. Connect it to the new one. Returns 1
+// if the packet was a running session's, else 0
+int move_session(rft_context *ctx, Packet *packet, struct sockaddr_storage *addr, socklen_t addr_len) {
+    rft_transfer *t;
+
+    pthread_mutex_lock(&ctx->lock);
+    for (t = ctx->sessions; t != NULL && t->connect.conn_id != packet->header.conn_id; t = t->next_session);
+    if (t != NULL && connect(t->connect.socket_desc, (struct sockaddr *)addr, addr_len) == -1) print_error(strerror(errno), __LINE__);
+    pthread_mutex_unlock(&ctx->lock);
+    return t != NULL;
+}
+
+// take in one packet from the listener, moving the session it is of if it is a running
+// one's. Returns its length if it is the request that starts a new session, else 0
+int listen_packet(rft_context *ctx, connection *listener, Packet *packet, struct sockaddr_storage *addr, socklen_t *addr_len) {
+    int len;
+
+    *addr_len = sizeof(struct sockaddr_storage);
+    len = (int)recvfrom(listener->socket_desc, packet, sizeof(Packet), MSG_DONTWAIT, (struct sockaddr *)addr, addr_len);
+    if (len == -1) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) print_error(strerror(errno), __LINE__);
+        return 0;
+    }
+    if (!is_packet_valid(packet, len) || move_session(ctx, packet, addr, *addr_len)) return 0;
+    // anything but a request to start a session is left for the client to resend to its own
+    if (!is_packet_sequence(packet) || packet->header.seq_num != 1) return 0;
+    log_packet(LOG_EVENT_RECV, packet, listener->is_server);
+    return len;
+}
+
+void rft_follow(rft_context *ctx, connection *listener) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    Packet packet;
+
+    listen_packet(ctx, listener, &packet, &addr, &addr_len);
+    return;
+}
+
+rft_transfer *rft_accept(rft_context *ctx, connection *listener, int zero_elision, int streaming, u_int weight, rft_callback callback, void *arg) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    rft_transfer *t;
+    Packet packet;
+    int len;
+
+    if ((len = listen_packet(ctx, listener, &packet, &addr, &addr_len)) == 0) return NULL;
+
+    if ((t = calloc(1, sizeof(rft_transfer))) == NULL) {
+        print_error(strerror(errno), __LINE__);
+        return NULL;
+    }
+    if (open_session(listener, &t->connect, &addr, addr_len) == -1) {
+        free(t);
+        return NULL;
+    }
+    t->connect.conn_id = packet.header.conn_id;
+    t->connect.weight = weight;
+    memcpy(&t->first, &packet, (size_t)len);
+    t->is_server = 1;
+    t->zero_elision = zero_elision;
+    t->streaming = streaming;
+    t->callback = callback;
+    t->arg = arg;
+
+    // a session is found by its ID from the moment its socket is connected, so a copy of
+    // its request that came in on the listener meanwhile doesn't start it again
+    pthread_mutex_lock(&ctx->lock);
+    t->next_session = ctx->sessions;
+    ctx->sessions = t;
+    pthread_mutex_unlock(&ctx->lock);
+    return start_transfer(ctx, t);
+}
+
+int rft_poll(rft_context *ctx) {
+    rft_transfer *done = NULL, *t, *next;
+    u_llong count;
+    int n = 0;
+
+    // clear the eventfd before taking the list, so a transfer that finishes after this wakes the next call
+    if (read(ctx->event_desc, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    pthread_mutex_lock(&ctx->lock);
+    t = ctx->done;
+    ctx->done = NULL;
+    pthread_mutex_unlock(&ctx->lock);
+
+    // oldest first
+    for (; t != NULL; t = next) {
+        next = t->next;
+        t->next = done;
+        done = t;
+    }
+
+    for (t = done; t != NULL; t = next) {
+        next = t->next;
+        pthread_join(t->thread, NULL);
+        if (t->callback != NULL) t->callback(t, t->result, &t->connect.stats, t->arg);
+        free(t->local_path);
+        free(t);
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->running--;
+        pthread_mutex_unlock(&ctx->lock);
+        n++;
+    }
+    return n;
+}
+
+void rft_free(rft_context *ctx) {
+    struct pollfd fd;
+    u_int running;
+
+    fd.fd = ctx->event_desc;
+    fd.events = POLLIN;
+    while (1) {
+        pthread_mutex_lock(&ctx->lock);
+        running = ctx->running;
+        pthread_mutex_unlock(&ctx->lock);
+        if (running == 0) break;
+
+        if (poll(&fd, 1, -1) == -1 && errno != EINTR) break;
+        if (rft_poll(ctx) == -1) break;
+    }
+    close(ctx->event_desc);
+    pthread_mutex_destroy(&ctx->lock);
+    rate_free(&ctx->limiter);
+    return;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file rft.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief librft: requesting and serving transfers, on the calling thread or on threads of their own
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef RFT_H
+#define RFT_H
+
+#include <pthread.h>
+
+#include "connection.h"
+#include "manifest.h"
+#include "packet.h"
+#include "rate.h"
+#include "stats.h"
+
+#define BUSY_POLL_US 50                 // low latency: SO_BUSY_POLL, how long the kernel polls the device per receive
+#define LOW_LATENCY_BUFFER (4 << 20)    // low latency: SO_RCVBUF and SO_SNDBUF (up to the buffer cap)
+
+/*
+ * librft Design:
+ * The blocking calls (rft_connect()/rft_listen(), then rft_request() or rft_respond())
+ * run transfers start to finish on the calling thread; the client and server are built
+ * on them. A connection is a session: the client can make any number of requests on it,
+ * one after the other, then rft_close() it. Each request is sent the moment the last
+ * transfer's FIN comes in, and the session keeps its socket, ID and counters throughout.
+ * Each side also keeps what the last transfer it sent learned of the path (the RTT, RTO,
+ * congestion window and window limit), so the next one starts warm rather than in slow
+ * start. Requests aren't pipelined: the next one waits for the FIN of the last.
+ *
+ * rft_get(), rft_put(), rft_serve() and rft_accept() start a transfer on a thread of its
+ * own, running the blocking calls above, and return at once. They aren't an event-driven
+ * API: nothing of a running transfer (its socket, its timers) is exposed, and rft_poll()
+ * doesn't drive it. They only report completion: a finished transfer is put on its
+ * context's done list and the context's eventfd becomes readable, and rft_poll() then
+ * runs the callback of every finished transfer on the calling thread, so callbacks never
+ * race each other.
+ * rft_fd() can be waited on with poll() or added to any loop the program already has.
+ *
+ * So a running transfer costs a thread (plus a disk reader while it sends, and
+ * DISK_IO_POOL_SIZE disk threads where io_uring isn't there), each with its own stack, and
+ * the kernel switches between them. Hundreds at once are fine; thousands are bounded by
+ * the process's thread limit and memory, and a transfer whose thread can't be started
+ * isn't (rft_get(), rft_put(), rft_serve() and rft_accept() return NULL).
+ *
+ * Many sessions share one port through rft_accept(): the first request of each comes in
+ * on the listener (rft_listen()), and the session is served on a socket of its own, bound
+ * to the same port (SO_REUSEPORT) and connected to its client. The kernel hands a
+ * connected socket every packet from its client, and never picks one for a packet from
+ * anywhere else, so the listener only hears new sessions, and clients whose address
+ * changed (NAT rebinding): a packet of a running session, by its ID, from an address its
+ * socket isn't connected to. The listener connects the socket to the new address, and
+ * the session answers it from the next packet on. rft_serve() instead binds a port of its
+ * own, for one session.
+ *
+ * Every transfer of a context shares its rate limiter: rft_limit() caps each transfer, each
+ * client and the whole context. The transfers sending under a cap share it by the priority
+ * class and deadline of their requests, then by weight: a server running many sessions
+ * sends urgent requests first while bulk ones stream underneath.
+ *
+ * Call log_start() first to get RFT_LOG output, and print_error() still prints to
+ * print_stream().
+ */
+
+typedef struct rft_transfer rft_transfer;
+
+/**
+ * Called from rft_poll() once a transfer is over. result is 0 if it succeeded, -1 if not.
+ * stats (and the transfer) are freed once this returns.
+ */
+typedef void (*rft_callback)(rft_transfer *transfer, int result, transfer_stats *stats, void *arg);
+
+struct rft_transfer {
+    struct rft_context *ctx;
+    connection connect;
+    pthread_t thread;
+    int is_server;
+    char request[MAX_BUFFER_SIZE];      // client: the request to send
+    u_short request_size;
+    char *local_path;                   // client: where a download is written, or an upload read from
+    int direct;                         // client: O_DIRECT writes
+    int zero_elision;                   // server: send all zero chunks as holes
+    int streaming;                      // server: a remote path of STREAM_PATH is stdin or stdout
+    Packet first;                       // server: the request rft_accept() started the session on
+    int result;
+    rft_callback callback;
+    void *arg;
+    rft_transfer *next;
+    rft_transfer *next_session;         // rft_accept(): the next session running
+};
+
+typedef struct rft_context {
+    int event_desc;                     // eventfd, readable while transfers are done
+    pthread_mutex_t lock;
+    rft_transfer *done;                 // finished, waiting for rft_poll(), newest first
+    u_int running;                      // started, and not through rft_poll() yet
+    rft_transfer *sessions;             // started by rft_accept(), and not done yet
+    rate_limiter limiter;               // shared by every transfer of the context
+} rft_context;
+
+/**
+ * Builds a request: its type (REQUEST_GET or REQUEST_PUT), the remote path, then each name
+ * (relative to the remote path on a GET, or to the local path on a PUT).
+ */
+int rft_build_request(char *request, u_short *request_size, u_char type, const char *remote_path, const char *const *names, int count);
+
+/**
+ * Opens a UDP socket to a server into connect.
+ */
+int rft_connect(connection *connect, const char *host, const char *port);
+
+/**
+ * Opens a UDP socket listening on port into connect, which rft_accept() can take sessions
+ * off. Other sockets may bind the port too (SO_REUSEPORT).
+ */
+int rft_listen(connection *connect, const char *port);
+
+/**
+ * Low latency mode, for small transfers where the wakeup of a blocked thread is much of
+ * the time: pins the calling thread to cpu (unless it is negative; the disk threads it
+ * starts run elsewhere), makes every wait on connect spin on non-blocking polls for
+ * SPIN_BUDGET_US (or $RFT_SPIN_US) before it blocks, asks the kernel to busy poll the
+ * socket, and raises its buffers up front. It costs a core spinning while a transfer waits.
+ * Returns -1 if the thread couldn't be pinned.
+ */
+int rft_low_latency(connection *connect, int cpu);
+
+/**
+ * Client side of a transfer: sends the request, then receives or sends the files. Blocks.
+ * Can be called again on the same connection for the next request of the session. The
+ * request asks for connect's priority class and deadline.
+ */
+int rft_request(connection *connect, char *request, u_short request_size, char *local_path, int direct);
+
+/**
+ * rft_request() of a GET for only the part of its data stream in range, written into the
+ * files create_entries() made under local_path (see receive_files()).
+ */
+int rft_request_range(connection *connect, char *request, u_short request_size, char *local_path, stream_range *range);
+
+/**
+ * Ends the client's session, so the server doesn't wait for more requests.
+ */
+int rft_close(connection *connect);
+
+/**
+ * Server side of a session: waits for a request, then sends or receives the files, until
+ * the client closes the session or is silent for MAX_RETRIES timeouts. Blocks. When
+ * streaming, a remote path of STREAM_PATH is stdin or stdout. Uploads are written under
+ * the connection's upload_dir, and one to an absolute path or with a .. is a Bad Request.
+ */
+int rft_respond(connection *connect, int zero_elision, int streaming);
+
+/**
+ * Initializes a context for transfers that run on threads of their own.
+ */
+int rft_init(rft_context *ctx);
+
+/**
+ * Caps what the transfers of the context send, in bytes per second (0 for no cap): each
+ * transfer, everything sent to one client (by IP address), and everything sent at all.
+ * Transfers sending under the same cap share it in proportion to their weights.
+ */
+void rft_limit(rft_context *ctx, u_llong transfer_rate, u_llong client_rate, u_llong global_rate);
+
+/**
+ * Returns the file descriptor to wait on: readable when rft_poll() has callbacks to run.
+ */
+int rft_fd(rft_context *ctx);
+
+/**
+ * Starts downloading the names under remote_path on the server into local_path. The server
+ * sends them in the priority class asked for (0 to 3, higher first), within deadline
+ * milliseconds if it can (0 for none). Returns NULL if it couldn't be started.
+ */
+rft_transfer *rft_get(rft_context *ctx, const char *host, const char *port, const char *remote_path,
+                      const char *const *names, int count, const char *local_path, int direct,
+                      u_int priority, u_int deadline, rft_callback callback, void *arg);
+
+/**
+ * Starts uploading the names under local_path into remote_path on the server, in the
+ * priority class and within the deadline given, as rft_get() does.
+ * Returns NULL if it couldn't be started.
+ */
+rft_transfer *rft_put(rft_context *ctx, const char *host, const char *port, const char *remote_path,
+                      const char *const *names, int count, const char *local_path,
+                      u_int priority, u_int deadline, rft_callback callback, void *arg);
+
+/**
+ * Starts serving the session of the first request that comes in on port. Its share of the
+ * rate caps is weighted by weight (1 if 0). Returns NULL if it couldn't be started.
+ */
+rft_transfer *rft_serve(rft_context *ctx, const char *port, int zero_elision, u_int weight, rft_callback callback, void *arg);
+
+/**
+ * Takes in one packet from listener (opened by rft_listen(), and readable): if it is the
+ * first request of a new session, starts serving the session on a thread of its own, on a
+ * socket connected to its client, and returns it. The session has listener's settings
+ * (buffer cap, upload directory, low latency), and its share of the rate caps is weighted
+ * by weight (1 if 0). With streaming, a remote path of STREAM_PATH is stdin or stdout, as
+ * rft_respond() has it, so only one session should be started with it. A packet of a
+ * running session, from a new address of its client, moves the session to that address.
+ * Returns NULL if no session was started (the packet wasn't a new one's, or it couldn't be).
+ */
+rft_transfer *rft_accept(rft_context *ctx, connection *listener, int zero_elision, int streaming, u_int weight, rft_callback callback, void *arg);
+
+/**
+ * Takes in one packet from listener as rft_accept() does, but never starts a session: for
+ * a server done taking new ones, whose running sessions still follow their clients.
+ */
+void rft_follow(rft_context *ctx, connection *listener);
+
+/**
+ * Runs the callback of every transfer that finished, and frees them. Never blocks.
+ * Returns how many finished.
+ */
+int rft_poll(rft_context *ctx);
+
+/**
+ * Waits for every running transfer (running their callbacks), then frees the context.
+ */
+void rft_free(rft_context *ctx);
+
+#endif
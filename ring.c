@@ -0,0 +1,109 @@
+/**
+ * @file ring.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief lock-free single-producer/single-consumer ring buffer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "ring.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+#define RING_SPINS 64
+#define RING_SLEEP_NS 20000
+
+// back off while waiting on the other side of the ring: spin, then yield, then sleep
+static void ring_backoff(u_int *spins) {
+    struct timespec ts;
+    if (*spins < RING_SPINS) {
+        (*spins)++;
+        sched_yield();
+        return;
+    }
+    ts.tv_sec = 0;
+    ts.tv_nsec = RING_SLEEP_NS;
+    nanosleep(&ts, NULL);
+    return;
+}
+
+int ring_init(ring *r, u_int size, size_t slot_size) {
+    u_int real_size = 1;
+    while (real_size < size) real_size <<= 1;
+
+    r->slots = malloc((size_t)real_size * slot_size);
+    if (r->slots == NULL) return -1;
+
+    r->size = real_size;
+    r->slot_size = slot_size;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->closed, 0);
+    return 0;
+}
+
+void ring_free(ring *r) {
+    free(r->slots);
+    r->slots = NULL;
+    return;
+}
+
+void ring_close(ring *r) {
+    atomic_store_explicit(&r->closed, 1, memory_order_release);
+    return;
+}
+
+int ring_is_closed(ring *r) {
+    return atomic_load_explicit(&r->closed, memory_order_acquire);
+}
+
+void *ring_try_write(ring *r) {
+    return ring_try_write_at(r, 0);
+}
+
+void *ring_try_write_at(ring *r, u_int i) {
+    u_int head = atomic_load_explicit(&r->head, memory_order_relaxed) + i;
+    u_int tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (head - tail >= r->size) return NULL;
+    return r->slots + (size_t)(head & (r->size - 1)) * r->slot_size;
+}
+
+void *ring_write(ring *r) {
+    void *slot;
+    u_int spins = 0;
+    while ((slot = ring_try_write(r)) == NULL) {
+        if (ring_is_closed(r)) return NULL;
+        ring_backoff(&spins);
+    }
+    return slot;
+}
+
+void ring_commit(ring *r) {
+    u_int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return;
+}
+
+void *ring_try_read(ring *r) {
+    u_int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    u_int head = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (head == tail) return NULL;
+    return r->slots + (size_t)(tail & (r->size - 1)) * r->slot_size;
+}
+
+void *ring_read(ring *r) {
+    void *slot;
+    u_int spins = 0;
+    while ((slot = ring_try_read(r)) == NULL) {
+        // check closed first, then look once more so nothing committed before the close is lost
+        if (ring_is_closed(r)) return ring_try_read(r);
+        ring_backoff(&spins);
+    }
+    return slot;
+}
+
+void ring_release(ring *r) {
+    u_int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file ring.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief lock-free single-producer/single-consumer ring buffer
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "packet.h"
+
+#define CACHE_LINE_SIZE 64
+
+/*
+ * ring Design:
+ *
+ * A fixed number of fixed size slots, where the number of slots is a power of 2.
+ * Exactly one thread produces into the ring and exactly one thread consumes from it.
+ *
+ *  - head is only ever written by the producer (next slot to fill)
+ *  - tail is only ever written by the consumer (next slot to drain)
+ *
+ * Both counters run freely and are masked when indexing, so the ring is full when
+ * head - tail == size, and empty when head == tail. They live on their own cache
+ * lines so the two threads don't fight over the same line.
+ */
+
+typedef struct ring {
+    _Alignas(CACHE_LINE_SIZE) _Atomic u_int head;
+    _Alignas(CACHE_LINE_SIZE) _Atomic u_int tail;
+    _Alignas(CACHE_LINE_SIZE) _Atomic int closed;
+    u_int size;
+    size_t slot_size;
+    u_char *slots;
+} ring;
+
+/**
+ * Allocate a ring with size slots (rounded up to a power of 2) of slot_size bytes.
+ */
+int ring_init(ring *r, u_int size, size_t slot_size);
+
+/**
+ * Free the slots of a ring.
+ */
+void ring_free(ring *r);
+
+/**
+ * Marks the ring as closed, waking up anything waiting on it.
+ */
+void ring_close(ring *r);
+
+/**
+ * Returns true if the ring has been closed.
+ */
+int ring_is_closed(ring *r);
+
+/**
+ * Returns the next free slot for the producer, or NULL if the ring is full.
+ */
+void *ring_try_write(ring *r);
+
+/**
+ * Waits for the next free slot for the producer. Returns NULL if the ring is closed.
+ */
+void *ring_write(ring *r);
+
+/**
+ * Returns the free slot i places past the next one for the producer, or NULL if
+ * there aren't that many free slots. Lets the producer fill slots out of order, as
+ * long as it commits them in order.
+ */
+void *ring_try_write_at(ring *r, u_int i);
+
+/**
+ * Publishes the next slot to the consumer.
+ */
+void ring_commit(ring *r);
+
+/**
+ * Returns the next filled slot for the consumer, or NULL if the ring is empty.
+ */
+void *ring_try_read(ring *r);
+
+/**
+ * Waits for the next filled slot for the consumer. Returns NULL if the ring is
+ * closed and has been drained.
+ */
+void *ring_read(ring *r);
+
+/**
+ * Hands the slot returned by ring_read() back to the producer.
+ */
+void ring_release(ring *r);
+
+#endif
@@ -0,0 +1,770 @@
+/**
+ * @file sender.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief sending side of a transfer: disk reader stage feeding the network sender stage
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "sender.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include "log.h"
+#include "sparse.h"
+
+// finish a ring slot once its reads are done: data becomes a SEQ packet (or a hole, if it
+// is all zeros and zero_elision is on), and a failed or short read an ERR packet
+int fill_chunk(Packet *packet, long result, size_t len, u_llong offset, int zero_elision) {
+    if (result >= 0 && (size_t)result != len) {
+        print_error("File changed while being read.", __LINE__);
+    } else if (result < 0) {
+        print_error(strerror((int)-result), __LINE__);
+    } else if (zero_elision && is_zero(packet->buff, len)) {
+        set_packet_hole(packet, 0, offset, (u_llong)len);
+        return 1;
+    } else {
+        // for sequence packet:        1 is SEQ packet, seq_num is set by the sender
+        set_packet_header(packet, 1, 0, 0, 100, (u_short)len);
+        packet->header.offset = offset;
+        return 1;
+    }
+    // for error packet:           0 is ERR packet, 3 is Unknown/Unhandled Error
+    set_packet_header(packet, 0, 3, 0, 100, 0);
+    return 0;
+}
+
+// move the reader on to the next file. The current one stays open until the slot at
+// index last_slot (which holds its last read) has been committed
+void next_file(reader *rd, u_int last_slot) {
+    u_int index;
+    if (rd->file_desc != -1) {
+        index = (rd->closing_head + rd->closing_count) % MAX_OPEN_FILES;
+        rd->closing[index] = rd->file_desc;
+        rd->closing_after[index] = last_slot;
+        rd->closing_count++;
+    }
+    rd->file_index++;
+    rd->file_desc = -1;
+    rd->file_offset = 0;
+    rd->data_start = rd->data_end = 0;
+    return;
+}
+
+// point the reader at the start of the part of the range it is on, or past the last file
+// once there are no parts left (or no range, at the end of the files)
+void start_part(reader *rd) {
+    byte_range *part;
+
+    if (rd->range == NULL || rd->part >= rd->range->count) {
+        rd->file_index = rd->files->count;
+        return;
+    }
+    part = &rd->range->parts[rd->part];
+    rd->file_index = manifest_find(rd->files, part->start);
+    if (rd->file_index < rd->files->count) rd->file_offset = (off_t)(part->start - rd->files->entries[rd->file_index].offset);
+    rd->end = part->end;
+    return;
+}
+
+// close every finished file whose reads have all been committed
+void close_files(reader *rd, u_int next_commit, int all) {
+    while (rd->closing_count > 0 && (all || (int)(next_commit - rd->closing_after[rd->closing_head]) > 0)) {
+        close(rd->closing[rd->closing_head]);
+        rd->closing_head = (rd->closing_head + 1) % MAX_OPEN_FILES;
+        rd->closing_count--;
+    }
+    return;
+}
+
+// reader stage: walks the files of the manifest as one data stream, keeping up to
+// READ_DEPTH reads in flight straight into the data of future ring slots, and commits
+// the slots in order as their reads finish. A slot is filled across as many small files
+// as it takes. Holes found with SEEK_DATA/SEEK_HOLE are never read, they take one slot
+// as a hole packet. A range walks each of its parts in turn, as if the files ended at the
+// end of the last one
+void *read_file(void *arg) {
+    reader *rd = (reader *)arg;
+    manifest_entry *entry;
+    Packet *packet = NULL, *chunk;
+    disk_done done[READ_DEPTH];
+    long results[READ_AHEAD];       // bytes read into each slot, or -errno
+    size_t fills[READ_AHEAD];       // bytes asked for
+    u_llong offsets[READ_AHEAD];    // data stream offset of each slot
+    u_short pending[READ_AHEAD];    // reads in flight for each slot
+    u_char holes[READ_AHEAD];
+    u_int next_issue = 0, next_commit = 0, slot = 0;
+    size_t len;
+    ssize_t got;
+    int n, i, reading = 1, building = 0, failed = 0;
+
+    while (reading && !ring_is_closed(&rd->chunks)) {
+
+        // issue one window of reads into free slots, then submit them as a single batch
+        while (!failed && rd->file_index < rd->files->count && disk_io_has_room(&rd->io)) {
+            entry = &rd->files->entries[rd->file_index];
+            if (entry->offset + (u_llong)rd->file_offset >= rd->end) {
+                // the next part starts further on, so it starts a slot of its own
+                if (building && fills[slot] > 0) next_issue++;
+                building = 0;
+                next_file(rd, next_issue);
+                rd->part++;
+                start_part(rd);
+                continue;
+            }
+            // the slot being built is looked up again every time, as commits move the ring on
+            packet = (Packet *)ring_try_write_at(&rd->chunks, next_issue - next_commit);
+            if (packet == NULL) break;
+            if (!building) {
+                slot = next_issue & (READ_AHEAD - 1);
+                offsets[slot] = entry->offset + (u_llong)rd->file_offset;
+                results[slot] = 0;
+                fills[slot] = 0;
+                pending[slot] = 0;
+                holes[slot] = 0;
+                building = 1;
+            }
+
+            if ((u_llong)rd->file_offset >= entry->size) {
+                if (rd->closing_count == MAX_OPEN_FILES) {
+                    // too many files open, send what we have so some can be closed
+                    building = 0;
+                    next_issue++;
+                    break;
+                }
+                next_file(rd, next_issue);
+                continue;
+            }
+
+            if (rd->file_desc == -1 && (rd->file_desc = entry->size == STREAM_SIZE ? dup(STDIN_FILENO) : open(entry->path, O_RDONLY)) == -1) {
+                results[slot] = -errno;
+                failed = 1;
+                break;
+            }
+
+            if (entry->size == STREAM_SIZE) {
+                // a pipe can't be read at an offset, so it is read in order right here, and each
+                // slot goes out as soon as it is full so a slow producer still trickles through
+                got = read(rd->file_desc, packet->buff + fills[slot], MAX_BUFFER_SIZE - fills[slot]);
+                if (got == -1 && errno == EINTR) continue;
+                if (got == -1) {
+                    results[slot] = -errno;
+                    failed = 1;
+                    break;
+                }
+                if (got == 0) {
+                    rd->stream_size = entry->offset + (u_llong)rd->file_offset;
+                    next_file(rd, next_issue);
+                    continue;
+                }
+                results[slot] += got;
+                fills[slot] += (size_t)got;
+                rd->file_offset += got;
+                if (fills[slot] == MAX_BUFFER_SIZE) {
+                    building = 0;
+                    next_issue++;
+                    break;
+                }
+                continue;
+            }
+
+            if (rd->file_offset >= rd->data_end) {
+                // step to the next data extent, anything before it is a hole
+                if (find_data(rd->file_desc, rd->file_offset, (off_t)entry->size, &rd->data_start, &rd->data_end) == -1) {
+                    results[slot] = -errno;
+                    failed = 1;
+                    break;
+                }
+                if (entry->offset + (u_llong)rd->data_start > rd->end) rd->data_start = (off_t)(rd->end - entry->offset);
+                if (entry->offset + (u_llong)rd->data_end > rd->end)   rd->data_end = (off_t)(rd->end - entry->offset);
+            }
+            if (rd->data_start > rd->file_offset) {
+                // a hole always gets a slot of its own, so one with data in it goes out first
+                if (fills[slot] > 0) {
+                    building = 0;
+                    next_issue++;
+                    continue;
+                }
+                set_packet_hole(packet, 0, offsets[slot], (u_llong)(rd->data_start - rd->file_offset));
+                holes[slot] = 1;
+                rd->file_offset = rd->data_start;
+                building = 0;
+                next_issue++;
+                continue;
+            }
+
+            len = MAX_BUFFER_SIZE - fills[slot];
+            if ((off_t)len > rd->data_end - rd->file_offset) len = (size_t)(rd->data_end - rd->file_offset);
+            disk_io_read(&rd->io, rd->file_desc, packet->buff + fills[slot], len, rd->file_offset, (void *)(unsigned long)slot);
+            pending[slot]++;
+            fills[slot] += len;
+            rd->file_offset += (off_t)len;
+
+            if (fills[slot] == MAX_BUFFER_SIZE) {
+                building = 0;
+                next_issue++;
+            }
+        }
+        // every file is issued (or one failed), so the last slot goes out as it is
+        if (building && (failed || rd->file_index >= rd->files->count)) {
+            building = 0;
+            next_issue++;
+        }
+        if (disk_io_submit(&rd->io) == -1) {
+            print_error(strerror(errno), __LINE__);
+            break;
+        }
+
+        if (next_issue == next_commit && !building) {
+            // nothing in flight: either the whole stream is committed, or the ring is full
+            if ((packet = (Packet *)ring_write(&rd->chunks)) == NULL) break;
+            if (rd->file_index < rd->files->count) continue;
+            // for finale packet:          3 is FIN packet, offset is the size of the stream
+            set_packet_header(packet, 3, 0, 0, 100, 0);
+            packet->header.offset = rd->stream_size;
+            ring_commit(&rd->chunks);
+            break;
+        }
+
+        n = disk_io_complete(&rd->io, done, READ_DEPTH, 1);
+        if (n == -1) {
+            print_error(strerror(errno), __LINE__);
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            slot = (u_int)(unsigned long)done[i].tag;
+            if (done[i].result < 0)       results[slot] = done[i].result;
+            else if (results[slot] >= 0)  results[slot] += done[i].result;
+            pending[slot]--;
+        }
+
+        // commit every finished slot at the front of the window
+        while (reading && next_commit != next_issue && pending[next_commit & (READ_AHEAD - 1)] == 0) {
+            slot = next_commit & (READ_AHEAD - 1);
+            chunk = (Packet *)ring_try_write(&rd->chunks);
+            if (!holes[slot]) reading = fill_chunk(chunk, results[slot], fills[slot], offsets[slot], rd->zero_elision);
+            ring_commit(&rd->chunks);
+            next_commit++;
+        }
+        close_files(rd, next_commit, 0);
+    }
+
+    // the buffers belong to the ring, so every read has to land before we leave
+    while (disk_io_pending(&rd->io) > 0) {
+        if (disk_io_complete(&rd->io, done, READ_DEPTH, 1) == -1) break;
+    }
+    close_files(rd, next_commit, 1);
+    if (rd->file_desc != -1) close(rd->file_desc);
+    return NULL;
+}
+
+int start_reader(reader *rd, manifest *files, int zero_elision, stream_range *range) {
+    int rv, i;
+
+    memset(rd, 0, sizeof(*rd));
+    rd->files = files;
+    rd->file_desc = -1;
+    rd->zero_elision = zero_elision;
+    rd->end = files->total_size;
+    rd->stream_size = files->total_size;
+    if (range != NULL) {
+        // start in the middle of the file holding the start of the first part
+        rd->range = range;
+        start_part(rd);
+        rd->stream_size = range_size(range);
+    }
+
+    if (ring_init(&rd->chunks, READ_AHEAD, sizeof(Packet)) == -1) {
+        print_error("Could not allocate read ahead ring.", __LINE__);
+        return -1;
+    }
+    if (disk_io_init(&rd->io, READ_DEPTH, disk_io_backend_from_env()) == -1) {
+        print_error("Could not set up disk I/O.", __LINE__);
+        ring_free(&rd->chunks);
+        return -1;
+    }
+    rv = pthread_create(&rd->thread, NULL, read_file, rd);
+    if (rv != 0) {
+        print_error(strerror(rv), __LINE__);
+        disk_io_free(&rd->io);
+        ring_free(&rd->chunks);
+        return -1;
+    }
+    // off the core of a low latency transfer
+    unpin_thread(rd->thread);
+    for (i = 0; rd->io.backend == DISK_IO_THREADS && i < DISK_IO_POOL_SIZE; i++) unpin_thread(rd->io.pool.threads[i]);
+    return 0;
+}
+
+void stop_reader(reader *rd) {
+    ring_close(&rd->chunks);
+    pthread_join(rd->thread, NULL);
+    disk_io_free(&rd->io);
+    ring_free(&rd->chunks);
+    return;
+}
+
+// send what the receiver has to know before the data, one packet at a time, as the
+// payload type given (2 is Manifest, 3 is Chunks)
+int send_listing(connection *connect, u_char *data, long len, u_int payload, Packet *send_packet, Packet *recv_packet, u_int *seq_num) {
+    int rv = 0;
+    long pos;
+    u_short size;
+
+    for (pos = 0; pos < len; pos += size) {
+        size = (u_short)(len - pos > MAX_BUFFER_SIZE ? MAX_BUFFER_SIZE : len - pos);
+        (*seq_num)++;
+        // for listing packet:         1 is SEQ packet
+        set_packet_header(send_packet, 1, payload, *seq_num, 100, size);
+        send_packet->header.offset = (u_llong)pos;
+        memcpy(send_packet->buff, data + pos, size);
+
+        rv = send_data(connect, send_packet, __LINE__);
+        if (rv == -1) break;
+        rv = wait_for_acknowledgement(connect, send_packet, recv_packet);
+        if (rv == -1) break;
+    }
+    return rv;
+}
+
+// send the manifest ahead of the data, so the client knows where each file starts
+int send_manifest(connection *connect, manifest *files, Packet *send_packet, Packet *recv_packet, u_int *seq_num) {
+    int rv;
+    long len;
+    u_char *data;
+
+    if ((len = manifest_encode(files, &data)) == -1) {
+        print_error("Could not encode manifest.", __LINE__);
+        return -1;
+    }
+    // for manifest packet:        2 is Manifest payload
+    rv = send_listing(connect, data, len, 2, send_packet, recv_packet, seq_num);
+    free(data);
+    return rv;
+}
+
+// push back when the next new packet is due by the time size bytes take at the pacing
+// rate: a congestion window per smoothed RTT, times the gain. A bit faster than the
+// window drains, so pacing never holds a transfer back, but a window goes out spread
+// over the RTT rather than in one burst that overflows the queue at the bottleneck.
+// Nothing is paced until there is an RTT sample
+void pace_packet(send_window *w, u_short size, u_llong now) {
+    u_llong gain = w->cwnd < w->ssthresh ? PACING_SS_GAIN : PACING_CA_GAIN;
+
+    if (w->srtt == 0) return;
+    if (w->next_send < now) w->next_send = now;     // idle time is not saved up as a burst
+    w->next_send += (u_llong)size * w->srtt * 100 / (gain * w->cwnd * sizeof(Packet));
+    return;
+}
+
+// NewReno: every packet ACKed grows the congestion window by one in slow start, and by
+// one per window of packets after it. Not while recovering from a loss
+void grow_window(send_window *w, u_int acked) {
+    if (w->recovering) return;
+    while (acked-- > 0 && w->cwnd < w->limit) {
+        if (w->cwnd < w->ssthresh) {
+            w->cwnd++;
+        } else if (++w->cwnd_count >= w->cwnd) {
+            w->cwnd++;
+            w->cwnd_count = 0;
+        }
+    }
+    return;
+}
+
+// dynamic right-sizing (as Linux does for TCP receive buffers): once a round trip's worth
+// of packets is ACKed, the window is let grow to twice what the delivery rate moves in a
+// smoothed RTT, so it doubles every round trip while it is what holds the transfer back,
+// and never shrinks. The socket send buffer grows with it
+void tune_window(connection *connect, send_window *w, u_llong now) {
+    u_llong elapsed = now - w->round_start, target;
+
+    if (w->srtt > 0 && elapsed > 0) {
+        target = 2 * (u_llong)w->delivered * w->srtt / elapsed;
+        if (target > w->limit_cap) target = w->limit_cap;
+        if (target > w->limit) {
+            w->limit = (u_int)target;
+            tune_buffer(connect, SO_SNDBUF, (u_llong)w->limit * sizeof(Packet));
+        }
+    }
+    w->round_start = now;
+    w->round_end = w->next;
+    w->delivered = 0;
+    return;
+}
+
+// RFC 6298: the retransmission timeout is the smoothed RTT plus four times its mean deviation
+void sample_rtt(connection *connect, send_window *w, u_llong rtt) {
+    stats_add_rtt(&connect->stats, rtt);
+    if (w->srtt == 0) {
+        w->srtt = rtt;
+        w->rttvar = rtt / 2;
+    } else {
+        w->rttvar = (3 * w->rttvar + (w->srtt > rtt ? w->srtt - rtt : rtt - w->srtt)) / 4;
+        w->srtt = (7 * w->srtt + rtt) / 8;
+    }
+    w->rto = w->srtt + 4 * w->rttvar;
+    if (w->rto < RTO_MIN_NS) w->rto = RTO_MIN_NS;
+    if (w->rto > RTO_MAX_NS) w->rto = RTO_MAX_NS;
+    return;
+}
+
+// a loss halves the congestion window, and a timeout starts over from one packet
+void shrink_window(send_window *w, int timeout) {
+    w->ssthresh = (w->next - w->base) / 2;
+    if (w->ssthresh < 2) w->ssthresh = 2;
+    w->cwnd = timeout ? 1 : w->ssthresh;
+    w->cwnd_count = 0;
+    return;
+}
+
+// copy the next packet of the ring into the window (merging the run of holes already
+// waiting into one packet), and send it
+int send_next_packet(connection *connect, send_window *w, ring *chunks, Packet *packet) {
+    u_int slot = w->next % WINDOW_SIZE;
+    u_llong offset, length;
+
+    if (is_packet_hole(packet)) {
+        offset = packet->header.offset;
+        length = get_packet_hole(packet);
+        ring_release(chunks);
+        while ((packet = (Packet *)ring_try_read(chunks)) != NULL &&
+               is_packet_hole(packet) && packet->header.offset == offset + length) {
+            length += get_packet_hole(packet);
+            ring_release(chunks);
+        }
+        set_packet_hole(&w->packets[slot], w->next, offset, length);
+    } else {
+        memcpy(&w->packets[slot], packet, get_packet_size(packet));
+        w->packets[slot].header.seq_num = w->next;
+        length = packet->header.data_size;
+        ring_release(chunks);
+    }
+    w->sent_bytes += length;
+    w->packets[slot].header.percent = (u_char)stats_percent(w->sent_bytes, w->size);
+    w->resent[slot] = 0;
+    w->sacked[slot] = 0;
+    w->sent[slot] = stats_now();
+    w->next++;
+    if (!timer_is_set(&w->retransmit)) timer_set(&w->retransmit, w->sent[slot] + w->rto);
+    pace_packet(w, get_packet_size(&w->packets[slot]), w->sent[slot]);
+    rate_take(&w->rate, get_packet_size(&w->packets[slot]));
+    return send_data(connect, &w->packets[slot], __LINE__);
+}
+
+// resend a packet in flight
+int resend_packet(connection *connect, send_window *w, u_int seq_num) {
+    w->resent[seq_num % WINDOW_SIZE] = 1;
+    w->resent_next[seq_num % WINDOW_SIZE] = w->next;
+    w->sent[seq_num % WINDOW_SIZE] = stats_now();
+    rate_take(&w->rate, get_packet_size(&w->packets[seq_num % WINDOW_SIZE]));
+    STATS_ADD(connect->stats.retransmits, 1);
+    return send_data(connect, &w->packets[seq_num % WINDOW_SIZE], __LINE__);
+}
+
+// the retransmission timer went off: resend the oldest packet, from a window of one, and
+// wait twice as long for it. A resend still in flight is taken for lost too, so once the
+// oldest is ACKed the scoreboard resends every packet it shows missing again, not just the
+// next one a timeout later (RFC 6675 5.1). Returns -1 after MAX_RETRIES in a row
+int retransmit_timeout(connection *connect, send_window *w) {
+    u_int seq;
+
+    STATS_ADD(connect->stats.timeouts, 1);
+    log_event(LOG_DEBUG, LOG_EVENT_TIMEOUT, connect->is_server);
+    if (++w->timeouts > MAX_RETRIES) {
+        print_error("Connection Closed.", __LINE__);
+        return -1;
+    }
+    if (w->timeouts == 1) shrink_window(w, 1);
+    for (seq = w->base; seq != w->next; seq++) w->resent[seq % WINDOW_SIZE] = 0;
+    w->recovering = 1;
+    w->recover = w->next;
+    w->rto = w->rto * 2 > RTO_MAX_NS ? RTO_MAX_NS : w->rto * 2;
+    timer_set(&w->retransmit, stats_now() + w->rto);
+    return resend_packet(connect, w, w->base);
+}
+
+// packets sent that are neither ACKed nor held by the receiver (RFC 6675's pipe)
+u_int in_flight(send_window *w) {
+    return w->next - w->base - w->held;
+}
+
+// with too few packets sent for the reordering threshold of them to come back past a lost
+// one, every one but it has to (RFC 5827)
+u_int loss_threshold(send_window *w) {
+    u_int sent = w->next - w->base;
+
+    if (sent > w->reordering) return w->reordering;
+    return sent > 1 ? sent - 1 : 1;
+}
+
+// a resent packet ACKed or held sooner than half an RTT after the resend was only late, and
+// the resend not needed: raise the threshold, so packets reordered that far aren't taken
+// for lost again (as Linux does)
+void check_reordering(send_window *w, u_int seq_num, u_llong now) {
+    if (!w->resent[seq_num % WINDOW_SIZE] || now - w->sent[seq_num % WINDOW_SIZE] >= w->srtt / 2) return;
+    if (w->reordering < REORDERING_MAX) w->reordering++;
+    return;
+}
+
+// take in one packet from the receiver: slide the window past what an ACK covers, and mark
+// the packets past it that the receiver holds. Nothing is sent here, what was lost is only
+// resent once the whole batch is in. Returns -1 if the receiver gave up
+int handle_ack(connection *connect, send_window *w, Packet *packet) {
+    u_int ack_num = packet->header.seq_num, seq, i;
+    u_llong now = stats_now();
+    Packet *acked;
+
+    log_packet(LOG_EVENT_RECV, packet, connect->is_server);
+    if (is_packet_error(packet)) {     // if the other side gave up
+        print_error_msg(packet, __LINE__);
+        send_acknowledgement(connect, packet, ack_num);
+        return -1;
+    }
+    if (!is_packet_acknowledgement(packet)) return 0;
+    // the receive buffer only grows, so an ACK out of order never takes room back
+    if (get_packet_window(packet) > w->window) w->window = get_packet_window(packet);
+
+    if (ack_num - w->base < w->next - w->base) {    // ACKs base up to ack_num
+        // an ACK held back by a gap is no RTT sample either
+        if (!w->recovering && !w->resent[ack_num % WINDOW_SIZE]) sample_rtt(connect, w, now - w->sent[ack_num % WINDOW_SIZE]);
+        grow_window(w, ack_num + 1 - w->base);
+        w->delivered += ack_num + 1 - w->base;
+        while (w->base != ack_num + 1) {
+            if (w->sacked[w->base % WINDOW_SIZE]) w->held--;
+            else                                  check_reordering(w, w->base, now);
+            acked = &w->packets[w->base++ % WINDOW_SIZE];
+            if (!is_packet_hole(acked)) STATS_ADD(connect->stats.payload_bytes, acked->header.data_size);
+            STATS_ADD(connect->stats.progress_bytes, is_packet_hole(acked) ? get_packet_hole(acked) : acked->header.data_size);
+        }
+        STATS_SET(connect->stats.peer_percent, packet->header.percent);
+        w->dup_acks = 0;
+        w->timeouts = 0;
+        if (w->next != w->base) timer_set(&w->retransmit, now + w->rto);
+        else                    timer_unset(&w->retransmit);
+        if (w->recovering && (int)(w->recover - w->base) <= 0) w->recovering = 0;
+        if ((int)(w->base - w->round_end) > 0) tune_window(connect, w, now);
+    } else {
+        // a late ACK, or the receiver is missing base and ACKs the packet before it for
+        // every packet that comes in past it
+        STATS_ADD(connect->stats.duplicate_acks, 1);
+        if (ack_num == w->base - 1) w->dup_acks++;
+    }
+
+    // the receiver only lets go of a packet it holds once it lands, so a SACK is never taken back
+    for (i = 1; i < get_packet_sack_size(packet) && i < WINDOW_SIZE; i++) {
+        seq = ack_num + 1 + i;
+        if (!is_packet_sacked(packet, i) || seq - w->base >= w->next - w->base || w->sacked[seq % WINDOW_SIZE]) continue;
+        w->sacked[seq % WINDOW_SIZE] = 1;
+        w->held++;
+        check_reordering(w, seq, now);
+    }
+    return 0;
+}
+
+// how many packets from seq_num on the receiver holds
+u_int count_held(send_window *w, u_int seq_num) {
+    u_int held = 0;
+
+    for (; seq_num != w->next; seq_num++) held += w->sacked[seq_num % WINDOW_SIZE];
+    return held;
+}
+
+// resend what the scoreboard shows was lost: every packet the receiver doesn't hold with
+// loss_threshold() packets past it that it does (RFC 6675), and the oldest one on that many
+// ACKs in a row for the packet before it. Until every packet sent before the loss is ACKed,
+// an ACK that covers only part of them means the oldest one was lost too. A packet already
+// resent is only lost again once that many packets sent after it are held.
+// The first loss halves the congestion window
+int repair_window(connection *connect, send_window *w, int slid) {
+    u_int k, seq, held = 0, threshold = loss_threshold(w);
+    int lost;
+
+    for (k = w->next - w->base; k-- > 0;) {     // newest first, counting what is held past each
+        seq = w->base + k;
+        if (w->sacked[seq % WINDOW_SIZE]) {
+            held++;
+            continue;
+        }
+        if (w->resent[seq % WINDOW_SIZE]) lost = count_held(w, w->resent_next[seq % WINDOW_SIZE]) >= threshold;
+        else lost = held >= threshold || (k == 0 && (w->dup_acks >= threshold || (slid && w->recovering)));
+        if (!lost) continue;
+        if (!w->recovering) {
+            shrink_window(w, 0);
+            w->recovering = 1;
+            w->recover = w->next;
+        }
+        if (resend_packet(connect, w, seq) == -1) return -1;
+    }
+    return 0;
+}
+
+// wait until ACKs let more packets go in flight, or until (if it isn't 0) when the next
+// packet is due. Every ACK waiting is taken in as one batch, then what they show was lost is
+// resent. Every time the retransmission timer goes off, the oldest packet is resent
+int wait_for_window(connection *connect, send_window *w, u_llong until) {
+    int ready, count, i;
+    u_int base, flight;
+
+    while (1) {
+        if ((ready = wait_for_timer(connect, w->retransmit.notify_desc, until)) <= 0) return ready;
+
+        // unless an ACK restarted it since it went off
+        if ((ready & WAIT_TIMER) && timer_take(&w->retransmit) && retransmit_timeout(connect, w) == -1) return -1;
+        if (!(ready & WAIT_PACKET)) continue;
+
+        base = w->base;
+        flight = in_flight(w);
+        do {
+            if ((count = recv_batch(connect, w->acks, RECV_BATCH)) == -1) return -1;
+            for (i = 0; i < count; i++) {
+                if (handle_ack(connect, w, &w->acks[i]) == -1) return -1;
+            }
+        } while (count == RECV_BATCH);
+        if (repair_window(connect, w, w->base != base) == -1) return -1;
+        if (in_flight(w) < flight) return 0;
+    }
+}
+
+// start from what the last transfer of the session learned of the path. Its cwnd is only
+// good if the path hasn't been idle for longer than an RTO since (RFC 5681 restart window)
+void warm_window(connection *connect, send_window *w) {
+    path_state *path = &connect->path;
+
+    w->srtt = path->srtt;
+    w->rttvar = path->rttvar;
+    w->rto = path->rto;
+    w->ssthresh = path->ssthresh;
+    w->reordering = path->reordering;
+    if (path->limit > w->limit) w->limit = path->limit < w->limit_cap ? path->limit : w->limit_cap;
+    if (stats_now() - path->ended <= path->rto && path->cwnd > w->cwnd) w->cwnd = path->cwnd < w->limit ? path->cwnd : w->limit;
+    return;
+}
+
+// leave what this transfer learned of the path for the next one of the session
+void keep_window(connection *connect, send_window *w) {
+    path_state *path = &connect->path;
+
+    path->srtt = w->srtt;
+    path->rttvar = w->rttvar;
+    // a backed off RTO is put back to the one the RTT gives
+    path->rto = w->srtt + 4 * w->rttvar;
+    if (path->rto < RTO_MIN_NS) path->rto = RTO_MIN_NS;
+    if (path->rto > RTO_MAX_NS) path->rto = RTO_MAX_NS;
+    path->cwnd = w->cwnd;
+    path->ssthresh = w->ssthresh;
+    path->limit = w->limit;
+    path->reordering = w->reordering;
+    path->ended = stats_now();
+    return;
+}
+
+int send_files(connection *connect, manifest *files, Packet *send_packet, Packet *recv_packet, u_int seq_num, int zero_elision, stream_range *range) {
+    int rv = 0, done = 0, paced;
+    reader rd;
+    send_window *w;
+    Packet *packet = NULL;
+    u_llong stream_size, now = 0, due, reserve = 0, size = files->total_size;
+
+    if (files->total_size == STREAM_SIZE) fprintf(print_stream(), "\nsending a stream");
+    else if (range == NULL)               fprintf(print_stream(), "\nsending %u files, %llu bytes", files->count, files->total_size);
+    else if (range->count == 1)           fprintf(print_stream(), "\nsending bytes %llu to %llu of %u files", range->parts[0].start, range->parts[0].end, files->count);
+    else                                  fprintf(print_stream(), "\nsending %llu bytes in %u parts of %u files", range_size(range), range->count, files->count);
+    if (range != NULL) size = range_size(range);
+    STATS_ADD(connect->stats.transfers, 1);
+    stats_begin_progress(&connect->stats, size == STREAM_SIZE ? 0 : size);
+
+    if ((w = calloc(1, sizeof(send_window))) == NULL) {
+        print_error("Could not allocate send window.", __LINE__);   // 3 is Unknown/Unhandled Error
+        return send_error_packet(connect, send_packet, recv_packet, 3);
+    }
+    if (timer_open(&w->retransmit) == -1) {                         // 3 is Unknown/Unhandled Error
+        free(w);
+        return send_error_packet(connect, send_packet, recv_packet, 3);
+    }
+    // the wheel's thread shouldn't wait on a core this one spins on
+    unpin_thread(timer_thread());
+    if (start_reader(&rd, files, zero_elision, range) == -1) {             // 3 is Unknown/Unhandled Error
+        timer_close(&w->retransmit);
+        free(w);
+        return send_error_packet(connect, send_packet, recv_packet, 3);
+    }
+    connect->stats.disk_io = disk_io_backend_name(&rd.io);
+
+    // the reader is already prefetching data while the manifest goes out
+    rv = send_manifest(connect, files, send_packet, recv_packet, &seq_num);
+    // for chunk list packet:      3 is Chunks payload
+    if (rv != -1 && range != NULL && range->chunks) rv = send_listing(connect, range->chunk_data, (long)range->chunk_len, 3, send_packet, recv_packet, &seq_num);
+    w->base = w->next = seq_num + 1;
+    // the ACK of the listing says how much the receiver has room for before any data goes
+    w->window = rv != -1 && get_packet_window(recv_packet) > 0 ? get_packet_window(recv_packet) : WINDOW_START;
+    w->size = size == STREAM_SIZE ? 0 : size;
+    w->limit_cap = (u_int)((connect->buffer_cap ? connect->buffer_cap : BUFFER_CAP) / sizeof(Packet));
+    if (w->limit_cap > WINDOW_SIZE) w->limit_cap = WINDOW_SIZE;
+    if (w->limit_cap < 2) w->limit_cap = 2;
+    w->limit = WINDOW_START < w->limit_cap ? WINDOW_START : w->limit_cap;
+    w->round_end = w->base;
+    w->round_start = stats_now();
+    w->cwnd = INITIAL_WINDOW < w->limit ? INITIAL_WINDOW : w->limit;
+    w->ssthresh = WINDOW_SIZE;
+    w->reordering = DUP_ACK_THRESHOLD;
+    w->rto = RTO_INITIAL_NS;
+    if (connect->path.rto != 0) warm_window(connect, w);
+    // a deadline reserves the rate that sends everything by then
+    if (connect->deadline > 0 && size != STREAM_SIZE) reserve = size * 1000 / connect->deadline;
+    rate_join(&w->rate, connect->limiter, &connect->remote_addr, connect->weight, connect->priority, reserve);
+
+    // sender stage: drain the ring into the window, the reader keeps filling it while we wait on ACKs
+    while (rv != -1) {
+        paced = 0;
+        while (!done && in_flight(w) < w->cwnd && w->next - w->base < w->limit && w->next - w->base < w->window) {
+            // hold it back until both the pacing and the rate limit let it go
+            now = stats_now();
+            if ((due = rate_due(&w->rate, now)) > w->next_send) w->next_send = due;
+            if (now + PACING_SLACK_NS < w->next_send) {
+                paced = 1;
+                break;
+            }
+            // only block on the reader with nothing in flight, or ACKs would wait on the disk
+            if (w->next == w->base) packet = (Packet *)ring_read(&rd.chunks);
+            else if ((packet = (Packet *)ring_try_read(&rd.chunks)) == NULL) break;
+
+            if (packet == NULL || !is_packet_sequence(packet)) {
+                done = 1;
+                break;
+            }
+            if ((rv = send_next_packet(connect, w, &rd.chunks, packet)) == -1) break;
+        }
+        if (rv == -1 || (done && w->next == w->base)) break;
+
+        // until the next packet is due, only wait on ACKs
+        stats_set_window(&connect->stats, w->next - w->base);
+        rv = wait_for_window(connect, w, paced ? w->next_send : 0);
+    }
+    stats_set_window(&connect->stats, 0);
+    rate_leave(&w->rate);
+    if (rv != -1 && w->srtt != 0) keep_window(connect, w);
+    seq_num = w->next - 1;
+    timer_close(&w->retransmit);
+    free(w);
+
+    if (rv == -1) {
+        stop_reader(&rd);
+        return rv;
+    }
+    if (packet == NULL || is_packet_error(packet)) {
+        stop_reader(&rd);
+        print_error("Could not read file.", __LINE__);              // 3 is Unknown/Unhandled Error
+        return send_error_packet(connect, send_packet, recv_packet, 3);
+    }
+    stream_size = packet->header.offset;
+    STATS_ADD(connect->stats.stream_bytes, stream_size);
+    ring_release(&rd.chunks);
+    stop_reader(&rd);
+
+    memset(send_packet->buff, 0, MAX_BUFFER_SIZE);
+    rv = send_finale_packet(connect, send_packet, recv_packet, seq_num, stream_size);
+    if (rv == -1) return rv;
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+/**
+ * @file sender.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief sending side of a transfer: disk reader stage feeding the network sender stage
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef SENDER_H
+#define SENDER_H
+
+#include <pthread.h>
+
+#include "connection.h"
+#include "diskio.h"
+#include "manifest.h"
+#include "packet.h"
+#include "ring.h"
+#include "timer.h"
+
+#define READ_AHEAD 256  // packets the reader stage may prefetch ahead of the sender (power of 2)
+#define READ_DEPTH 32   // reads the reader stage keeps in flight, submitted as one batch
+#define MAX_OPEN_FILES 256  // finished files the reader may keep open for reads in flight
+#define DUP_ACK_THRESHOLD 3 // packets held past one, or repeated ACKs before it, that first mean it was lost
+#define REORDERING_MAX 16   // the most that threshold is raised to as resends turn out not to be needed
+#define INITIAL_WINDOW 10   // congestion window a transfer starts with (RFC 6928)
+#define PACING_SS_GAIN 200  // percent of the congestion window per smoothed RTT that packets are
+#define PACING_CA_GAIN 120  // paced at, in slow start and in congestion avoidance (as Linux does)
+#define PACING_SLACK_NS 50000   // how early a packet may go out, so sleeps aren't shorter than the timer slack
+#define RTO_INITIAL_NS 1000000000ULL    // retransmission timeout until the first RTT sample (RFC 6298)
+#define RTO_MIN_NS 200000000ULL         // never shorter, so a delayed ACK isn't taken for a loss (as Linux does)
+#define RTO_MAX_NS 2000000000ULL        // never longer than the timeout a receiver waits for a packet
+
+// disk reader stage feeding the network sender stage through a lock-free ring
+typedef struct reader {
+    manifest *files;
+    u_int file_index;           // file being read
+    int file_desc;              // of file_index, or -1 if not open yet
+    off_t file_offset;          // next offset to read in it
+    off_t data_start, data_end; // data extent the reader is in, from SEEK_DATA/SEEK_HOLE
+    int zero_elision;           // also send all zero chunks as holes
+    stream_range *range;        // the parts of the data stream to read, or NULL for all of it
+    u_int part;                 // of the range, being read
+    u_llong end;                // data stream offset reading stops at, the end of the part
+    u_llong stream_size;        // size of the data stream (or range), known once a stream from stdin ends
+
+    // files already read past, closed once the slot holding their last read commits
+    int closing[MAX_OPEN_FILES];
+    u_int closing_after[MAX_OPEN_FILES];
+    u_int closing_head, closing_count;
+
+    ring chunks;
+    disk_io io;
+    pthread_t thread;
+} reader;
+
+// data packets sent and not ACKed yet, each in slot seq_num % WINDOW_SIZE. ACKs are
+// cumulative, so one ACK slides the window past every packet up to it, and carry which
+// packets past it the receiver holds, which makes the window a scoreboard of what was lost
+typedef struct send_window {
+    Packet packets[WINDOW_SIZE];
+    u_llong sent[WINDOW_SIZE];      // when each was last sent, for RTT samples and to tell if a resend was needed
+    int resent[WINDOW_SIZE];        // sent more than once, so its ACK is no RTT sample
+    u_int resent_next[WINDOW_SIZE]; // next when it was last resent, only packets from it on tell if that was lost too
+    int sacked[WINDOW_SIZE];        // held by the receiver past a gap, so not lost
+    Packet acks[RECV_BATCH];        // the batch of ACKs being taken in
+    u_int base;                     // oldest packet not ACKed
+    u_int next;                     // next packet to send
+    u_int held;                     // packets from base to next the receiver holds, so no longer in flight
+    u_int dup_acks;                 // ACKs in a row for the packet before base
+    u_int reordering;               // packets held past one that mean it was lost, from DUP_ACK_THRESHOLD up
+    int recovering;                 // resending lost packets, until every packet up to recover is ACKed
+    u_int recover;                  // next when the loss was found
+    u_int cwnd;                     // congestion window: packets allowed in flight, up to limit sent
+    u_int limit;                    // packets sent and not ACKed at most, autotuned from WINDOW_START up
+    u_int window;                   // packets the receiver's socket buffer has room for, from its ACKs
+    u_int limit_cap;                // of the connection's buffer cap, at most WINDOW_SIZE
+    u_int round_end;                // a delivery rate sample is taken once this packet is ACKed
+    u_llong round_start;            // when the sample started
+    u_int delivered;                // packets ACKed since then
+    u_llong size;                   // of the data to send, 0 for a stream
+    u_llong sent_bytes;             // of it sent so far, stamped on each packet as a percent
+    u_int ssthresh;                 // slow start until cwnd reaches it
+    u_int cwnd_count;               // packets ACKed toward the next cwnd increase in congestion avoidance
+    u_llong srtt;                   // smoothed RTT in nanoseconds, 0 until the first sample
+    u_llong rttvar;                 // its mean deviation
+    u_llong rto;                    // retransmission timeout, doubled on every timeout in a row
+    u_int timeouts;                 // in a row, without the window sliding
+    timer retransmit;               // on the shared wheel, set while packets are in flight, restarted as they are ACKed
+    u_llong next_send;              // when the next new packet is due, to pace them over the RTT
+    rate_share rate;                // of the connection's rate limiter
+} send_window;
+
+/**
+ * Starts the reader thread on the files of the manifest, or on only the parts of their
+ * data stream in range, if it isn't NULL.
+ */
+int start_reader(reader *rd, manifest *files, int zero_elision, stream_range *range);
+
+/**
+ * Stops the reader thread and frees the ring.
+ */
+void stop_reader(reader *rd);
+
+/**
+ * Sends the manifest, then every file in it as one data stream, then a FIN. The first
+ * packet sent is seq_num+1. The manifest goes one packet at a time, the data stream a
+ * congestion window at a time, paced evenly over the RTT, and no faster than the
+ * connection's share of its rate limiter. The window (and the socket send buffer) are
+ * autotuned to twice the packets delivered in an RTT, up to the connection's buffer cap,
+ * and no more are in flight than the receiver's ACKs say its socket buffer has room for.
+ * The RTT, RTO, window and its limit start from where the last transfer of the session
+ * left them (the window only if it ended less than an RTO ago). The oldest packet is resent a retransmission
+ * timeout (worked out from the RTT) after the window last slid. A file that can't be
+ * read ends the transfer with an ERR. If range isn't NULL, only its parts of the data
+ * stream are sent, and the FIN carries their size. If it asks for the chunk list, that
+ * goes out after the manifest, the same way.
+ */
+int send_files(connection *connect, manifest *files, Packet *send_packet, Packet *recv_packet, u_int seq_num, int zero_elision, stream_range *range);
+
+/**
+ * Takes in one packet from the receiver: slides the window past what an ACK covers, and
+ * marks the packets past it that the receiver holds. Sends nothing.
+ * Returns -1 if the receiver gave up.
+ */
+int handle_ack(connection *connect, send_window *w, Packet *packet);
+
+/**
+ * Resends every packet the window's scoreboard shows was lost (RFC 6675). slid is true if
+ * the ACKs just taken in slid the window. Returns -1 if a resend couldn't be sent.
+ */
+int repair_window(connection *connect, send_window *w, int slid);
+
+/**
+ * The retransmission timer went off: resends the oldest packet, and takes every resend
+ * still in flight for lost. Returns -1 after MAX_RETRIES in a row.
+ */
+int retransmit_timeout(connection *connect, send_window *w);
+
+#endif
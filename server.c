@@ -6,272 +6,128 @@
  * @date 2022-03-14
  */
 
-#include "packet.h"
+#include <poll.h>
+#include <stdlib.h>
 
-#define IS_SERVER 1
+#include "log.h"
+#include "packet.h"
+#include "rft.h"
 
 /*
  * This Program makes reliable file transfers using a protocol that I designed.
  * It may not be perfect, but I plan on testing it and optimizing it.
- * 
+ *
  * This program creates a packet that is ready to be sent over a network with a
  * specific header and values.
  */
 
-typedef struct connection {
-    struct sockaddr_storage *remote_addr;
-    socklen_t addr_len;
-    int socket_desc;
-} connection;
-
-int send_data(connection *connect, Packet *packet, int line) {
-    int rv = (int)sendto(connect->socket_desc, packet, get_packet_size(packet), 0, (struct sockaddr *)connect->remote_addr, connect->addr_len);
-    if (rv == -1) print_error(strerror(errno), line);
-    else                    print_packet(packet, 1, IS_SERVER);
-    return rv;
-}
-
-int recv_data(connection *connect, Packet *packet) {
-    return (int)recvfrom(connect->socket_desc, packet, sizeof(Packet), 0, (struct sockaddr *)connect->remote_addr, &connect->addr_len);
-}
-
-int send_acknowledgement(connection *connect, Packet *ack_packet, u_int ack_num) {
-    // for acknowledgement:       2 is ACK packet
-    set_packet_header(ack_packet, 2, 0, ack_num, 100, sizeof(packet_header));
-    return send_data(connect, ack_packet, __LINE__);
-}
-
-int wait_for_acknowledgement(connection *connect, Packet *send_packet, Packet *recv_packet, int i) {
-    int rv;
-    u_int seq_num, ack_num;
-    seq_num = send_packet->header.seq_num;
-
-    if (i < MAX_RETRIES) {  // if tried less than 8 times, wait to receive data
-
-        rv = recv_data(connect, recv_packet);
-        if (rv == -1) {   // if havent received data
-
-            rv = send_data(connect, send_packet, __LINE__); // resend data
-            if (rv == -1) return rv;
-
-            i = wait_for_acknowledgement(connect, send_packet, recv_packet, i+1);   // wait yet again
-            if (i == -1) return i;
-
-        } else {    // else have received data
-
-            print_packet(recv_packet, 0, IS_SERVER);
-            ack_num = recv_packet->header.seq_num;
-            if (!is_packet_acknowledgement(recv_packet) || ack_num != seq_num) {   // if not the correct response
-
-                rv = send_data(connect, send_packet, __LINE__); // resend data
-                if (rv == -1) return rv;
-
-                i = wait_for_acknowledgement(connect, send_packet, recv_packet, i+1);   // wait yet again
-                if (i == -1) return i;
-            }
-        }
-        // is correct data, return
-        return rv;
-
-    } else {    // more than maximum number of tries, return error
-        print_error("Connection Closed.", __LINE__);
-        return -1;
-    }
-}
-
-int send_finale_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int seq_num) {
-    int rv;
-    // for finale packet:          3 is FIN packet
-    set_packet_header(send_packet, 3, 0, seq_num, 100, sizeof(packet_header));
-    rv = send_data(connect, send_packet, __LINE__);
-    if (rv == -1) return rv;
-    rv = wait_for_acknowledgement(connect, send_packet, recv_packet, 1);
-    return rv;
-}
-
-// any result from this is to quit, so always return -1
-int send_error_packet(connection *connect, Packet *send_packet, Packet *recv_packet, u_int error_num) {
-    // for error packet:           0 is ERR packet
-    set_packet_header(send_packet, 0, error_num, 0, 100, sizeof(packet_header));
-    send_data(connect, send_packet, __LINE__);
-    wait_for_acknowledgement(connect, send_packet, recv_packet, 1);
-    return -1;
-}
-
-int send_file(connection *connect, Packet *send_packet, Packet *recv_packet) {
-    int rv;
-    FILE *file;
-    u_char c;
-    //long file_size;
-    u_int buffNum = 0, seq_num = send_packet->header.seq_num;
-
-    if (access((char *)recv_packet->buff, F_OK) == 0) {
-        if ((file = fopen((char *)recv_packet->buff, "rb")) == NULL) {
-            print_error(strerror(errno), __LINE__);                  // 2 is File Not Found
-            return send_error_packet(connect, send_packet, recv_packet, 2);
-        }
-/*
-        // get file size
-        fseek(file, 0, SEEK_END);
-        file_size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-*/
-
-        while (fread(&c, 1, 1, file) == 1) {
-
-            if (buffNum < MAX_BUFFER_SIZE-1) {
-                strncat((char *)send_packet->buff, (char *)&c, 1);
-                buffNum++;
-            } else {
-                strncat((char *)send_packet->buff, (char *)&c, 1);
-
-                seq_num++;
-                // for sequence packet:        1 is SEQ packet
-                set_packet_header(send_packet, 1, 0, seq_num, 100, strlen((char *)send_packet->buff));
-
-                rv = send_data(connect, send_packet, __LINE__);
-                if (rv == -1) return rv;
-
-                rv = wait_for_acknowledgement(connect, send_packet, recv_packet, 1);
-                if (rv == -1) return rv;
-
-                buffNum = 0;
-                memset(send_packet->buff, 0, MAX_BUFFER_SIZE);
-            }
-        }
-        fclose(file);
-        
-        seq_num++;
-        // for sequence packet:        1 is SEQ packet
-        set_packet_header(send_packet, 1, 0, seq_num, 100, strlen((char *)send_packet->buff));
-
-        rv = send_data(connect, send_packet, __LINE__);
-        if (rv == -1) return rv;
-
-        rv = wait_for_acknowledgement(connect, send_packet, recv_packet, 1);
-        if (rv == -1) return rv;
-
-        memset(send_packet->buff, 0, MAX_BUFFER_SIZE);
-        rv = send_finale_packet(connect, send_packet, recv_packet, seq_num);
-        if (rv == -1) return rv;
-
-    } else {
-        //file doesn't exist
-        print_error(strerror(errno), __LINE__);                  // 2 is File Not Found
-        return send_error_packet(connect, send_packet, recv_packet, 2);
-    }
-
-    return 0;
-}
-
-int handle_connection(int socket_desc, time_t *start) {
-    int rv;
-    u_int seq_num;
-
-    struct sockaddr_storage remote_addr;
-    socklen_t addr_len = sizeof(remote_addr);
-
-    connection connect;
-
-    Packet send_packet = init_packet();
-    Packet recv_packet = init_packet();
-
-    // set connection data
-    connect.remote_addr = &remote_addr;
-    connect.addr_len = addr_len;
-    connect.socket_desc = socket_desc;
-    
-    while (1) {
-        rv = recv_data(&connect, &recv_packet);
-        if (rv == -1) {
-            printf(".");
-            fflush(stdout);
-            continue;
-        } else {
-            *start = time(NULL);
-            print_packet(&recv_packet, 0, IS_SERVER);
-            break;
-        }
-    }
-
-    seq_num = recv_packet.header.seq_num;
-    rv = send_acknowledgement(&connect, &send_packet, seq_num);
-    if (rv == -1) return rv;
-
-    if (!is_packet_sequence(&recv_packet) || seq_num != 1) {
-        return send_error_packet(&connect, &send_packet, &recv_packet, 1);
-    } else {                                                        // 1 is Bad Request
-        rv = send_file(&connect, &send_packet, &recv_packet);
-        return rv;
-    }
+// what the sessions report to when they are over
+typedef struct server_state {
+    metrics_server metrics;
+    int metrics_on;
+    int failed;             // sessions that ended in an error
+} server_state;
+
+// a session is over: add it to the metrics totals, and print how it went
+void session_done(rft_transfer *transfer, int result, transfer_stats *stats, void *arg) {
+    server_state *state = (server_state *)arg;
+
+    (void)transfer;
+    if (result == -1) state->failed++;
+    if (state->metrics_on) metrics_end(&state->metrics, stats);
+    fprintf(print_stream(), "\nTime elapsed: %.3f\n", (double)(STATS_GET(stats->end) - STATS_GET(stats->start)) / 1e9);
+    stats_print_json(stats, stderr, "server");
+    return;
 }
 
 int main(int argc, char *argv[]) {
-    int rv = 0;
-    char * MY_PORT;
-
-    int socket_desc;
-    struct addrinfo hints, *servInfo, *p;
-    struct timeval tv;
-
-    time_t start, end;
+    int rv = 0, opt, zero_elision = 0, streaming = 0, cpu = -1;
+    char * MY_PORT, *metrics_path = NULL, *upload_dir = NULL;
+    double rate = 0, client_rate = 0, global_rate = 0;
+    u_llong buffer_cap = 0;
+    u_int sessions = 0, served = 0;
+    struct pollfd fds[2];
+
+    connection listener;
+    rft_context ctx;
+    rft_transfer *session;
+    server_state state;
 
     // command line arguments
-	if (argc != 2) {
-        printf("\nArguments expected: <Server Port>");
+    while ((opt = getopt(argc, argv, "b:c:d:g:m:n:r:sw:z")) != -1) {
+        if      (opt == 'b') cpu = atoi(optarg);    // low latency: busy poll, every session pinned to this core
+        else if (opt == 'c') client_rate = atof(optarg);    // cap what is sent to each client, in Mbit/s
+        else if (opt == 'd') upload_dir = optarg;   // uploads are written under here, . by default
+        else if (opt == 'g') global_rate = atof(optarg);    // cap what is sent in all, in Mbit/s
+        else if (opt == 'm') metrics_path = optarg; // serve Prometheus text on this Unix socket
+        else if (opt == 'n') sessions = (u_int)atoi(optarg);    // exit once this many sessions are over, 0 (the default) to serve forever
+        else if (opt == 'r') rate = atof(optarg);   // cap what each transfer sends, in Mbit/s
+        else if (opt == 's') streaming = 1;         // serve stdin, and write uploads to stdout (one session)
+        else if (opt == 'w') buffer_cap = (u_llong)atoll(optarg) << 10;  // most the window and socket buffers grow to, in KB
+        else if (opt == 'z') zero_elision = 1;      // send all zero chunks as holes too
+        else                 optind = argc;         // unknown option, print what is expected
+    }
+	if (argc - optind != 1) {
+        fprintf(print_stream(), "\nArguments expected: [-b <CPU>] [-c <Client Rate Mbit/s>] [-d <Upload Dir>] [-g <Global Rate Mbit/s>] [-m <Metrics Socket>] "
+               "[-n <Sessions>] [-r <Rate Mbit/s>] [-s] [-w <Window Cap KB>] [-z] <Server Port>");
         return -1;
     }
-    MY_PORT = argv[1];
-    printf("server port: %s\n", MY_PORT);
-
-    memset(&hints, 0, sizeof(hints)); // set all data in struct to 0
-    hints.ai_family = AF_INET;           // IPv4
-    hints.ai_socktype = SOCK_DGRAM;      // UDP
-    hints.ai_flags = AI_PASSIVE;         // Listen
-
-    // set timer
-    tv.tv_sec = 2;
-    tv.tv_usec = 0;
-
-    rv = getaddrinfo(NULL, MY_PORT, &hints, &servInfo);
-    if (rv != 0) {
-        print_error(strerror(errno), __LINE__);
+    // stdout may carry data, so everything printed goes to stderr
+    if (streaming) set_print_stream(stderr);
+    // stdin and stdout can only be served once
+    if (streaming) sessions = 1;
+    MY_PORT = argv[optind];
+    fprintf(print_stream(), "server port: %s\n", MY_PORT);
+
+    rv = rft_listen(&listener, MY_PORT);
+    if (rv == -1) {
         return rv;
     }
-
-    for (p = servInfo; p != NULL; p = p->ai_next) {
-        // socket(): creates a new socket, no address was assigned yet
-        socket_desc = socket(
-                p->ai_family,    // IPv4
-                p->ai_socktype,  // Streaming Protocol
-                p->ai_protocol   // UDP
-        );
-        if (socket_desc == -1) {
+    if (rft_init(&ctx) == -1) {
+        close(listener.socket_desc);
+        return -1;
+    }
+    rft_limit(&ctx, (u_llong)(rate * 1e6 / 8), (u_llong)(client_rate * 1e6 / 8), (u_llong)(global_rate * 1e6 / 8));
+    // every session starts with the listener's settings
+    listener.buffer_cap = buffer_cap;
+    listener.upload_dir = upload_dir;
+
+    // the metrics stay up for as long as the server, over every session
+    memset(&state, 0, sizeof(state));
+    if (metrics_path != NULL && metrics_start(&state.metrics, metrics_path) == 0) state.metrics_on = 1;
+
+    log_start();
+    // after the threads that don't need the core have started, so they don't inherit it.
+    // The sessions' threads do
+    if (cpu >= 0 && rft_low_latency(&listener, cpu) == -1) rv = -1;
+
+    // new sessions come in on the listener, and finished ones are reported on the context's fd
+    fds[0].fd = listener.socket_desc;
+    fds[0].events = POLLIN;
+    fds[1].fd = rft_fd(&ctx);
+    fds[1].events = POLLIN;
+    while (rv == 0 && (sessions == 0 || served < sessions || ctx.running > 0)) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
             print_error(strerror(errno), __LINE__);
-            continue;
+            rv = -1;
+            break;
         }
-        rv = bind(socket_desc, p->ai_addr, p->ai_addrlen);
-        if (rv == -1) {
-            close(socket_desc);
-            print_error(strerror(errno), __LINE__);
-            continue;
+        if (fds[1].revents & POLLIN) rft_poll(&ctx);
+        if (!(fds[0].revents & POLLIN)) continue;
+        // once the last session has started, the listener only moves running ones to their clients' new addresses
+        if (sessions != 0 && served == sessions) {
+            rft_follow(&ctx, &listener);
+        } else if ((session = rft_accept(&ctx, &listener, zero_elision, streaming, 1, session_done, &state)) != NULL) {
+            served++;
+            if (state.metrics_on) metrics_begin(&state.metrics, &session->connect.stats);
         }
-        break;
     }
-
-    rv = setsockopt(socket_desc, SOL_SOCKET, SO_RCVTIMEO, (struct timeval *)&tv, sizeof(struct timeval));
-    if (rv == -1 && p == NULL) {
-        print_error(strerror(errno), __LINE__);
-        return rv;
-    }
-
-    freeaddrinfo(servInfo);
-
-    rv = handle_connection(socket_desc, &start);
-    end = time(NULL);
-    printf("\nTime elapsed: %ld\n", end-start);
-    close(socket_desc);
+    rft_free(&ctx);
+    log_stop();
+    close(listener.socket_desc);
+    if (state.metrics_on) metrics_stop(&state.metrics);
+    if (rv == 0 && state.failed > 0) rv = -1;
 
     return rv;
 }
-
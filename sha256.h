@@ -0,0 +1,46 @@
+/**
+ * @file sha256.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief SHA-256 (FIPS 180-4), the strong hash chunks are known by
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+
+#include "packet.h"
+
+#define SHA256_SIZE 32          // bytes in a hash
+#define SHA256_BLOCK_SIZE 64    // bytes hashed at a time
+
+typedef struct sha256 {
+    u_int state[8];
+    u_llong length;                     // bytes hashed so far
+    u_char block[SHA256_BLOCK_SIZE];    // bytes waiting for a whole block
+    size_t fill;
+} sha256;
+
+/**
+ * Starts a new hash.
+ */
+void sha256_init(sha256 *h);
+
+/**
+ * Hashes len more bytes of data.
+ */
+void sha256_update(sha256 *h, const u_char *data, size_t len);
+
+/**
+ * Pads the hash and writes its SHA256_SIZE bytes into out.
+ */
+void sha256_final(sha256 *h, u_char *out);
+
+/**
+ * Hashes len bytes of data in one go.
+ */
+void sha256_hash(const u_char *data, size_t len, u_char *out);
+
+#endif
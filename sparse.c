@@ -0,0 +1,63 @@
+/**
+ * @file sparse.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief hole and zero block detection for sparse files
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#define _GNU_SOURCE     // SEEK_DATA, SEEK_HOLE
+
+#include "sparse.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+int find_data(int file_desc, off_t offset, off_t file_size, off_t *data_start, off_t *data_end) {
+    off_t start, end;
+
+    start = lseek(file_desc, offset, SEEK_DATA);
+    if (start == -1) {
+        if (errno == ENXIO) {   // nothing but a hole up to the end of the file
+            *data_start = *data_end = file_size;
+            return 0;
+        }
+        if (errno != EINVAL) return -1;
+        // no SEEK_DATA support, it's all data
+        *data_start = offset;
+        *data_end = file_size;
+        return 0;
+    }
+
+    end = lseek(file_desc, start, SEEK_HOLE);
+    if (end == -1) return -1;
+
+    *data_start = start < file_size ? start : file_size;
+    *data_end = end < file_size ? end : file_size;
+    return 0;
+}
+
+int is_zero(const u_char *buff, size_t len) {
+    size_t i = 0;
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    // or 64 bytes at a time together, and only look at the result once per block
+    for (; i + 64 <= len; i += 64) {
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(buff + i)));
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(buff + i + 16)));
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(buff + i + 32)));
+        acc = _mm_or_si128(acc, _mm_loadu_si128((const __m128i *)(buff + i + 48)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF) return 0;
+    }
+#else
+    unsigned long word;
+    for (; i + sizeof(word) <= len; i += sizeof(word)) {
+        memcpy(&word, buff + i, sizeof(word));
+        if (word != 0) return 0;
+    }
+#endif
+    for (; i < len; i++) {
+        if (buff[i] != 0) return 0;
+    }
+    return 1;
+}
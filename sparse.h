@@ -0,0 +1,28 @@
+/**
+ * @file sparse.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief hole and zero block detection for sparse files
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <sys/types.h>
+
+#include "packet.h"
+
+/**
+ * Finds the data extent at or after offset, using SEEK_DATA/SEEK_HOLE. Sets data_start
+ * and data_end; both are file_size if there's only a hole left. File systems without
+ * hole support report the whole file as one data extent.
+ */
+int find_data(int file_desc, off_t offset, off_t file_size, off_t *data_start, off_t *data_end);
+
+/**
+ * Returns true if every byte in buff is zero.
+ */
+int is_zero(const u_char *buff, size_t len);
+
+#endif
@@ -0,0 +1,340 @@
+/**
+ * @file stats.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief transfer counters, RTT histogram, JSON summary and Prometheus text export
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "stats.h"
+
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <sys/un.h>
+
+#define METRICS_POLL_MS 200     // how often the metrics thread checks if it should stop
+#define METRICS_REQUEST_MS 1000 // how long a client has to send its request
+#define METRICS_TEXT_SIZE 8192
+#define METRICS_HEADER_SIZE 256
+
+u_llong stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_llong)ts.tv_sec * 1000000000ULL + (u_llong)ts.tv_nsec;
+}
+
+void stats_init(transfer_stats *s) {
+    memset(s, 0, sizeof(*s));
+    STATS_SET(s->start, stats_now());
+    STATS_SET(s->rtt_min, ~0ULL);
+    STATS_SET(s->peer_percent, PERCENT_UNKNOWN);
+    return;
+}
+
+void stats_finish(transfer_stats *s) {
+    STATS_SET(s->end, stats_now());
+    return;
+}
+
+void stats_begin_progress(transfer_stats *s, u_llong size) {
+    STATS_SET(s->progress_bytes, 0);
+    STATS_SET(s->progress_size, size);
+    STATS_SET(s->peer_percent, PERCENT_UNKNOWN);
+    return;
+}
+
+u_int stats_percent(u_llong bytes, u_llong size) {
+    if (size == 0) return PERCENT_UNKNOWN;
+    if (bytes >= size) return 100;
+    return (u_int)((double)bytes * 100 / (double)size);
+}
+
+void stats_add_rtt(transfer_stats *s, u_llong rtt) {
+    u_llong us = rtt / 1000;
+    int bucket = 0;
+
+    while (bucket < STATS_RTT_BUCKETS - 1 && (1ULL << bucket) <= us) bucket++;
+    STATS_ADD(s->rtt_buckets[bucket], 1);
+    STATS_ADD(s->rtt_count, 1);
+    STATS_ADD(s->rtt_sum, rtt);
+    if (rtt < STATS_GET(s->rtt_min)) STATS_SET(s->rtt_min, rtt);
+    if (rtt > STATS_GET(s->rtt_max)) STATS_SET(s->rtt_max, rtt);
+    return;
+}
+
+void stats_set_window(transfer_stats *s, u_int window) {
+    u_llong now;
+    u_int i;
+
+    STATS_SET(s->window, window);
+    now = stats_now() - STATS_GET(s->start);
+    i = STATS_GET(s->window_count);
+    if (i > 0 && now - s->last_sample < STATS_SAMPLE_NS) return;
+    s->windows[i % STATS_WINDOW_SAMPLES].time = now;
+    s->windows[i % STATS_WINDOW_SAMPLES].window = window;
+    s->last_sample = now;
+    STATS_SET(s->window_count, i + 1);
+    return;
+}
+
+void stats_merge(transfer_stats *totals, transfer_stats *s) {
+    int i;
+
+    STATS_ADD(totals->bytes_sent, STATS_GET(s->bytes_sent));
+    STATS_ADD(totals->bytes_received, STATS_GET(s->bytes_received));
+    STATS_ADD(totals->packets_sent, STATS_GET(s->packets_sent));
+    STATS_ADD(totals->packets_received, STATS_GET(s->packets_received));
+    STATS_ADD(totals->payload_bytes, STATS_GET(s->payload_bytes));
+    STATS_ADD(totals->stream_bytes, STATS_GET(s->stream_bytes));
+    STATS_ADD(totals->retransmits, STATS_GET(s->retransmits));
+    STATS_ADD(totals->timeouts, STATS_GET(s->timeouts));
+    STATS_ADD(totals->duplicate_acks, STATS_GET(s->duplicate_acks));
+    STATS_ADD(totals->duplicate_packets, STATS_GET(s->duplicate_packets));
+    STATS_ADD(totals->transfers, STATS_GET(s->transfers));
+    STATS_ADD(totals->rtt_count, STATS_GET(s->rtt_count));
+    STATS_ADD(totals->rtt_sum, STATS_GET(s->rtt_sum));
+    if (STATS_GET(s->rtt_min) < STATS_GET(totals->rtt_min)) STATS_SET(totals->rtt_min, STATS_GET(s->rtt_min));
+    if (STATS_GET(s->rtt_max) > STATS_GET(totals->rtt_max)) STATS_SET(totals->rtt_max, STATS_GET(s->rtt_max));
+    for (i = 0; i < STATS_RTT_BUCKETS; i++) STATS_ADD(totals->rtt_buckets[i], STATS_GET(s->rtt_buckets[i]));
+    return;
+}
+
+void stats_print_json(transfer_stats *s, FILE *out, const char *side) {
+    u_llong end = STATS_GET(s->end) ? STATS_GET(s->end) : stats_now();
+    u_llong duration = end - STATS_GET(s->start);
+    u_llong count = STATS_GET(s->rtt_count);
+    u_int samples = STATS_GET(s->window_count), first, i;
+    double seconds = (double)duration / 1e9;
+    int printed = 0;
+
+    fprintf(out, "{\"side\":\"%s\",\"duration_s\":%.9f", side, seconds);
+    fprintf(out, ",\"bytes_sent\":%llu,\"bytes_received\":%llu", STATS_GET(s->bytes_sent), STATS_GET(s->bytes_received));
+    fprintf(out, ",\"packets_sent\":%llu,\"packets_received\":%llu", STATS_GET(s->packets_sent), STATS_GET(s->packets_received));
+    fprintf(out, ",\"payload_bytes\":%llu,\"stream_bytes\":%llu", STATS_GET(s->payload_bytes), STATS_GET(s->stream_bytes));
+    fprintf(out, ",\"goodput_bps\":%.0f", seconds > 0 ? (double)STATS_GET(s->payload_bytes) * 8 / seconds : 0.0);
+    fprintf(out, ",\"retransmits\":%llu,\"timeouts\":%llu", STATS_GET(s->retransmits), STATS_GET(s->timeouts));
+    fprintf(out, ",\"duplicate_acks\":%llu,\"duplicate_packets\":%llu", STATS_GET(s->duplicate_acks), STATS_GET(s->duplicate_packets));
+    if (s->disk_io != NULL) fprintf(out, ",\"disk_io\":\"%s\",\"direct_io\":%s", s->disk_io, s->direct_io ? "true" : "false");
+
+    fprintf(out, ",\"rtt_us\":{\"count\":%llu", count);
+    if (count > 0) {
+        fprintf(out, ",\"min\":%.3f,\"mean\":%.3f,\"max\":%.3f", (double)STATS_GET(s->rtt_min) / 1e3,
+                (double)STATS_GET(s->rtt_sum) / (double)count / 1e3, (double)STATS_GET(s->rtt_max) / 1e3);
+    }
+    fprintf(out, ",\"histogram\":[");
+    for (i = 0; i < STATS_RTT_BUCKETS; i++) {
+        if (STATS_GET(s->rtt_buckets[i]) == 0) continue;
+        fprintf(out, "%s{\"le_us\":%llu,\"count\":%llu}", printed++ ? "," : "", 1ULL << i, STATS_GET(s->rtt_buckets[i]));
+    }
+    fprintf(out, "]}");
+
+    // the oldest samples kept first: [ms since the start, packets in flight]
+    fprintf(out, ",\"window\":[");
+    first = samples > STATS_WINDOW_SAMPLES ? samples - STATS_WINDOW_SAMPLES : 0;
+    for (i = first; i < samples; i++) {
+        fprintf(out, "%s[%.3f,%u]", i > first ? "," : "", (double)s->windows[i % STATS_WINDOW_SAMPLES].time / 1e6,
+                s->windows[i % STATS_WINDOW_SAMPLES].window);
+    }
+    fprintf(out, "]}\n");
+    return;
+}
+
+// append to a text buffer, remembering if it ran out of room
+static void append(char *buff, size_t size, size_t *len, const char *format, ...) {
+    va_list args;
+    int n;
+
+    if (*len >= size) return;
+    va_start(args, format);
+    n = vsnprintf(buff + *len, size - *len, format, args);
+    va_end(args);
+    *len += n < 0 ? size : (size_t)n;
+    return;
+}
+
+int stats_format_prometheus(transfer_stats *s, char *buff, size_t size) {
+    static const char *counters[] = {
+        "transfers", "bytes_sent", "bytes_received", "packets_sent", "packets_received", "payload_bytes",
+        "stream_bytes", "retransmits", "timeouts", "duplicate_acks", "duplicate_packets",
+    };
+    u_llong values[] = {
+        STATS_GET(s->transfers), STATS_GET(s->bytes_sent), STATS_GET(s->bytes_received), STATS_GET(s->packets_sent),
+        STATS_GET(s->packets_received), STATS_GET(s->payload_bytes), STATS_GET(s->stream_bytes), STATS_GET(s->retransmits),
+        STATS_GET(s->timeouts), STATS_GET(s->duplicate_acks), STATS_GET(s->duplicate_packets),
+    };
+    u_llong cumulative = 0;
+    size_t len = 0, i;
+
+    for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        append(buff, size, &len, "# TYPE rft_%s_total counter\nrft_%s_total %llu\n", counters[i], counters[i], values[i]);
+    }
+    append(buff, size, &len, "# TYPE rft_window_packets gauge\nrft_window_packets %u\n", STATS_GET(s->window));
+    append(buff, size, &len, "# TYPE rft_progress_bytes gauge\nrft_progress_bytes %llu\n", STATS_GET(s->progress_bytes));
+    append(buff, size, &len, "# TYPE rft_progress_size_bytes gauge\nrft_progress_size_bytes %llu\n", STATS_GET(s->progress_size));
+    if (STATS_GET(s->peer_percent) != PERCENT_UNKNOWN) {
+        append(buff, size, &len, "# TYPE rft_peer_percent gauge\nrft_peer_percent %u\n", STATS_GET(s->peer_percent));
+    }
+
+    append(buff, size, &len, "# TYPE rft_rtt_seconds histogram\n");
+    for (i = 0; i < STATS_RTT_BUCKETS; i++) {
+        cumulative += STATS_GET(s->rtt_buckets[i]);
+        if (i == STATS_RTT_BUCKETS - 1) append(buff, size, &len, "rft_rtt_seconds_bucket{le=\"+Inf\"} %llu\n", cumulative);
+        else                            append(buff, size, &len, "rft_rtt_seconds_bucket{le=\"%g\"} %llu\n", (double)(1ULL << i) / 1e6, cumulative);
+    }
+    append(buff, size, &len, "rft_rtt_seconds_sum %.9f\nrft_rtt_seconds_count %llu\n",
+           (double)STATS_GET(s->rtt_sum) / 1e9, STATS_GET(s->rtt_count));
+    return len < size ? (int)len : -1;
+}
+
+// read an HTTP request up to the blank line after its headers. Whatever it asked for, the
+// answer is the same, so it is only read to be done with before answering
+static void read_request(int conn) {
+    struct pollfd pfd;
+    char request[1024];
+    size_t len = 0;
+    ssize_t n;
+
+    pfd.fd = conn;
+    pfd.events = POLLIN;
+    while (len < sizeof(request) - 1 && poll(&pfd, 1, METRICS_REQUEST_MS) > 0) {
+        if ((n = read(conn, request + len, sizeof(request) - 1 - len)) <= 0) break;
+        len += (size_t)n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != NULL || strstr(request, "\n\n") != NULL) break;
+    }
+    return;
+}
+
+static void write_all(int conn, const char *buff, size_t len) {
+    size_t sent;
+    ssize_t n;
+
+    for (sent = 0; sent < len; sent += (size_t)n) {
+        if ((n = write(conn, buff + sent, len - sent)) <= 0) break;
+    }
+    return;
+}
+
+static void *metrics_thread(void *arg) {
+    metrics_server *ms = (metrics_server *)arg;
+    transfer_stats view, *current;
+    struct pollfd pfd;
+    char text[METRICS_TEXT_SIZE], header[METRICS_HEADER_SIZE];
+    int conn, len, header_len;
+    u_int i;
+
+    pfd.fd = ms->socket_desc;
+    pfd.events = POLLIN;
+    while (!atomic_load(&ms->stop)) {
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0) continue;
+        if ((conn = accept(ms->socket_desc, NULL, NULL)) == -1) continue;
+
+        // the totals plus whatever the running transfers have done so far
+        pthread_mutex_lock(&ms->lock);
+        memset(&view, 0, sizeof(view));
+        STATS_SET(view.rtt_min, ~0ULL);
+        STATS_SET(view.peer_percent, PERCENT_UNKNOWN);
+        stats_merge(&view, &ms->totals);
+        for (i = 0; i < ms->running_count; i++) {
+            current = ms->running[i];
+            stats_merge(&view, current);
+            STATS_ADD(view.window, STATS_GET(current->window));
+            STATS_ADD(view.progress_bytes, STATS_GET(current->progress_bytes));
+            STATS_ADD(view.progress_size, STATS_GET(current->progress_size));
+            if (ms->running_count == 1) STATS_SET(view.peer_percent, STATS_GET(current->peer_percent));
+        }
+        pthread_mutex_unlock(&ms->lock);
+
+        read_request(conn);
+        len = stats_format_prometheus(&view, text, sizeof(text));
+        if (len == -1) {
+            header_len = snprintf(header, sizeof(header), "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            len = 0;
+        } else {
+            header_len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: %d\r\nConnection: close\r\n\r\n", len);
+        }
+        write_all(conn, header, (size_t)header_len);
+        write_all(conn, text, (size_t)len);
+        close(conn);
+    }
+    return NULL;
+}
+
+int metrics_start(metrics_server *ms, const char *path) {
+    struct sockaddr_un addr;
+
+    memset(ms, 0, sizeof(*ms));
+    STATS_SET(ms->totals.rtt_min, ~0ULL);
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        print_error("Metrics socket path is too long.", __LINE__);
+        return -1;
+    }
+    strcpy(ms->path, path);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    if ((ms->socket_desc = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    unlink(path);   // left over from a server that didn't exit cleanly
+    if (bind(ms->socket_desc, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(ms->socket_desc, 8) == -1) {
+        print_error(strerror(errno), __LINE__);
+        close(ms->socket_desc);
+        return -1;
+    }
+    pthread_mutex_init(&ms->lock, NULL);
+    if (pthread_create(&ms->thread, NULL, metrics_thread, ms) != 0) {
+        print_error("Could not start metrics thread.", __LINE__);
+        pthread_mutex_destroy(&ms->lock);
+        close(ms->socket_desc);
+        unlink(path);
+        return -1;
+    }
+    return 0;
+}
+
+int metrics_begin(metrics_server *ms, transfer_stats *current) {
+    transfer_stats **running;
+    int rv = 0;
+
+    pthread_mutex_lock(&ms->lock);
+    if (ms->running_count == ms->running_capacity) {
+        ms->running_capacity = ms->running_capacity ? ms->running_capacity * 2 : 16;
+        if ((running = realloc(ms->running, ms->running_capacity * sizeof(transfer_stats *))) == NULL) {
+            ms->running_capacity = ms->running_count;
+            rv = -1;
+        } else {
+            ms->running = running;
+        }
+    }
+    if (rv == 0) ms->running[ms->running_count++] = current;
+    pthread_mutex_unlock(&ms->lock);
+    return rv;
+}
+
+void metrics_end(metrics_server *ms, transfer_stats *current) {
+    u_int i;
+
+    pthread_mutex_lock(&ms->lock);
+    for (i = 0; i < ms->running_count; i++) {
+        if (ms->running[i] != current) continue;
+        stats_merge(&ms->totals, current);
+        ms->running[i] = ms->running[--ms->running_count];
+        break;
+    }
+    pthread_mutex_unlock(&ms->lock);
+    return;
+}
+
+void metrics_stop(metrics_server *ms) {
+    atomic_store(&ms->stop, 1);
+    pthread_join(ms->thread, NULL);
+    pthread_mutex_destroy(&ms->lock);
+    free(ms->running);
+    close(ms->socket_desc);
+    unlink(ms->path);
+    return;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file stats.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief transfer counters, RTT histogram, JSON summary and Prometheus text export
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "packet.h"
+
+#define STATS_RTT_BUCKETS 32            // bucket i counts RTTs under 2^i microseconds
+#define STATS_WINDOW_SAMPLES 128        // window size samples kept, the oldest are overwritten
+#define STATS_SAMPLE_NS 100000000ULL    // at most one window sample every 100 ms
+
+/*
+ * transfer_stats Design:
+ *
+ * Counters are written by more than one thread of a transfer (the one driving it, the
+ * disk reader, the disk pool), so each add is a relaxed atomic add: no ordering, and no
+ * update lost. Other threads (the metrics socket) can read them at any time with relaxed
+ * loads.
+ *
+ * The progress of the transfer running now starts over with each one, and is read by the
+ * progress reporter and the metrics socket, never printed from the transfer's thread.
+ *
+ * RTTs are only sampled from packets that were not resent (Karn's algorithm), so a
+ * retransmission never gets matched with the ACK of the first copy.
+ */
+
+#define STATS_GET(field)        atomic_load_explicit(&(field), memory_order_relaxed)
+#define STATS_SET(field, value) atomic_store_explicit(&(field), (value), memory_order_relaxed)
+#define STATS_ADD(field, n)     atomic_fetch_add_explicit(&(field), (n), memory_order_relaxed)
+
+typedef struct window_sample {
+    u_llong time;                       // nanoseconds since the transfer started
+    u_int window;                       // packets in flight
+} window_sample;
+
+typedef struct transfer_stats {
+    _Atomic u_llong start, end;         // CLOCK_MONOTONIC nanoseconds
+    _Atomic u_llong bytes_sent, bytes_received;         // on the wire, headers included
+    _Atomic u_llong packets_sent, packets_received;
+    _Atomic u_llong payload_bytes;      // file data sent or landed, first copies only
+    _Atomic u_llong stream_bytes;       // size of the data stream, from the FIN
+    _Atomic u_llong retransmits;
+    _Atomic u_llong timeouts;
+    _Atomic u_llong duplicate_acks;     // ACKs for anything but the packet being waited on
+    _Atomic u_llong duplicate_packets;  // SEQ packets that were already received
+    _Atomic u_llong transfers;
+    _Atomic u_llong rtt_count, rtt_sum, rtt_min, rtt_max;
+    _Atomic u_llong rtt_buckets[STATS_RTT_BUCKETS];
+    _Atomic u_int window;               // packets in flight right now
+    _Atomic u_llong progress_bytes;     // data of the transfer running now landed, or ACKed, so far
+    _Atomic u_llong progress_size;      // data it has, 0 until it is known (and for a stream)
+    _Atomic u_int peer_percent;         // how far the other side says it is, PERCENT_UNKNOWN if it doesn't
+    window_sample windows[STATS_WINDOW_SAMPLES];
+    _Atomic u_int window_count;         // samples taken, the last STATS_WINDOW_SAMPLES are kept
+    u_llong last_sample;
+    const char *disk_io;                // backend the last transfer read or wrote the files with, NULL before one
+    int direct_io;                      // and if it wrote them with O_DIRECT
+} transfer_stats;
+
+// Unix socket that answers every HTTP request with the Prometheus text of the counters
+typedef struct metrics_server {
+    int socket_desc;
+    char path[108];
+    pthread_mutex_t lock;               // taken to read or merge, never on the hot path
+    transfer_stats totals;              // every finished transfer
+    transfer_stats **running;           // the transfers running now
+    u_int running_count, running_capacity;
+    _Atomic int stop;
+    pthread_t thread;
+} metrics_server;
+
+/**
+ * Returns CLOCK_MONOTONIC in nanoseconds.
+ */
+u_llong stats_now(void);
+
+/**
+ * Zeroes every counter and marks the start of the transfer.
+ */
+void stats_init(transfer_stats *s);
+
+/**
+ * Marks the end of the transfer.
+ */
+void stats_finish(transfer_stats *s);
+
+/**
+ * Starts over the progress for a transfer of size bytes of data (0 if it isn't known yet).
+ */
+void stats_begin_progress(transfer_stats *s, u_llong size);
+
+/**
+ * Returns bytes as a percent of size (at most 100), or PERCENT_UNKNOWN if size is 0.
+ */
+u_int stats_percent(u_llong bytes, u_llong size);
+
+/**
+ * Adds one RTT sample.
+ */
+void stats_add_rtt(transfer_stats *s, u_llong rtt);
+
+/**
+ * Sets the number of packets in flight, keeping a sample of it now and then.
+ */
+void stats_set_window(transfer_stats *s, u_int window);
+
+/**
+ * Adds the counters of a finished transfer to the totals.
+ */
+void stats_merge(transfer_stats *totals, transfer_stats *s);
+
+/**
+ * Prints a one line JSON summary of the transfer.
+ */
+void stats_print_json(transfer_stats *s, FILE *out, const char *side);
+
+/**
+ * Writes the counters in Prometheus text format. Returns the length, or -1 if it didn't fit.
+ */
+int stats_format_prometheus(transfer_stats *s, char *buff, size_t size);
+
+/**
+ * Starts answering HTTP requests on the Unix socket at path with the Prometheus text of
+ * the server's totals plus the transfers running now, one request per connection. The
+ * gauges add up the running transfers, and the peer's percent is only there while one is.
+ */
+int metrics_start(metrics_server *ms, const char *path);
+
+/**
+ * Adds a transfer to the ones running now. Returns -1 if there was no room for it.
+ */
+int metrics_begin(metrics_server *ms, transfer_stats *current);
+
+/**
+ * Takes a transfer off the ones running now, adding it to the totals.
+ */
+void metrics_end(metrics_server *ms, transfer_stats *current);
+
+/**
+ * Stops the metrics thread and removes the socket.
+ */
+void metrics_stop(metrics_server *ms);
+
+#endif
@@ -0,0 +1,183 @@
+#!/bin/bash
+#
+# Matthew Getgen's regression tests for RFT
+#
+# Each test runs the server and client on loopback, through ./relay when it needs the network
+# to misbehave, checks what landed and prints PASS or FAIL with its name. Exits non-zero if
+# any test failed, the logs of each are left in TEST_DIR/logs.
+#
+# Everything can be set from the environment:
+#   TEST_PORT     server port, the relay listens on the next one
+#   TEST_TIMEOUT  seconds before a test is given up on
+#   TEST_DIR      where the files and logs go
+#
+
+PORT=${TEST_PORT:-9700}
+TIMEOUT=${TEST_TIMEOUT:-60}
+DIR=${TEST_DIR:-test-results}
+
+cd "$(dirname "$0")" || exit 1
+for exe in client server relay; do
+    [ -x ./$exe ] || { echo "missing ./$exe, run make new relay first" >&2; exit 1; }
+done
+rm -rf "$DIR"
+mkdir -p "$DIR/remote" "$DIR/local" "$DIR/logs" || exit 1
+failed=0
+
+# value of a number field in a one line JSON object
+field() {
+    sed -n "s/.*\"$1\":\([0-9.]*\).*/\1/p" <<< "$2" | head -n 1
+}
+
+# fetch: fetch log "names, one per line" [relay options] [client options]
+# downloads the names from a server (through a relay if options are given) into $DIR/local
+fetch() {
+    local log="$DIR/logs/$1" names=$2 options=$3 client_options=$4 server relay port=$PORT rv
+
+    timeout "$TIMEOUT" ./server -n 1 "$PORT" > "$log.server" 2> "$log.server.err" &
+    server=$!
+    if [ -n "$options" ]; then
+        port=$((PORT + 1))
+        # shellcheck disable=SC2086
+        ./relay $options "$port" 127.0.0.1 "$PORT" 2> "$log.relay" &
+        relay=$!
+    fi
+    sleep 0.2
+
+    # shellcheck disable=SC2086
+    printf '%s\n' "$names" | timeout "$TIMEOUT" ./client $client_options 127.0.0.1 "$port" "$DIR/remote" "$DIR/local" > "$log.client" 2> "$log.client.err"
+    rv=$?
+    wait "$server"
+    if [ -n "$options" ]; then
+        kill "$relay"
+        wait "$relay"
+    fi
+    return $rv
+}
+
+result() {
+    if [ "$2" = 1 ]; then
+        echo "PASS $1"
+    else
+        echo "FAIL $1${3:+: $3}"
+        failed=1
+    fi
+}
+
+# many files far smaller than a packet are packed together, not sent a packet each
+test_small_files() {
+    local ok=1 packets client i
+
+    mkdir -p "$DIR/remote/small"
+    for i in $(seq 1 2000); do
+        head -c 150 /dev/urandom > "$DIR/remote/small/$i"
+    done
+    fetch small_files "small" || ok=0
+    diff -r "$DIR/remote/small" "$DIR/local/small" > /dev/null || ok=0
+
+    # 300 KB is about 215 full packets, and the listing a few dozen more
+    client=$(grep -o '{"side":"client".*' "$DIR/logs/small_files.client.err" | tail -n 1)
+    packets=$(field packets_received "$client")
+    [ "${packets:-2000}" -lt 1000 ] || ok=0
+    result small_files $ok "${packets:-no} packets received for 2000 files"
+}
+
+# a FIN that turns up again in the middle of the next request of the session is from the
+# last transfer, and doesn't end this one
+test_stale_fin() {
+    local ok=1 name
+
+    head -c 1000 /dev/urandom > "$DIR/remote/first.txt"
+    head -c 3000000 /dev/urandom > "$DIR/remote/middle.bin"
+    head -c 5000 /dev/urandom > "$DIR/remote/last.dat"
+    fetch stale_fin "first.txt
+middle.bin
+last.dat" "-d 2 -f 40 -s 1" || ok=0
+    for name in first.txt middle.bin last.dat; do
+        cmp -s "$DIR/remote/$name" "$DIR/local/$name" || ok=0
+    done
+    result stale_fin $ok
+}
+
+# on loopback nothing is lost, as the sender never has more in flight than the receiver's
+# socket buffer has room for
+test_no_drops() {
+    local ok=1 server retransmits
+
+    head -c 25000000 /dev/urandom > "$DIR/remote/large.bin"
+    fetch no_drops "large.bin" || ok=0
+    cmp -s "$DIR/remote/large.bin" "$DIR/local/large.bin" || ok=0
+
+    server=$(grep -o '{"side":"server".*' "$DIR/logs/no_drops.server.err" | tail -n 1)
+    retransmits=$(field retransmits "$server")
+    [ "${retransmits:-1}" -eq 0 ] || ok=0
+    result no_drops $ok "${retransmits:-no} packets resent of 25 MB"
+}
+
+# an upload lands under the server's upload directory, and can't be sent out of it
+test_upload_root() {
+    local ok=1 root log="$DIR/logs/upload_root"
+
+    mkdir -p "$DIR/uploads"
+    head -c 100000 /dev/urandom > "$DIR/local/up.bin"
+    for root in inbox ../outside "$(cd "$DIR" && pwd)/outside"; do
+        timeout "$TIMEOUT" ./server -n 1 -d "$DIR/uploads" "$PORT" >> "$log.server" 2>&1 &
+        sleep 0.2
+        echo up.bin | timeout "$TIMEOUT" ./client -u 127.0.0.1 "$PORT" "$root" "$DIR/local" >> "$log.client" 2>&1
+        wait
+    done
+    cmp -s "$DIR/local/up.bin" "$DIR/uploads/inbox/up.bin" || ok=0
+    [ ! -e "$DIR/outside" ] || ok=0
+    result upload_root $ok
+}
+
+# a file that takes longer to cut into chunks than the client waits for an answer still
+# comes, as the server keeps the request alive until the chunk list is ready
+test_large_chunks() {
+    local ok=1 TIMEOUT=$((TIMEOUT * 3))    # both sides hash the whole file, which is slow
+
+    # mostly a hole, so it takes no room, but every byte of it is still read and hashed
+    truncate -s 1500M "$DIR/remote/huge.bin"
+    head -c 1000000 /dev/urandom | dd of="$DIR/remote/huge.bin" bs=1M seek=700 conv=notrunc status=none
+    fetch large_chunks "huge.bin" "" "-c $DIR/cache" || ok=0
+    cmp -s "$DIR/remote/huge.bin" "$DIR/local/huge.bin" || ok=0
+    result large_chunks $ok
+}
+
+# clients that connect at once are served at once, on one port, and share its global cap
+test_concurrent() {
+    local ok=1 i start elapsed server clients=() log="$DIR/logs/concurrent"
+
+    for i in 1 2 3; do
+        head -c 5000000 /dev/urandom > "$DIR/remote/session$i.bin"
+        mkdir -p "$DIR/local/session$i"
+    done
+    start=$(date +%s%N)
+    # 15 MB at 80 Mbit/s is 1.5 seconds
+    timeout "$TIMEOUT" ./server -n 3 -g 80 "$PORT" > "$log.server" 2> "$log.server.err" &
+    server=$!
+    sleep 0.2
+    for i in 1 2 3; do
+        echo "session$i.bin" | timeout "$TIMEOUT" ./client 127.0.0.1 "$PORT" "$DIR/remote" "$DIR/local/session$i" > "$log.client$i" 2>&1 &
+        clients+=($!)
+    done
+    for i in "${clients[@]}"; do
+        wait "$i" || ok=0
+    done
+    wait "$server" || ok=0
+    elapsed=$((($(date +%s%N) - start) / 1000000))
+    for i in 1 2 3; do
+        cmp -s "$DIR/remote/session$i.bin" "$DIR/local/session$i/session$i.bin" || ok=0
+    done
+    [ "$elapsed" -ge 1300 ] || ok=0
+    result concurrent $ok "3 sessions took ${elapsed} ms"
+}
+
+test_small_files
+test_stale_fin
+test_no_drops
+test_upload_root
+test_large_chunks
+test_concurrent
+
+exit $failed
@@ -0,0 +1,255 @@
+/**
+ * @file timer.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief hierarchical timer wheel driven by one timerfd
+ * @version 0.1
+ * @date 2026-10-18
+ */
+#include "timer.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "stats.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define LEVEL_SHIFT(level) (TIMER_SLOT_BITS * (level))
+
+// the wheel every transfer of the process shares, and the thread running it
+static timer_wheel shared;
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t shared_once = PTHREAD_ONCE_INIT;
+static pthread_t shared_thread;
+static int shared_started;
+
+int timer_init(timer_wheel *w) {
+    memset(w, 0, sizeof(*w));
+    w->timer_desc = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (w->timer_desc == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    w->now = stats_now() / TIMER_TICK_NS;
+    return 0;
+}
+
+void timer_free(timer_wheel *w) {
+    close(w->timer_desc);
+    return;
+}
+
+// arm the timerfd for the start of a tick, or disarm it if tick is 0
+static void arm(timer_wheel *w, u_llong tick) {
+    struct itimerspec when;
+
+    memset(&when, 0, sizeof(when));
+    when.it_value.tv_sec = (time_t)(tick * TIMER_TICK_NS / 1000000000ULL);
+    when.it_value.tv_nsec = (long)(tick * TIMER_TICK_NS % 1000000000ULL);
+    if (timerfd_settime(w->timer_desc, TFD_TIMER_ABSTIME, &when, NULL) == -1) print_error(strerror(errno), __LINE__);
+    w->armed = tick;
+    return;
+}
+
+// put a timer in the slot of the lowest level that reaches its tick. Past the top level, it
+// waits as long as the wheel reaches
+static void place(timer_wheel *w, timer *t) {
+    u_llong delta;
+    u_int level = 0;
+    timer **slot;
+
+    if (t->expires < w->now) t->expires = w->now;
+    delta = t->expires - w->now;
+    if (delta >= 1ULL << LEVEL_SHIFT(TIMER_LEVELS)) t->expires = w->now + (1ULL << LEVEL_SHIFT(TIMER_LEVELS)) - 1;
+    while (level < TIMER_LEVELS - 1 && delta >= 1ULL << LEVEL_SHIFT(level + 1)) level++;
+
+    slot = &w->slots[level][(t->expires >> LEVEL_SHIFT(level)) & TIMER_MASK];
+    t->next = *slot;
+    if (t->next != NULL) t->next->prev = &t->next;
+    t->prev = slot;
+    *slot = t;
+    return;
+}
+
+static void unlink_timer(timer *t) {
+    *t->prev = t->next;
+    if (t->next != NULL) t->next->prev = t->prev;
+    t->next = NULL;
+    t->prev = NULL;
+    return;
+}
+
+void timer_add(timer_wheel *w, timer *t, u_llong deadline) {
+    if (t->prev != NULL) unlink_timer(t);
+    else                 w->pending++;
+    t->expires = (deadline + TIMER_TICK_NS - 1) / TIMER_TICK_NS;    // never early
+    place(w, t);
+    if (w->armed == 0 || t->expires < w->armed) arm(w, t->expires);
+    return;
+}
+
+// the timerfd stays armed: if it goes off for nothing, timer_expire() just rearms it
+void timer_cancel(timer_wheel *w, timer *t) {
+    if (t->prev == NULL) return;
+    unlink_timer(t);
+    w->pending--;
+    return;
+}
+
+int timer_pending(timer *t) {
+    return t->prev != NULL;
+}
+
+// the earliest tick anything has to happen on: a timer firing in level 0, or the slot of
+// a level above being cascaded down. 0 if nothing is pending
+static u_llong next_tick(timer_wheel *w) {
+    u_llong next = 0, tick;
+    u_int level, d, first;
+
+    if (w->pending == 0) return 0;
+    for (level = 0; level < TIMER_LEVELS; level++) {
+        // level 0 holds the ticks from now on, each level above the turns after the current one
+        first = level == 0 ? 0 : 1;
+        for (d = first; d < TIMER_SLOTS + first; d++) {
+            if (w->slots[level][((w->now >> LEVEL_SHIFT(level)) + d) & TIMER_MASK] == NULL) continue;
+            tick = ((w->now >> LEVEL_SHIFT(level)) + d) << LEVEL_SHIFT(level);
+            if (next == 0 || tick < next) next = tick;
+            break;
+        }
+    }
+    return next;
+}
+
+timer *timer_expire(timer_wheel *w, u_llong now) {
+    u_llong target = now / TIMER_TICK_NS, expirations;
+    timer *fired = NULL, **last = &fired, *t, *list;
+    u_int level;
+
+    // clear the timerfd, it is rearmed below
+    if (read(w->timer_desc, &expirations, sizeof(expirations)) == -1 && errno != EAGAIN) print_error(strerror(errno), __LINE__);
+
+    while (w->now <= target) {
+        if (w->pending == 0) {
+            w->now = target + 1;
+            break;
+        }
+        // level 0 came all the way round: bring the next turn of each level above down
+        for (level = 1; level < TIMER_LEVELS && (w->now & ((1ULL << LEVEL_SHIFT(level)) - 1)) == 0; level++) {
+            list = w->slots[level][(w->now >> LEVEL_SHIFT(level)) & TIMER_MASK];
+            w->slots[level][(w->now >> LEVEL_SHIFT(level)) & TIMER_MASK] = NULL;
+            while ((t = list) != NULL) {
+                list = t->next;
+                place(w, t);
+            }
+        }
+        while ((t = w->slots[0][w->now & TIMER_MASK]) != NULL) {
+            unlink_timer(t);
+            w->pending--;
+            *last = t;
+            last = &t->next;
+        }
+        w->now++;
+    }
+    arm(w, next_tick(w));
+    return fired;
+}
+
+// sleep on the shared wheel's timerfd, and notify every timer that fired
+static void *run_shared(void *arg) {
+    struct pollfd fd;
+    timer *fired, *t;
+    u_llong one = 1;
+    (void)arg;
+
+    fd.fd = shared.timer_desc;
+    fd.events = POLLIN;
+    while (1) {
+        if (poll(&fd, 1, -1) == -1) {
+            if (errno != EINTR) print_error(strerror(errno), __LINE__);
+            continue;
+        }
+        pthread_mutex_lock(&shared_lock);
+        for (fired = timer_expire(&shared, stats_now()); fired != NULL; fired = t) {
+            t = fired->next;
+            fired->next = NULL;
+            fired->fired = 1;
+            if (write(fired->notify_desc, &one, sizeof(one)) == -1) print_error(strerror(errno), __LINE__);
+        }
+        pthread_mutex_unlock(&shared_lock);
+    }
+    return NULL;
+}
+
+// the thread lives as long as the process, and is never joined
+static void start_shared(void) {
+    if (timer_init(&shared) == -1) return;
+    if (pthread_create(&shared_thread, NULL, run_shared, NULL) != 0) {
+        print_error("Could not start the timer thread.", __LINE__);
+        timer_free(&shared);
+        return;
+    }
+    pthread_detach(shared_thread);
+    shared_started = 1;
+    return;
+}
+
+int timer_open(timer *t) {
+    memset(t, 0, sizeof(*t));
+    pthread_once(&shared_once, start_shared);
+    if (!shared_started) return -1;
+    t->notify_desc = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (t->notify_desc == -1) {
+        print_error(strerror(errno), __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+void timer_close(timer *t) {
+    timer_unset(t);
+    close(t->notify_desc);
+    return;
+}
+
+void timer_set(timer *t, u_llong deadline) {
+    pthread_mutex_lock(&shared_lock);
+    // an empty wheel catches up with the clock first, so it never runs the ticks it sat idle
+    if (shared.pending == 0) shared.now = stats_now() / TIMER_TICK_NS;
+    timer_add(&shared, t, deadline);
+    t->fired = 0;
+    pthread_mutex_unlock(&shared_lock);
+    return;
+}
+
+void timer_unset(timer *t) {
+    pthread_mutex_lock(&shared_lock);
+    timer_cancel(&shared, t);
+    t->fired = 0;
+    pthread_mutex_unlock(&shared_lock);
+    return;
+}
+
+int timer_is_set(timer *t) {
+    int rv;
+
+    pthread_mutex_lock(&shared_lock);
+    rv = timer_pending(t) || t->fired;
+    pthread_mutex_unlock(&shared_lock);
+    return rv;
+}
+
+int timer_take(timer *t) {
+    u_llong count;
+    int rv;
+
+    if (read(t->notify_desc, &count, sizeof(count)) == -1 && errno != EAGAIN) print_error(strerror(errno), __LINE__);
+    pthread_mutex_lock(&shared_lock);
+    rv = t->fired;
+    t->fired = 0;
+    pthread_mutex_unlock(&shared_lock);
+    return rv;
+}
+
+pthread_t timer_thread(void) {
+    return shared_thread;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file timer.h
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief hierarchical timer wheel driven by one timerfd
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <pthread.h>
+
+#include "packet.h"
+
+#define TIMER_TICK_NS 1000000ULL    // 1 ms
+#define TIMER_LEVELS 4              // 64 ms, 4 s, 4.4 minutes and 4.7 hours ahead
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+/*
+ * timer_wheel Design:
+ *
+ * Time is cut into ticks, and each level of the wheel is a ring of TIMER_SLOTS slots, each
+ * a list of the timers due in it. A slot of level 0 is one tick, and a slot of each level
+ * above is a whole turn of the level below. A timer goes into the lowest level that reaches
+ * its deadline, so adding or cancelling one is O(1) however many are pending.
+ *
+ * Every tick fires the level 0 slot it lands on. Once level 0 has gone all the way round,
+ * the next slot of level 1 is cascaded: each timer in it is added again, now into level 0,
+ * and the same for the levels above. A timer fires on the tick it is due, never early.
+ *
+ * The wheel keeps a timerfd armed for the earliest slot with anything in it, so one file
+ * descriptor can be polled along with the socket. When it is readable, timer_expire() runs
+ * the wheel up to now and hands back everything that fired.
+ *
+ * Every transfer of the process puts its timers on one shared wheel, run by a thread of its
+ * own that sleeps on the wheel's timerfd (timer_open() starts it, the first time). So a
+ * process with thousands of transfers has one timerfd and one wheel, not one of each per
+ * transfer. A timer on it has an eventfd, which the thread writes to when the timer fires,
+ * and which its transfer polls along with its socket. The shared wheel is behind a lock;
+ * a timer that fired is only taken (timer_take()) if it wasn't set again since, so a firing
+ * raced by an ACK that restarted the timer is never taken for a timeout.
+ */
+
+typedef struct timer {
+    struct timer *next;             // in its slot, or in the list timer_expire() returns
+    struct timer **prev;            // what points at it in its slot, NULL unless pending
+    u_llong expires;                // tick it is due on
+    int notify_desc;                // shared wheel: eventfd written to when it fires
+    int fired;                      // shared wheel: fired, and not taken since
+} timer;
+
+typedef struct timer_wheel {
+    int timer_desc;                 // timerfd, readable once the earliest slot is due
+    u_llong now;                    // next tick to run, every one before it has fired
+    u_llong armed;                  // tick the timerfd is armed for, 0 if disarmed
+    u_int pending;
+    timer *slots[TIMER_LEVELS][TIMER_SLOTS];
+} timer_wheel;
+
+/**
+ * Initializes an empty wheel and its timerfd.
+ */
+int timer_init(timer_wheel *w);
+
+/**
+ * Closes the timerfd. Pending timers are just forgotten.
+ */
+void timer_free(timer_wheel *w);
+
+/**
+ * Adds a timer due at deadline (CLOCK_MONOTONIC nanoseconds), moving it if it is pending.
+ */
+void timer_add(timer_wheel *w, timer *t, u_llong deadline);
+
+/**
+ * Cancels a timer, if it is pending.
+ */
+void timer_cancel(timer_wheel *w, timer *t);
+
+/**
+ * Returns 1 if the timer is pending.
+ */
+int timer_pending(timer *t);
+
+/**
+ * Runs the wheel up to now, and returns every timer that fired, linked by next (NULL if
+ * none). They are no longer pending. Rearms the timerfd.
+ */
+timer *timer_expire(timer_wheel *w, u_llong now);
+
+/**
+ * Opens a timer on the wheel the process shares, starting the wheel's thread if it isn't
+ * running yet. Its notify_desc becomes readable when it fires.
+ */
+int timer_open(timer *t);
+
+/**
+ * Cancels a timer of the shared wheel, and closes its eventfd.
+ */
+void timer_close(timer *t);
+
+/**
+ * Sets a timer of the shared wheel to fire at deadline (CLOCK_MONOTONIC nanoseconds),
+ * moving it if it is set, and forgetting it if it fired but wasn't taken.
+ */
+void timer_set(timer *t, u_llong deadline);
+
+/**
+ * Cancels a timer of the shared wheel, and forgets it if it fired but wasn't taken.
+ */
+void timer_unset(timer *t);
+
+/**
+ * Returns 1 if a timer of the shared wheel is set, or fired and wasn't taken yet.
+ */
+int timer_is_set(timer *t);
+
+/**
+ * Clears the notify_desc of a timer of the shared wheel, and returns 1 if the timer fired
+ * since it was last set. Each firing is taken once.
+ */
+int timer_take(timer *t);
+
+/**
+ * Returns the thread running the shared wheel, so a pinned caller can let it run anywhere.
+ * Only once timer_open() succeeded.
+ */
+pthread_t timer_thread(void);
+
+#endif
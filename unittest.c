@@ -0,0 +1,458 @@
+/**
+ * @file unittest.c
+ * @author Matthew Getgen (matt_getgen@taylor.edu)
+ * @brief unit tests of the data structures the transfers are built on
+ * @version 0.1
+ * @date 2026-10-18
+ */
+
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "chunk.h"
+#include "rate.h"
+#include "ring.h"
+#include "sender.h"
+#include "stats.h"
+#include "timer.h"
+
+/*
+ * Each test drives one data structure of librft through its API, with no network and no
+ * threads of its own, and checks what it does against what it is documented to do. What a
+ * send window resends goes over a socket pair, to be read back. Where time
+ * matters, the test passes in a clock of its own rather than sleeping, so every run is the
+ * same. Like test.sh, each prints PASS or FAIL with its name, and the program exits non-zero
+ * if any failed. Pass names to run only those.
+ */
+
+typedef struct unit_test {
+    const char *name;
+    int (*run)(char *detail, size_t len);     // 1 if it passed, else says why in detail
+} unit_test;
+
+// a client address on loopback
+static struct sockaddr_storage test_addr(u_short port) {
+    struct sockaddr_storage addr;
+    struct sockaddr_in *in = (struct sockaddr_in *)&addr;
+
+    memset(&addr, 0, sizeof(addr));
+    in->sin_family = AF_INET;
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    in->sin_port = htons(port);
+    return addr;
+}
+
+// send full packets from a share for as long as its bucket lets them go, from now to until,
+// in 1 ms steps. Returns the bytes sent
+static u_llong drain_share(rate_share *s, u_llong now, u_llong until) {
+    u_llong sent = 0;
+
+    for (; now < until; now += 1000000ULL) {
+        while (rate_due(s, now) == 0) {
+            rate_take(s, sizeof(Packet));
+            sent += sizeof(Packet);
+        }
+    }
+    return sent;
+}
+
+// two priority classes under one global cap: the higher one gets all of it but the trickle
+// left to the classes below
+int test_rate_priority(char *detail, size_t len) {
+    rate_limiter limiter;
+    rate_share urgent, bulk;
+    struct sockaddr_storage addr = test_addr(9000);
+    u_llong cap = 10000000ULL, start, urgent_sent, bulk_sent, urgent_want, bulk_want;
+    int ok;
+
+    if (rate_init(&limiter, 0, 0, cap) == -1) return 0;
+    rate_join(&bulk, &limiter, &addr, 1, 0, 0);
+    rate_join(&urgent, &limiter, &addr, 1, PRIORITY_CLASSES - 1, 0);
+    start = stats_now();
+    // one second each, the bucket holds no more than 10 ms of it
+    urgent_sent = drain_share(&urgent, start, start + 1000000000ULL);
+    bulk_sent = drain_share(&bulk, start, start + 1000000000ULL);
+    rate_leave(&urgent);
+    rate_leave(&bulk);
+    rate_free(&limiter);
+
+    urgent_want = cap - cap / RATE_TRICKLE;
+    bulk_want = cap / RATE_TRICKLE;
+    ok = urgent.rate == urgent_want && bulk.rate == bulk_want &&
+         urgent_sent + urgent_want / 50 >= urgent_want && urgent_sent <= urgent_want + urgent_want / 50 &&
+         bulk_sent + bulk_want / 10 >= bulk_want && bulk_sent <= bulk_want + bulk_want / 10;
+    snprintf(detail, len, "urgent sent %llu of %llu B/s, bulk %llu of %llu B/s", urgent_sent, urgent_want, bulk_sent, bulk_want);
+    return ok;
+}
+
+// transfers in one class share a cap by weight, each client's cap is shared only by the
+// transfers to that client, and a transfer that leaves hands its share back. However long a
+// bucket has been idle, it only lets out a burst of RATE_BURST_NS of its rate at once
+int test_rate_sharing(char *detail, size_t len) {
+    rate_limiter limiter;
+    rate_share a, b, c;
+    struct sockaddr_storage host = test_addr(9000), second_port = test_addr(9001), other = test_addr(9000);
+    u_llong client_cap = 4000000ULL, global_cap = 10000000ULL, start, burst, sent;
+    int ok = 0;
+
+    if (rate_init(&limiter, 0, client_cap, global_cap) == -1) return 0;
+    // a and b go to one host (on two ports, which a client's cap ignores), c to another
+    ((struct sockaddr_in *)&other)->sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1);
+    rate_join(&a, &limiter, &host, 1, 0, 0);
+    rate_join(&b, &limiter, &second_port, 3, 0, 0);
+    rate_join(&c, &limiter, &other, 1, 0, 0);
+    start = stats_now();
+
+    // the host's cap splits 1:3 between a and b, and c's share of the global cap (1 of 5
+    // weights) is below its own host's cap
+    sent = drain_share(&b, start, start + 1000000000ULL);
+    drain_share(&a, start, start + 1000000000ULL);
+    drain_share(&c, start, start + 1000000000ULL);
+    if (a.rate != client_cap / 4 || b.rate != client_cap * 3 / 4 || c.rate != global_cap / 5) {
+        snprintf(detail, len, "shares of %llu, %llu and %llu B/s", a.rate, b.rate, c.rate);
+    } else if (sent + b.rate / 50 < b.rate || sent > b.rate + b.rate / 50) {
+        snprintf(detail, len, "sent %llu B in a second at %llu B/s", sent, b.rate);
+    } else {
+        // once b is gone, a has its host's cap to itself, and c half the global one but for its host's cap
+        rate_leave(&b);
+        start += 1000000000ULL;
+        drain_share(&a, start, start + 1000000ULL);
+        drain_share(&c, start, start + 1000000ULL);
+        if (a.rate != client_cap || c.rate != client_cap) {
+            snprintf(detail, len, "after one left, shares of %llu and %llu B/s", a.rate, c.rate);
+        } else {
+            // a second idle, then as much as the bucket lets out at once
+            start += 1000000000ULL;
+            burst = a.rate * RATE_BURST_NS / 1000000000ULL;
+            if (burst < RATE_MIN_BURST) burst = RATE_MIN_BURST;
+            sent = drain_share(&a, start, start + 1);
+            ok = sent <= burst + sizeof(Packet) && sent + sizeof(Packet) > burst;
+            snprintf(detail, len, "a burst of %llu B after idling, for a bucket of %llu B", sent, burst);
+        }
+    }
+    rate_leave(&a);
+    rate_leave(&b);     // does nothing if it already left
+    rate_leave(&c);
+    rate_free(&limiter);
+    return ok;
+}
+
+// timers on every level of a wheel each fire on the tick they are due, not one before, as
+// they are cascaded down from the levels above; one moved fires only at its new time, and
+// one cancelled never does
+int test_timer_cascade(char *detail, size_t len) {
+    // ms ahead: level 0, the edges of level 1, both sides of a turn of level 1, level 2, level 3
+    static const u_llong ahead[] = { 3, 63, 64, 65, 4095, 4096, 4097, 5000, 100000, 300000 };
+    const size_t count = sizeof(ahead) / sizeof(ahead[0]), moved = 7;
+    timer_wheel w;
+    timer timers[sizeof(ahead) / sizeof(ahead[0])], cancelled, *fired;
+    u_llong start, due;
+    size_t i;
+    int ok = 1;
+
+    if (timer_init(&w) == -1) return 0;
+    memset(timers, 0, sizeof(timers));
+    memset(&cancelled, 0, sizeof(cancelled));
+    // on the wheel's own clock, which only moves when timer_expire() is called
+    start = w.now * TIMER_TICK_NS;
+    timer_add(&w, &timers[moved], start + 10 * TIMER_TICK_NS);
+    for (i = 0; i < count; i++) timer_add(&w, &timers[i], start + ahead[i] * TIMER_TICK_NS);
+    timer_add(&w, &cancelled, start + 4096 * TIMER_TICK_NS);
+    timer_cancel(&w, &cancelled);
+
+    for (i = 0; i < count && ok; i++) {
+        due = start + ahead[i] * TIMER_TICK_NS;
+        if (timer_expire(&w, due - 1) != NULL) {
+            snprintf(detail, len, "a timer fired before the one %llu ms ahead was due", ahead[i]);
+            ok = 0;
+        } else if ((fired = timer_expire(&w, due)) != &timers[i] || fired->next != NULL) {
+            snprintf(detail, len, "the timer %llu ms ahead didn't fire alone on its tick", ahead[i]);
+            ok = 0;
+        }
+    }
+    if (ok && (timer_pending(&cancelled) || w.pending != 0)) {
+        snprintf(detail, len, "%u timers still pending after the last was due", w.pending);
+        ok = 0;
+    }
+    timer_free(&w);
+    return ok;
+}
+
+// take in an ACK of ack_num that says the count packets in held are held past it, then
+// resend what the window's scoreboard shows was lost
+static int take_ack(connection *connect, send_window *w, u_int ack_num, const u_int *held, int count) {
+    Packet ack;
+    u_llong bitmap = 0;
+    u_int base = w->base;
+    int i;
+
+    for (i = 0; i < count; i++) bitmap |= 1ULL << (held[i] - ack_num - 1);
+    set_packet_acknowledgement(&ack, ack_num, 0, WINDOW_SIZE, &bitmap, 1);
+    if (handle_ack(connect, w, &ack) == -1) return -1;
+    return repair_window(connect, w, w->base != base);
+}
+
+// read back what was resent: 1 if it was the count packets in want, in any order
+static int resent_exactly(int peer, const u_int *want, int count) {
+    Packet packet;
+    int i, got = 0, found;
+
+    while (recv(peer, &packet, sizeof(packet), MSG_DONTWAIT) > 0) {
+        for (i = 0, found = 0; i < count; i++) found |= packet.header.seq_num == want[i];
+        if (!found) return 0;
+        got++;
+    }
+    return got == count;
+}
+
+// a ring of 4 slots, its counters about to overflow, filled and drained a few slots at a time
+// for many turns: everything comes out once and in order, slots filled out of order with
+// ring_try_write_at() only show once committed, and a full or empty ring says so
+int test_ring_wraparound(char *detail, size_t len) {
+    ring r;
+    u_int written = 0, read = 0, round, n, i, *slot;
+    int ok = 1;
+
+    if (ring_init(&r, 3, sizeof(u_int)) == -1) return 0;
+    if (r.size != 4) {
+        snprintf(detail, len, "3 slots rounded up to %u", r.size);
+        ring_free(&r);
+        return 0;
+    }
+    atomic_store(&r.head, (u_int)-6);
+    atomic_store(&r.tail, (u_int)-6);
+
+    for (round = 0; round < 100 && ok; round++) {
+        // fill from 1 to 4 slots, as many as are free, last first
+        n = 1 + round % 4;
+        if (n > r.size - (written - read)) n = r.size - (written - read);
+        for (i = n; i-- > 0;) {
+            if ((slot = (u_int *)ring_try_write_at(&r, i)) == NULL) break;
+            *slot = written + i;
+        }
+        if (i != (u_int)-1 || (written - read + n == r.size && ring_try_write_at(&r, n) != NULL)) {
+            snprintf(detail, len, "round %u: the %u free slots weren't all there was room for", round, r.size - (written - read));
+            ok = 0;
+            break;
+        }
+        if (read == written && ring_try_read(&r) != NULL) {
+            snprintf(detail, len, "round %u: a slot could be read before it was committed", round);
+            ok = 0;
+            break;
+        }
+        for (i = 0; i < n; i++) ring_commit(&r);
+        written += n;
+        if (written - read == r.size && ring_try_write(&r) != NULL) {
+            snprintf(detail, len, "round %u: a full ring had room", round);
+            ok = 0;
+        }
+
+        // drain from 1 to 4, but never more than was written
+        n = 1 + round * 3 % 4;
+        for (i = 0; i < n && read != written && ok; i++) {
+            if ((slot = (u_int *)ring_try_read(&r)) == NULL || *slot != read) {
+                snprintf(detail, len, "round %u: slot %u came out as %d", round, read, slot == NULL ? -1 : (int)*slot);
+                ok = 0;
+                break;
+            }
+            ring_release(&r);
+            read++;
+        }
+        if (ok && read == written && ring_try_read(&r) != NULL) {
+            snprintf(detail, len, "round %u: an empty ring had a slot to read", round);
+            ok = 0;
+        }
+    }
+
+    // once closed, it is still drained, then reading stops, and so does writing when full
+    if (ok) {
+        ring_close(&r);
+        while (read != written && (slot = (u_int *)ring_read(&r)) != NULL && *slot == read) {
+            ring_release(&r);
+            read++;
+        }
+        for (i = 0; i < r.size; i++) {
+            ring_try_write(&r);
+            ring_commit(&r);
+        }
+        if (read != written || !ring_is_closed(&r) || ring_write(&r) != NULL) {
+            snprintf(detail, len, "a closed ring kept going, %u of %u read", read, written);
+            ok = 0;
+        }
+    }
+    ring_free(&r);
+    return ok;
+}
+
+// cut len bytes of data into chunks, each ending at one of the offsets put in ends.
+// Returns how many
+static u_int cut_chunks(const u_char *data, size_t len, size_t *ends) {
+    size_t offset = 0;
+    u_int count = 0;
+
+    while (offset < len) {
+        offset += chunk_cut(data + offset, len - offset);
+        ends[count++] = offset;
+    }
+    return count;
+}
+
+// bytes inserted into the middle of a file only change the chunks around them: every chunk
+// before is cut the same, and after a chunk or two every one is cut the same again, moved
+// by the insert. Cutting from only CHUNK_MAX_SIZE bytes, as chunk_list_build() does, cuts
+// the same as from the whole file
+int test_chunk_stability(char *detail, size_t len) {
+    const size_t size = 4 << 20, at = 1500000, inserted = 100;
+    size_t *before, *after, i, j, resync;
+    u_int count_before, count_after, k;
+    u_char *data, *edited;
+    u_llong x = 88172645463325252ULL;    // xorshift64, so every run cuts the same data
+    int moved, ok = 0;
+
+    data = malloc(size + inserted);
+    edited = malloc(size + inserted);
+    before = malloc((size / CHUNK_MIN_SIZE + 1) * sizeof(size_t));
+    after = malloc(((size + inserted) / CHUNK_MIN_SIZE + 1) * sizeof(size_t));
+    if (data == NULL || edited == NULL || before == NULL || after == NULL) {
+        free(data);
+        free(edited);
+        free(before);
+        free(after);
+        return 0;
+    }
+    for (i = 0; i < size + inserted; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        data[i] = (u_char)x;
+    }
+    // the bytes of data past size are the ones inserted, at offset at
+    memcpy(edited, data, at);
+    memcpy(edited + at, data + size, inserted);
+    memcpy(edited + at + inserted, data + at, size - at);
+
+    count_before = cut_chunks(data, size, before);
+    count_after = cut_chunks(edited, size + inserted, after);
+
+    // the chunks that end before the insert are kept
+    for (k = 0; k < count_before && before[k] <= at; k++) {
+        if (k >= count_after || after[k] != before[k]) break;
+    }
+    // then the first old cut that is a new one, moved, and every cut after it has to be too
+    for (resync = k; resync < count_before; resync++) {
+        for (i = k; i < count_after && after[i] < before[resync] + inserted; i++);
+        if (i < count_after && after[i] == before[resync] + inserted) break;
+    }
+    moved = resync < count_before && count_after - i == count_before - resync;
+    for (j = 0; moved && resync + j < count_before; j++) moved = after[i + j] == before[resync + j] + inserted;
+
+    if (k < count_before && before[k] <= at) {
+        snprintf(detail, len, "chunk %u, before the insert, was cut differently", k);
+    } else if (!moved || resync - k > 2) {
+        snprintf(detail, len, "%zu of %u chunks cut differently after the insert", moved ? resync - k : count_before - k, count_before);
+    } else if (chunk_cut(data, CHUNK_MAX_SIZE) != before[0] || chunk_cut(data + before[5], CHUNK_MAX_SIZE) != before[6] - before[5]) {
+        snprintf(detail, len, "cutting from only %d bytes cut elsewhere", CHUNK_MAX_SIZE);
+    } else {
+        ok = 1;
+    }
+    free(data);
+    free(edited);
+    free(before);
+    free(after);
+    return ok;
+}
+
+// the scoreboard of a send window: a packet is lost once DUP_ACK_THRESHOLD packets past it are
+// held, and resent once; a resend is only lost again once as many sent after it are held, or
+// once the retransmission timer has gone off. A resend ACKed at once wasn't needed, which
+// raises the threshold
+int test_sack_scoreboard(char *detail, size_t len) {
+    // 100 to 119 sent, 100 and 101 land, then 104 to 110 but 107
+    static const u_int held[] = { 104, 105, 106, 108, 109, 110, 111 };
+    static const u_int lost[] = { 102, 103, 107 }, again[] = { 103, 107 };
+    connection connect;
+    send_window *w;
+    u_llong now = stats_now();
+    u_int seq;
+    int fds[2], ok = 0;
+
+    if ((w = calloc(1, sizeof(send_window))) == NULL) return 0;
+    if (timer_open(&w->retransmit) == -1) {
+        free(w);
+        return 0;
+    }
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, fds) == -1) {
+        timer_close(&w->retransmit);
+        free(w);
+        return 0;
+    }
+    // resends go to the connected end of the pair, with no address of their own
+    memset(&connect, 0, sizeof(connect));
+    connect.socket_desc = fds[0];
+    w->base = 100;
+    w->next = 120;
+    w->cwnd = w->limit = w->limit_cap = w->window = 20;
+    w->ssthresh = WINDOW_SIZE;
+    w->reordering = DUP_ACK_THRESHOLD;
+    w->rto = RTO_INITIAL_NS;
+    w->round_end = w->next;
+    w->round_start = now;
+    for (seq = w->base; seq != w->next; seq++) {
+        // 1 is SEQ packet, 0 is Data payload, sent 100 ms ago
+        set_packet_header(&w->packets[seq % WINDOW_SIZE], 1, 0, seq, 0, 0);
+        w->sent[seq % WINDOW_SIZE] = now - 100000000ULL;
+    }
+
+    if (take_ack(&connect, w, 101, held, 6) == -1 || w->base != 102 || w->held != 6 || w->next - w->base - w->held != 12) {
+        snprintf(detail, len, "an ACK of 101 left base %u with %u held", w->base, w->held);
+    } else if (!resent_exactly(fds[1], lost, 3) || !w->recovering || w->cwnd != 9) {
+        snprintf(detail, len, "102, 103 and 107 weren't resent once as a loss, with the window halved");
+    } else if (take_ack(&connect, w, 101, held, 6) == -1 || !resent_exactly(fds[1], NULL, 0) || w->dup_acks != 1) {
+        snprintf(detail, len, "a duplicate ACK with nothing more held resent something");
+    } else if (retransmit_timeout(&connect, w) == -1 || !resent_exactly(fds[1], lost, 1) || w->cwnd != 1) {
+        snprintf(detail, len, "a timeout didn't resend 102 alone, from a window of one");
+    } else if (take_ack(&connect, w, 102, held, 7) == -1 || !resent_exactly(fds[1], again, 2)) {
+        snprintf(detail, len, "103 and 107 weren't resent again once the timeout's resend landed");
+    } else if (w->reordering != DUP_ACK_THRESHOLD + 1) {
+        snprintf(detail, len, "the threshold is %u after a resend landed at once", w->reordering);
+    } else {
+        ok = 1;
+    }
+    close(fds[0]);
+    close(fds[1]);
+    timer_close(&w->retransmit);
+    free(w);
+    return ok;
+}
+
+static unit_test tests[] = {
+    { "rate_priority", test_rate_priority },
+    { "rate_sharing", test_rate_sharing },
+    { "timer_cascade", test_timer_cascade },
+    { "ring_wraparound", test_ring_wraparound },
+    { "chunk_stability", test_chunk_stability },
+    { "sack_scoreboard", test_sack_scoreboard },
+};
+
+int main(int argc, char *argv[]) {
+    size_t n_tests = sizeof(tests) / sizeof(tests[0]), t;
+    char detail[256];
+    int i, run, failed = 0;
+
+    for (t = 0; t < n_tests; t++) {
+        run = argc < 2;
+        for (i = 1; i < argc; i++) run |= strcmp(argv[i], tests[t].name) == 0;
+        if (!run) continue;
+
+        detail[0] = '\0';
+        if (tests[t].run(detail, sizeof(detail))) {
+            printf("PASS %s\n", tests[t].name);
+        } else {
+            printf("FAIL %s%s%s\n", tests[t].name, detail[0] ? ": " : "", detail);
+            failed = 1;
+        }
+        fflush(stdout);
+    }
+    return failed;
+}